@@ -0,0 +1,575 @@
+/**
+ * @file bench_newmm.c
+ * @brief Benchmark each stage of segmentation over several input shapes
+ *
+ * Measures dictionary load time, TCC scanning, prefix lookup and
+ * end-to-end segmentation separately. Inputs are generated from the
+ * dictionary with a fixed seed, so runs are comparable:
+ *
+ *   short  - sentences of a few words, one call each
+ *   long   - 128 KB documents of dictionary words
+ *   oov    - Thai syllables that are mostly not words
+ *   mixed  - Thai words interleaved with Latin words, numbers and punctuation
+ *
+ * Every benchmark reports throughput, p50/p99 latency per call and heap
+ * allocations per call (when built with BENCH_COUNT_ALLOCS and the
+ * allocator wrapped at link time, as `make bench` does).
+ *
+ * Usage: bench_newmm [--json FILE] [--baseline FILE] [--max-regression PCT] [dict_path]
+ *
+ * --json writes one JSON object per benchmark line. --baseline compares
+ * throughput against such a file and exits with status 2 if any benchmark
+ * got slower by more than PCT percent (default 15, above the run-to-run
+ * noise of a busy machine).
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../include/newmm.h"
+#include "../src/datrie.h"
+#include "../src/tcc.h"
+
+#define ROUNDS 5
+#define LOAD_ROUNDS 5
+#define MAX_RESULTS 64
+#define MAX_SPANS (1 << 20)
+
+/* Allocation counting via -Wl,--wrap: calls from the library land here */
+static long alloc_count = 0;
+
+#ifdef BENCH_COUNT_ALLOCS
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    alloc_count++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+    alloc_count++;
+    return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    alloc_count++;
+    return __real_realloc(ptr, size);
+}
+#endif
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Fixed-seed LCG so every run sees the same inputs */
+static unsigned int lcg_state = 12345;
+static unsigned int lcg_next(void) {
+    lcg_state = lcg_state * 1103515245u + 12345u;
+    return (lcg_state >> 16) & 0x7FFF;
+}
+
+static unsigned int lcg_below(unsigned int n) {
+    return ((lcg_next() << 15) | lcg_next()) % n;
+}
+
+/* Growable byte buffer for generated text */
+typedef struct {
+    char* data;
+    size_t len;
+    size_t capacity;
+} Text;
+
+static void text_append(Text* t, const char* s, size_t n) {
+    if (t->len + n + 1 > t->capacity) {
+        t->capacity = (t->len + n + 1) * 2;
+        t->data = (char*)realloc(t->data, t->capacity);
+        if (!t->data) {
+            fprintf(stderr, "Error: out of memory\n");
+            exit(1);
+        }
+    }
+    memcpy(t->data + t->len, s, n);
+    t->len += n;
+    t->data[t->len] = '\0';
+}
+
+static void text_append_str(Text* t, const char* s) {
+    text_append(t, s, strlen(s));
+}
+
+/* A set of inputs; each is one call */
+typedef struct {
+    const char* name;
+    Text text;            /* All inputs back to back */
+    size_t* offsets;      /* Input i is [offsets[i], offsets[i + 1]) */
+    int count;
+} Shape;
+
+static void shape_begin(Shape* shape, const char* name, int count) {
+    memset(shape, 0, sizeof(*shape));
+    shape->name = name;
+    shape->offsets = (size_t*)malloc((count + 1) * sizeof(size_t));
+    shape->offsets[0] = 0;
+}
+
+static void shape_end_input(Shape* shape) {
+    shape->offsets[++shape->count] = shape->text.len;
+}
+
+typedef struct {
+    char** items;
+    int count;
+} WordList;
+
+static int load_words(const char* path, WordList* words) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) return -1;
+
+    int capacity = 0;
+    char buffer[1024];
+    words->items = NULL;
+    words->count = 0;
+    while (fgets(buffer, sizeof(buffer), fp)) {
+        buffer[strcspn(buffer, "\r\n")] = '\0';
+        if (!buffer[0]) continue;
+        if (words->count >= capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            words->items = (char**)realloc(words->items, capacity * sizeof(char*));
+        }
+        words->items[words->count] = (char*)malloc(strlen(buffer) + 1);
+        strcpy(words->items[words->count++], buffer);
+    }
+    fclose(fp);
+    return words->count > 0 ? 0 : -1;
+}
+
+static const char* random_word(const WordList* words) {
+    return words->items[lcg_below((unsigned int)words->count)];
+}
+
+/* Append a random Thai syllable: consonant, optional vowel, optional tone */
+static void append_syllable(Text* t) {
+    static const char* consonants[] = {"ก", "ข", "ค", "ง", "จ", "ช", "ซ", "ด", "ต", "ท",
+                                       "น", "บ", "ป", "ผ", "พ", "ม", "ย", "ร", "ล", "ว",
+                                       "ส", "ห", "อ", "ฮ"};
+    static const char* vowels[] = {"า", "ิ", "ี", "ึ", "ื", "ุ", "ู", "ะ"};
+    static const char* tones[] = {"่", "้", "๊", "๋"};
+    text_append_str(t, consonants[lcg_below(24)]);
+    if (lcg_below(3)) text_append_str(t, vowels[lcg_below(8)]);
+    if (!lcg_below(4)) text_append_str(t, tones[lcg_below(4)]);
+}
+
+static void make_shapes(const WordList* words, Shape shapes[4]) {
+    /* short: 3-8 words, like a search query or chat message */
+    shape_begin(&shapes[0], "short", 20000);
+    for (int i = 0; i < 20000; i++) {
+        int n = 3 + (int)lcg_below(6);
+        for (int w = 0; w < n; w++) text_append_str(&shapes[0].text, random_word(words));
+        shape_end_input(&shapes[0]);
+    }
+
+    /* long: documents of words with a space every so often */
+    shape_begin(&shapes[1], "long", 8);
+    for (int i = 0; i < 8; i++) {
+        size_t end = shapes[1].text.len + 128 * 1024;
+        while (shapes[1].text.len < end) {
+            text_append_str(&shapes[1].text, random_word(words));
+            if (!lcg_below(12)) text_append_str(&shapes[1].text, " ");
+        }
+        shape_end_input(&shapes[1]);
+    }
+
+    /* oov: random syllables with the odd real word */
+    shape_begin(&shapes[2], "oov", 2000);
+    for (int i = 0; i < 2000; i++) {
+        for (int s = 0; s < 120; s++) {
+            if (!lcg_below(10)) {
+                text_append_str(&shapes[2].text, random_word(words));
+            } else {
+                append_syllable(&shapes[2].text);
+            }
+        }
+        shape_end_input(&shapes[2]);
+    }
+
+    /* mixed: Thai with Latin words, numbers and punctuation */
+    static const char* latin[] = {"hello", "API", "newmm", "Bangkok", "COVID-19", "iPhone"};
+    static const char* other[] = {"3.14", "2024", "1,000", "!", "...", "(", ")", "\"", ", "};
+    shape_begin(&shapes[3], "mixed", 2000);
+    for (int i = 0; i < 2000; i++) {
+        for (int s = 0; s < 40; s++) {
+            unsigned int kind = lcg_below(10);
+            if (kind < 6) {
+                text_append_str(&shapes[3].text, random_word(words));
+            } else if (kind < 8) {
+                text_append_str(&shapes[3].text, " ");
+                text_append_str(&shapes[3].text, latin[lcg_below(6)]);
+                text_append_str(&shapes[3].text, " ");
+            } else {
+                text_append_str(&shapes[3].text, other[lcg_below(9)]);
+            }
+        }
+        shape_end_input(&shapes[3]);
+    }
+}
+
+/* One benchmark line */
+typedef struct {
+    char bench[32];
+    char shape[16];
+    int calls;
+    double bytes;
+    double mb_s;
+    double p50_us;
+    double p99_us;
+    double allocs_per_call;
+} Result;
+
+static Result results[MAX_RESULTS];
+static int num_results = 0;
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double* sorted, int n, double p) {
+    int i = (int)(p * (n - 1) + 0.5);
+    return sorted[i];
+}
+
+/* Record a result from per-call latencies of all rounds and the best
+ * round's total time */
+static void add_result(const char* bench, const char* shape, int calls, double bytes,
+                       double* latencies, int num_latencies, double best_total, long allocs) {
+    if (num_results >= MAX_RESULTS) return;
+
+    qsort(latencies, num_latencies, sizeof(double), compare_double);
+    Result* r = &results[num_results++];
+    snprintf(r->bench, sizeof(r->bench), "%s", bench);
+    snprintf(r->shape, sizeof(r->shape), "%s", shape);
+    r->calls = calls;
+    r->bytes = bytes;
+    r->mb_s = bytes / best_total / 1048576.0;
+    r->p50_us = percentile(latencies, num_latencies, 0.50) * 1e6;
+    r->p99_us = percentile(latencies, num_latencies, 0.99) * 1e6;
+#ifdef BENCH_COUNT_ALLOCS
+    r->allocs_per_call = (double)allocs / num_latencies;
+#else
+    (void)allocs;
+    r->allocs_per_call = -1;
+#endif
+
+    printf("%-16s %-6s %10.2f MB/s %10.2f us p50 %10.2f us p99", r->bench, r->shape,
+           r->mb_s, r->p50_us, r->p99_us);
+    if (r->allocs_per_call >= 0) printf(" %9.2f allocs/call", r->allocs_per_call);
+    printf("\n");
+}
+
+/* What one call of a benchmark does */
+typedef long (*call_fn)(const char* text, size_t len, void* state);
+
+typedef struct {
+    newmm_dict_t dict;
+    DATrie* da;
+    newmm_ctx_t* ctx;
+    int32_t* starts;
+    int32_t* ends;
+    uint64_t* bitmap;
+} BenchState;
+
+static long call_tcc(const char* text, size_t len, void* state) {
+    return tcc_boundaries_into(text, (int)len, ((BenchState*)state)->bitmap);
+}
+
+/* Prefix lookup at every character start, as the segmenter would probe */
+static long call_prefix(const char* text, size_t len, void* state) {
+    int ends[TRIE_MAX_PREFIXES];
+    long found = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (((unsigned char)text[i] & 0xC0) == 0x80) continue;
+        found += datrie_prefix_ends(((BenchState*)state)->da, text + i, len - i, ends,
+                                    TRIE_MAX_PREFIXES);
+    }
+    return found;
+}
+
+static long call_greedy(const char* text, size_t len, void* state) {
+    BenchState* s = (BenchState*)state;
+    return newmm_segment_spans_engine(text, len, s->dict, NEWMM_ENGINE_GREEDY, s->starts, s->ends,
+                                      MAX_SPANS);
+}
+
+static long call_graph(const char* text, size_t len, void* state) {
+    BenchState* s = (BenchState*)state;
+    return newmm_segment_spans_engine(text, len, s->dict, NEWMM_ENGINE_GRAPH, s->starts, s->ends,
+                                      MAX_SPANS);
+}
+
+static long call_weighted(const char* text, size_t len, void* state) {
+    BenchState* s = (BenchState*)state;
+    return newmm_segment_spans_engine(text, len, s->dict, NEWMM_ENGINE_WEIGHTED, s->starts,
+                                      s->ends, MAX_SPANS);
+}
+
+static long call_ctx(const char* text, size_t len, void* state) {
+    BenchState* s = (BenchState*)state;
+    const int32_t* starts;
+    const int32_t* ends;
+    long count = newmm_ctx_segment_spans(s->ctx, text, len, s->dict, &starts, &ends);
+    newmm_ctx_reset(s->ctx);
+    return count;
+}
+
+static long call_strings(const char* text, size_t len, void* state) {
+    int count = 0;
+    char** tokens = newmm_segment_with_dict_len(text, len, ((BenchState*)state)->dict, &count);
+    newmm_free_result(tokens, count);
+    return count;
+}
+
+/* Time every input of shape for ROUNDS rounds after one warm-up round */
+static void bench_shape(const char* bench, const Shape* shape, call_fn fn, void* state) {
+    int n = shape->count;
+    double* latencies = (double*)malloc((size_t)n * ROUNDS * sizeof(double));
+    double best_total = 1e30;
+    long allocs = 0;
+    long checksum = 0;
+
+    for (int r = -1; r < ROUNDS; r++) {
+        long allocs_before = alloc_count;
+        double round_start = now_sec();
+        for (int i = 0; i < n; i++) {
+            const char* text = shape->text.data + shape->offsets[i];
+            size_t len = shape->offsets[i + 1] - shape->offsets[i];
+            double start = now_sec();
+            checksum += fn(text, len, state);
+            if (r >= 0) latencies[r * n + i] = now_sec() - start;
+        }
+        double total = now_sec() - round_start;
+        if (r < 0) continue;
+
+        allocs += alloc_count - allocs_before;
+        if (total < best_total) best_total = total;
+    }
+
+    if (checksum < 0) fprintf(stderr, "Warning: %s failed on %s\n", bench, shape->name);
+    add_result(bench, shape->name, n, (double)shape->text.len, latencies, n * ROUNDS,
+               best_total, allocs);
+    free(latencies);
+}
+
+static long file_size(const char* path) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return -1;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fclose(fp);
+    return size;
+}
+
+/* Load a dictionary LOAD_ROUNDS times; "throughput" is file bytes parsed */
+static void bench_load(const char* bench, const char* path, unsigned int flags, bool mapped) {
+    double latencies[LOAD_ROUNDS];
+    double best = 1e30;
+    long allocs_before = alloc_count;
+    for (int r = 0; r < LOAD_ROUNDS; r++) {
+        double start = now_sec();
+        newmm_dict_t dict = mapped ? newmm_load_dict_mmap(path) : newmm_load_dict_ex(path, flags);
+        latencies[r] = now_sec() - start;
+        if (!dict) {
+            fprintf(stderr, "Warning: %s failed on %s\n", bench, path);
+            return;
+        }
+        newmm_free_dict(dict);
+        if (latencies[r] < best) best = latencies[r];
+    }
+
+    /* Frees in between are not counted, so this is allocations per load */
+    long allocs = alloc_count - allocs_before;
+    add_result(bench, "dict", LOAD_ROUNDS, (double)file_size(path), latencies, LOAD_ROUNDS,
+               best, allocs);
+}
+
+static void write_json(const char* path) {
+    FILE* fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "Error: cannot write %s\n", path);
+        return;
+    }
+    for (int i = 0; i < num_results; i++) {
+        const Result* r = &results[i];
+        fprintf(fp, "{\"bench\":\"%s\",\"shape\":\"%s\",\"calls\":%d,\"bytes\":%.0f,"
+                    "\"mb_s\":%.3f,\"p50_us\":%.3f,\"p99_us\":%.3f,\"allocs_per_call\":%.3f}\n",
+                r->bench, r->shape, r->calls, r->bytes, r->mb_s, r->p50_us, r->p99_us,
+                r->allocs_per_call);
+    }
+    fclose(fp);
+}
+
+/* Copy the string value of "key" in a JSON line written by write_json() */
+static bool json_string(const char* line, const char* key, char* out, size_t size) {
+    char pattern[48];
+    snprintf(pattern, sizeof(pattern), "\"%s\":\"", key);
+    const char* p = strstr(line, pattern);
+    if (!p) return false;
+    p += strlen(pattern);
+    size_t n = strcspn(p, "\"");
+    if (n >= size) return false;
+    memcpy(out, p, n);
+    out[n] = '\0';
+    return true;
+}
+
+static bool json_number(const char* line, const char* key, double* out) {
+    char pattern[48];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char* p = strstr(line, pattern);
+    return p && sscanf(p + strlen(pattern), "%lf", out) == 1;
+}
+
+/* Compare throughput against a baseline file; returns regressions found */
+static int check_baseline(const char* path, double max_regression) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Error: cannot read baseline %s\n", path);
+        return -1;
+    }
+
+    int regressions = 0;
+    char line[512];
+    printf("\n%-16s %-6s %12s %12s %8s\n", "baseline", "shape", "before", "now", "change");
+    while (fgets(line, sizeof(line), fp)) {
+        char bench[32], shape[16];
+        double before;
+        if (!json_string(line, "bench", bench, sizeof(bench)) ||
+            !json_string(line, "shape", shape, sizeof(shape)) ||
+            !json_number(line, "mb_s", &before) || before <= 0) {
+            continue;
+        }
+
+        for (int i = 0; i < num_results; i++) {
+            if (strcmp(results[i].bench, bench) != 0 || strcmp(results[i].shape, shape) != 0) {
+                continue;
+            }
+            double change = (results[i].mb_s / before - 1) * 100;
+            bool slower = change < -max_regression;
+            printf("%-16s %-6s %12.2f %12.2f %+7.1f%%%s\n", bench, shape, before,
+                   results[i].mb_s, change, slower ? "  REGRESSION" : "");
+            if (slower) regressions++;
+        }
+    }
+    fclose(fp);
+    return regressions;
+}
+
+int main(int argc, char* argv[]) {
+    const char* dict_path = "data/thai_words.txt";
+    const char* json_path = NULL;
+    const char* baseline_path = NULL;
+    double max_regression = 15;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline_path = argv[++i];
+        } else if (strcmp(argv[i], "--max-regression") == 0 && i + 1 < argc) {
+            max_regression = atof(argv[++i]);
+        } else {
+            dict_path = argv[i];
+        }
+    }
+
+    WordList words;
+    if (load_words(dict_path, &words) != 0) {
+        fprintf(stderr, "Error: cannot load %s\n", dict_path);
+        return 1;
+    }
+    Shape shapes[4];
+    make_shapes(&words, shapes);
+
+    printf("Dictionary: %s (%d words)\n", dict_path, words.count);
+    for (int s = 0; s < 4; s++) {
+        printf("Shape %-6s %6d inputs %10.2f MB\n", shapes[s].name, shapes[s].count,
+               shapes[s].text.len / 1048576.0);
+    }
+    printf("\n");
+
+    /* Dictionary load */
+    const char* image_path = "build/bench_newmm.dict";
+    bench_load("load_text", dict_path, 0, false);
+    bench_load("load_text_bytes", dict_path, NEWMM_DICT_BYTE_KEYS, false);
+    newmm_dict_t dict = newmm_load_dict(dict_path);
+    if (!dict || newmm_save_dict_binary(dict, image_path) != 0) {
+        fprintf(stderr, "Error: cannot build %s\n", image_path);
+        return 1;
+    }
+    bench_load("load_mmap", image_path, 0, true);
+    remove(image_path);
+
+    size_t max_len = 0;
+    for (int s = 0; s < 4; s++) {
+        for (int i = 0; i < shapes[s].count; i++) {
+            size_t len = shapes[s].offsets[i + 1] - shapes[s].offsets[i];
+            if (len > max_len) max_len = len;
+        }
+    }
+    BenchState state;
+    state.dict = dict;
+    state.da = (DATrie*)dict;
+    state.ctx = newmm_ctx_create();
+    state.starts = (int32_t*)malloc(MAX_SPANS * sizeof(int32_t));
+    state.ends = (int32_t*)malloc(MAX_SPANS * sizeof(int32_t));
+    state.bitmap = (uint64_t*)malloc(TCC_BITMAP_WORDS(max_len) * sizeof(uint64_t));
+    if (!state.ctx || !state.starts || !state.ends || !state.bitmap) {
+        fprintf(stderr, "Error: out of memory\n");
+        return 1;
+    }
+
+    static const struct {
+        const char* name;
+        call_fn fn;
+    } stages[] = {
+        {"tcc", call_tcc},
+        {"prefix", call_prefix},
+        {"segment_greedy", call_greedy},
+        {"segment_graph", call_graph},
+        {"segment_weighted", call_weighted},
+        {"segment_ctx", call_ctx},
+        {"segment_strings", call_strings},
+    };
+    for (size_t b = 0; b < sizeof(stages) / sizeof(stages[0]); b++) {
+        for (int s = 0; s < 4; s++) {
+            bench_shape(stages[b].name, &shapes[s], stages[b].fn, &state);
+        }
+    }
+
+    if (json_path) write_json(json_path);
+    int regressions = baseline_path ? check_baseline(baseline_path, max_regression) : 0;
+
+    newmm_ctx_free(state.ctx);
+    newmm_free_dict(dict);
+    free(state.starts);
+    free(state.ends);
+    free(state.bitmap);
+    for (int s = 0; s < 4; s++) {
+        free(shapes[s].text.data);
+        free(shapes[s].offsets);
+    }
+    for (int i = 0; i < words.count; i++) free(words.items[i]);
+    free(words.items);
+
+    if (regressions < 0) return 1;
+    if (regressions > 0) {
+        printf("\n%d benchmark(s) slower than baseline by more than %.0f%%\n", regressions,
+               max_regression);
+        return 2;
+    }
+    return 0;
+}
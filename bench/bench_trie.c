@@ -0,0 +1,206 @@
+/**
+ * @file bench_trie.c
+ * @brief Compare memory and prefix lookup speed of the trie layouts
+ *
+ * Usage: bench_trie [dict_path]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/trie.h"
+#include "../src/datrie.h"
+
+#define TEXT_BYTES (2 * 1024 * 1024)
+#define ROUNDS 5
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Fixed-seed LCG so every run scans the same text */
+static unsigned int lcg_state = 12345;
+static unsigned int lcg_next(void) {
+    lcg_state = lcg_state * 1103515245u + 12345u;
+    return (lcg_state >> 16) & 0x7FFF;
+}
+
+/* Build a text of random dictionary words */
+static char* make_text(const char* dict_path, size_t* out_len) {
+    FILE* fp = fopen(dict_path, "r");
+    if (!fp) return NULL;
+
+    char** words = NULL;
+    int num_words = 0, capacity = 0;
+    char buffer[1024];
+    while (fgets(buffer, sizeof(buffer), fp)) {
+        buffer[strcspn(buffer, "\r\n")] = '\0';
+        if (!buffer[0]) continue;
+        if (num_words >= capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            words = (char**)realloc(words, capacity * sizeof(char*));
+        }
+        words[num_words++] = strdup(buffer);
+    }
+    fclose(fp);
+    if (num_words == 0) return NULL;
+
+    char* text = (char*)malloc(TEXT_BYTES + 1024);
+    size_t len = 0;
+    while (len < TEXT_BYTES) {
+        const char* w = words[(lcg_next() << 15 | lcg_next()) % num_words];
+        size_t n = strlen(w);
+        memcpy(text + len, w, n);
+        len += n;
+    }
+    text[len] = '\0';
+
+    for (int i = 0; i < num_words; i++) free(words[i]);
+    free(words);
+    *out_len = len;
+    return text;
+}
+
+/* Character start offsets, where the segmenter issues queries */
+static int* char_starts(const char* text, size_t len, int* count) {
+    int* starts = (int*)malloc(len * sizeof(int));
+    int n = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (((unsigned char)text[i] & 0xC0) != 0x80) starts[n++] = (int)i;
+    }
+    *count = n;
+    return starts;
+}
+
+typedef int (*prefix_fn)(const void* dict, const char* text, size_t len, int* ends, int max_ends);
+
+static int trie_query(const void* dict, const char* text, size_t len, int* ends, int max_ends) {
+    return trie_prefix_ends((const Trie*)dict, text, len, ends, max_ends);
+}
+
+static int datrie_query(const void* dict, const char* text, size_t len, int* ends, int max_ends) {
+    return datrie_prefix_ends((const DATrie*)dict, text, len, ends, max_ends);
+}
+
+/* Query every character start; report the best of ROUNDS runs */
+static void bench_lookup(const char* name, prefix_fn query, const void* dict,
+                         const char* text, size_t len, const int* starts, int num_queries) {
+    int ends[TRIE_MAX_PREFIXES];
+    long checksum = 0;
+    double best = 1e9;
+
+    for (int r = 0; r < ROUNDS; r++) {
+        double start = now_sec();
+        checksum = 0;
+        for (int i = 0; i < num_queries; i++) {
+            checksum += query(dict, text + starts[i], len - starts[i], ends, TRIE_MAX_PREFIXES);
+        }
+        double elapsed = now_sec() - start;
+        if (elapsed < best) best = elapsed;
+    }
+
+    printf("%-14s %8.1f ns/query %8.2f Mquery/s %8.2f MB/s   (checksum %ld)\n",
+           name, best * 1e9 / num_queries, num_queries / best / 1e6,
+           len / best / 1048576.0, checksum);
+}
+
+int main(int argc, char* argv[]) {
+    const char* dict_path = argc > 1 ? argv[1] : "data/thai_words.txt";
+    static const TrieKeyMode modes[2] = {TRIE_KEY_CODEPOINT, TRIE_KEY_BYTE};
+    static const char* mode_names[2] = {"codepoint", "byte"};
+    Trie* tries[2];
+    DATrie* das[2];
+
+    printf("%-14s %12s %12s\n", "layout", "memory", "build");
+    for (int m = 0; m < 2; m++) {
+        double t0 = now_sec();
+        tries[m] = trie_create_keyed(modes[m]);
+        if (!tries[m] || trie_load_dict(tries[m], dict_path) < 0) {
+            fprintf(stderr, "Error: cannot load %s\n", dict_path);
+            return 1;
+        }
+        double t1 = now_sec();
+        das[m] = datrie_build(tries[m]);
+        double t2 = now_sec();
+        if (!das[m]) {
+            fprintf(stderr, "Error: compact trie build failed\n");
+            return 1;
+        }
+
+        char name[32];
+        snprintf(name, sizeof(name), "trie/%s", mode_names[m]);
+        printf("%-14s %9.2f MB %9.1f ms\n", name,
+               trie_memory_usage(tries[m]) / 1048576.0, (t1 - t0) * 1e3);
+        snprintf(name, sizeof(name), "datrie/%s", mode_names[m]);
+        printf("%-14s %9.2f MB %9.1f ms   (%d units, %d labels)\n", name,
+               datrie_memory_usage(das[m]) / 1048576.0, (t2 - t1) * 1e3,
+               das[m]->num_units, das[m]->num_labels);
+    }
+    printf("\nDictionary: %s (%d words)\n\n", dict_path, tries[0]->num_words);
+
+    size_t len;
+    char* text = make_text(dict_path, &len);
+    if (!text) {
+        fprintf(stderr, "Error: cannot build benchmark text\n");
+        return 1;
+    }
+    int num_queries;
+    int* starts = char_starts(text, len, &num_queries);
+
+    for (int m = 0; m < 2; m++) {
+        char name[32];
+        snprintf(name, sizeof(name), "trie/%s", mode_names[m]);
+        bench_lookup(name, trie_query, tries[m], text, len, starts, num_queries);
+    }
+    for (int m = 0; m < 2; m++) {
+        char name[32];
+        snprintf(name, sizeof(name), "datrie/%s", mode_names[m]);
+        bench_lookup(name, datrie_query, das[m], text, len, starts, num_queries);
+    }
+
+    /* Startup cost: text parse + build versus mapping a saved image */
+    const char* image_path = "build/bench_trie.dict";
+    if (datrie_save(das[0], image_path) == 0) {
+        double t0 = now_sec();
+        Trie* trie = trie_create();
+        trie_load_dict(trie, dict_path);
+        DATrie* built = datrie_build(trie);
+        trie_free(trie);
+        double t1 = now_sec();
+
+        /* Best of ROUNDS: the first map right after writing is not typical */
+        DATrie* mapped = NULL;
+        double best_map = 1e9;
+        for (int r = 0; r < ROUNDS; r++) {
+            datrie_free(mapped);
+            double start = now_sec();
+            mapped = datrie_load_mmap(image_path);
+            double elapsed = now_sec() - start;
+            if (elapsed < best_map) best_map = elapsed;
+        }
+
+        printf("\n%-14s %9.2f ms\n", "load text", (t1 - t0) * 1e3);
+        printf("%-14s %9.2f ms\n", "load mmap", best_map * 1e3);
+        if (mapped) {
+            bench_lookup("datrie/mmap", datrie_query, mapped, text, len, starts, num_queries);
+        }
+        datrie_free(built);
+        datrie_free(mapped);
+        remove(image_path);
+    }
+
+    free(starts);
+    free(text);
+    double free_total = 0;
+    for (int m = 0; m < 2; m++) {
+        datrie_free(das[m]);
+        double t0 = now_sec();
+        trie_free(tries[m]);
+        free_total += now_sec() - t0;
+    }
+    printf("\n%-14s %9.2f ms\n", "free trie", free_total / 2 * 1e3);
+    return 0;
+}
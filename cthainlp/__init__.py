@@ -6,7 +6,29 @@ Python bindings for the CThaiNLP C library
 __version__ = "0.1.0"
 __author__ = "Wannaphong Phatthiyaphaibun"
 
-from cthainlp.tokenize import word_tokenize
+from cthainlp.tokenize import (
+    word_tokenize,
+    word_tokenize_batch,
+    segment_batch,
+    segment_offsets,
+    segment_offsets_batch,
+    segment_ids,
+    set_span_cache_size,
+    span_cache_info,
+    UNKNOWN_ID,
+)
 from cthainlp import newmm
 
-__all__ = ["word_tokenize", "newmm", "__version__"]
+__all__ = [
+    "word_tokenize",
+    "word_tokenize_batch",
+    "segment_batch",
+    "segment_offsets",
+    "segment_offsets_batch",
+    "segment_ids",
+    "set_span_cache_size",
+    "span_cache_info",
+    "UNKNOWN_ID",
+    "newmm",
+    "__version__",
+]
@@ -3,13 +3,17 @@ Tokenization module for CThaiNLP
 """
 
 import os
-from typing import List, Optional
+from array import array
+from typing import List, Optional, Sequence, Tuple
 
 try:
     import _cthainlp
 except ImportError:
     _cthainlp = None
 
+# Word ID of tokens that are not dictionary words, see segment_ids()
+UNKNOWN_ID = 0xFFFFFFFF
+
 
 def _get_default_dict_path() -> Optional[str]:
     """
@@ -38,6 +42,39 @@ def _get_default_dict_path() -> Optional[str]:
     return None
 
 
+def _check_engine(engine: str) -> None:
+    """
+    Check that the C extension is available and the engine is supported.
+    """
+    if _cthainlp is None:
+        raise ImportError(
+            "CThaiNLP C extension is not installed. "
+            "Please install the package properly using: pip install cthainlp"
+        )
+    
+    if engine != "newmm":
+        raise ValueError(
+            f"Unsupported engine '{engine}'. Currently only 'newmm' is supported."
+        )
+
+
+def _resolve_dict_path(custom_dict: Optional[str]) -> Optional[str]:
+    """
+    Get the dictionary path to pass to the C extension.
+    
+    Raises:
+        FileNotFoundError: If custom_dict does not exist
+    """
+    if custom_dict is not None:
+        # User provided a custom dictionary
+        if not os.path.exists(custom_dict):
+            raise FileNotFoundError(f"Dictionary file not found: {custom_dict}")
+        return custom_dict
+    
+    # Use default dictionary
+    return _get_default_dict_path()
+
+
 def word_tokenize(
     text: str,
     engine: str = "newmm",
@@ -84,16 +121,7 @@ def word_tokenize(
         >>> print(tokens)
         ['สวัสดี', ' ', 'ครับ']
     """
-    if _cthainlp is None:
-        raise ImportError(
-            "CThaiNLP C extension is not installed. "
-            "Please install the package properly using: pip install cthainlp"
-        )
-    
-    if engine != "newmm":
-        raise ValueError(
-            f"Unsupported engine '{engine}'. Currently only 'newmm' is supported."
-        )
+    _check_engine(engine)
     
     if not isinstance(text, str):
         raise TypeError(f"text must be a string, got {type(text)}")
@@ -103,14 +131,7 @@ def word_tokenize(
         return []
     
     # Determine which dictionary to use
-    if custom_dict is not None:
-        # User provided a custom dictionary
-        if not os.path.exists(custom_dict):
-            raise FileNotFoundError(f"Dictionary file not found: {custom_dict}")
-        dict_path = custom_dict
-    else:
-        # Use default dictionary
-        dict_path = _get_default_dict_path()
+    dict_path = _resolve_dict_path(custom_dict)
     
     # Call the C extension
     tokens = _cthainlp.segment(text, dict_path)
@@ -123,5 +144,210 @@ def word_tokenize(
     return tokens
 
 
-# Alias for compatibility
+def word_tokenize_batch(
+    texts: Sequence[str],
+    engine: str = "newmm",
+    custom_dict: Optional[str] = None,
+    keep_whitespace: bool = True,
+    num_threads: int = 0,
+) -> List[List[str]]:
+    """
+    Segment many texts in one call.
+    
+    The whole sequence is handed to the C library at once and segmented
+    by native threads with the GIL released, which avoids per-string
+    interpreter overhead for large numbers of short texts.
+    
+    Args:
+        texts (sequence of str): Input texts to tokenize
+        engine (str): Tokenization engine. Currently only 'newmm' is supported.
+        custom_dict (str, optional): Path to custom dictionary file (one word per line).
+                                     If None, uses the default dictionary.
+        keep_whitespace (bool): Whether to keep whitespace tokens in the result.
+        num_threads (int): Number of worker threads. 0 uses one per CPU.
+    
+    Returns:
+        list: One list of tokens per input text, in input order
+    
+    Examples:
+        >>> from cthainlp import word_tokenize_batch
+        >>> word_tokenize_batch(["ฉันไปโรงเรียน", "วันนี้อากาศดีมาก"], num_threads=2)
+        [['ฉัน', 'ไป', 'โรงเรียน'], ['วันนี้', 'อากาศ', 'ดีมาก']]
+    """
+    _check_engine(engine)
+    
+    if isinstance(texts, str):
+        raise TypeError("texts must be a sequence of strings, not a string")
+    
+    dict_path = _resolve_dict_path(custom_dict)
+    results = _cthainlp.segment_batch(texts, dict_path, num_threads)
+    
+    if not keep_whitespace:
+        results = [[token for token in tokens if not token.isspace()] for tokens in results]
+    
+    return results
+
+
+def segment_offsets(
+    text: str,
+    engine: str = "newmm",
+    custom_dict: Optional[str] = None,
+    unit: str = "codepoint",
+) -> array:
+    """
+    Segment text into token boundaries instead of strings.
+    
+    Token i is ``text[offsets[i]:offsets[i + 1]]``. No string object is
+    created per token, which makes this much cheaper than word_tokenize()
+    when only the boundaries are needed, e.g. for ML preprocessing. The
+    result supports the buffer protocol, so
+    ``numpy.frombuffer(offsets, dtype=numpy.int32)`` wraps it without a copy.
+    
+    Args:
+        text (str): Input text to tokenize
+        engine (str): Tokenization engine. Currently only 'newmm' is supported.
+        custom_dict (str, optional): Path to custom dictionary file (one word per line).
+                                     If None, uses the default dictionary.
+        unit (str): 'codepoint' for str indices, or 'byte' for offsets into
+                    the UTF-8 encoding of text.
+    
+    Returns:
+        array: ``array('i')`` of token count + 1 boundaries, starting at 0
+    
+    Examples:
+        >>> from cthainlp import segment_offsets
+        >>> segment_offsets("ฉันไปโรงเรียน")
+        array('i', [0, 3, 5, 13])
+        >>> segment_offsets("ฉันไปโรงเรียน", unit="byte")
+        array('i', [0, 9, 15, 39])
+    """
+    _check_engine(engine)
+    
+    if not isinstance(text, str):
+        raise TypeError(f"text must be a string, got {type(text)}")
+    
+    dict_path = _resolve_dict_path(custom_dict)
+    return _cthainlp.segment_offsets(text, dict_path, unit)
+
+
+def segment_ids(
+    text: str,
+    engine: str = "newmm",
+    custom_dict: Optional[str] = None,
+    unit: str = "codepoint",
+) -> Tuple[array, array]:
+    """
+    Segment text into token boundaries and the word ID of each token.
+    
+    A dictionary line may give its word a 32-bit ID (or frequency) after a
+    tab, as in ``"โรงเรียน\t100"``; words without one are numbered by their
+    line. Tokens that are not dictionary words, such as unknown Thai
+    clusters, spaces or Latin text, get ``UNKNOWN_ID``.
+    
+    Args:
+        text (str): Input text to tokenize
+        engine (str): Tokenization engine. Currently only 'newmm' is supported.
+        custom_dict (str, optional): Path to custom dictionary file.
+                                     If None, uses the default dictionary.
+        unit (str): 'codepoint' for str indices, or 'byte' for offsets into
+                    the UTF-8 encoding of text.
+    
+    Returns:
+        tuple: ``(offsets, ids)``, where offsets is laid out as by
+        segment_offsets() and ``ids`` is an ``array('I')`` with one entry
+        per token
+    
+    Examples:
+        >>> from cthainlp import segment_ids
+        >>> offsets, ids = segment_ids("ฉันไปโรงเรียน", custom_dict="words.txt")
+    """
+    _check_engine(engine)
+    
+    if not isinstance(text, str):
+        raise TypeError(f"text must be a string, got {type(text)}")
+    
+    dict_path = _resolve_dict_path(custom_dict)
+    return _cthainlp.segment_ids(text, dict_path, unit)
+
+
+def segment_offsets_batch(
+    texts: Sequence[str],
+    engine: str = "newmm",
+    custom_dict: Optional[str] = None,
+    unit: str = "codepoint",
+    num_threads: int = 0,
+) -> Tuple[array, array]:
+    """
+    Segment many texts into token boundaries in one call.
+    
+    Texts are segmented by native threads as in word_tokenize_batch(). The
+    boundaries of all texts are returned in one flat array, in the layout
+    of segment_offsets(), with row pointers into it: the boundaries of
+    ``texts[i]`` are ``offsets[indptr[i]:indptr[i + 1]]``.
+    
+    Args:
+        texts (sequence of str): Input texts to tokenize
+        engine (str): Tokenization engine. Currently only 'newmm' is supported.
+        custom_dict (str, optional): Path to custom dictionary file (one word per line).
+                                     If None, uses the default dictionary.
+        unit (str): 'codepoint' or 'byte', as for segment_offsets()
+        num_threads (int): Number of worker threads. 0 uses one per CPU.
+    
+    Returns:
+        tuple: ``(offsets, indptr)`` as ``array('i')`` and ``array('q')``
+    
+    Examples:
+        >>> from cthainlp import segment_offsets_batch
+        >>> segment_offsets_batch(["ฉันไปโรงเรียน", "hello world"])
+        (array('i', [0, 3, 5, 13, 0, 5, 6, 11]), array('q', [0, 4, 8]))
+    """
+    _check_engine(engine)
+    
+    if isinstance(texts, str):
+        raise TypeError("texts must be a sequence of strings, not a string")
+    
+    dict_path = _resolve_dict_path(custom_dict)
+    return _cthainlp.segment_offsets_batch(texts, dict_path, num_threads, unit)
+
+
+def set_span_cache_size(max_entries: int) -> None:
+    """
+    Reuse the tokens of repeated texts.
+    
+    Once enabled, word_tokenize(), segment_offsets() and segment_ids()
+    look texts of up to 256 UTF-8 bytes up in a cache shared by all
+    threads before segmenting them, which pays off when many inputs are
+    exact repeats (greetings, product categories, ...). Cached results
+    are tied to the dictionary that produced them, so an edited custom
+    dictionary is never answered from stale entries.
+    
+    Args:
+        max_entries (int): Number of results kept, rounded up to a multiple
+                           of 16, or 0 to disable the cache (the default).
+                           Changing it drops every cached result.
+    
+    Examples:
+        >>> from cthainlp import set_span_cache_size, span_cache_info
+        >>> set_span_cache_size(10000)
+        >>> tokens = word_tokenize("สวัสดีครับ")
+        >>> tokens = word_tokenize("สวัสดีครับ")
+        >>> span_cache_info()["hits"]
+        1
+    """
+    _cthainlp.set_span_cache_size(max_entries)
+
+
+def span_cache_info() -> dict:
+    """
+    Get the counters of the span cache.
+    
+    Returns:
+        dict: ``hits``, ``misses`` and ``evictions`` since the cache was
+        first enabled, and the ``entries`` held out of ``capacity``
+    """
+    return _cthainlp.span_cache_info()
+
+
+# Aliases for compatibility
 segment = word_tokenize
+segment_batch = word_tokenize_batch
@@ -0,0 +1,38 @@
+/**
+ * @file compile_dict.c
+ * @brief Compile a word list into a memory-mappable binary dictionary
+ *
+ * Usage: compile_dict <words.txt> <output.dict> [--byte-keys]
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "../include/newmm.h"
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <words.txt> <output.dict> [--byte-keys]\n", argv[0]);
+        return 1;
+    }
+    
+    unsigned int flags = 0;
+    if (argc > 3 && strcmp(argv[3], "--byte-keys") == 0) {
+        flags |= NEWMM_DICT_BYTE_KEYS;
+    }
+    
+    newmm_dict_t dict = newmm_load_dict_ex(argv[1], flags);
+    if (!dict) {
+        fprintf(stderr, "Error: Failed to load %s\n", argv[1]);
+        return 1;
+    }
+    
+    if (newmm_save_dict_binary(dict, argv[2]) != 0) {
+        fprintf(stderr, "Error: Failed to write %s\n", argv[2]);
+        newmm_free_dict(dict);
+        return 1;
+    }
+    
+    printf("Wrote %s\n", argv[2]);
+    newmm_free_dict(dict);
+    return 0;
+}
@@ -0,0 +1,42 @@
+/**
+ * @file embed_dict.c
+ * @brief Compile a word list into C source that links the trie in
+ *
+ * Usage: embed_dict <words.txt> <output.c> [name]
+ *
+ * The output defines a DAImage (default_dict_image unless name is given)
+ * over static const arrays in the compact trie layout. The build uses it
+ * to link the bundled word list into the library as its default
+ * dictionary.
+ */
+
+#include <stdio.h>
+#include "../src/trie.h"
+#include "../src/datrie.h"
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <words.txt> <output.c> [name]\n", argv[0]);
+        return 1;
+    }
+    const char* name = argc > 3 ? argv[3] : "default_dict_image";
+    
+    Trie* trie = trie_create();
+    if (!trie || trie_load_dict(trie, argv[1]) < 0) {
+        fprintf(stderr, "Error: Failed to load %s\n", argv[1]);
+        trie_free(trie);
+        return 1;
+    }
+    
+    DATrie* da = datrie_build(trie);
+    trie_free(trie);
+    if (!da || datrie_save_source(da, argv[2], name, argv[1]) != 0) {
+        fprintf(stderr, "Error: Failed to write %s\n", argv[2]);
+        datrie_free(da);
+        return 1;
+    }
+    
+    printf("Wrote %s (%d words)\n", argv[2], da->num_words);
+    datrie_free(da);
+    return 0;
+}
@@ -15,30 +15,224 @@
 #ifndef NEWMM_H
 #define NEWMM_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/* Opaque handle for dictionary */
+/* Opaque handle for dictionary
+ * 
+ * A loaded dictionary is immutable, so one handle may be shared by any
+ * number of threads segmenting concurrently. Handles are reference
+ * counted: loading returns one reference, newmm_dict_retain() adds one
+ * for each extra owner, and every owner releases its own. */
 typedef void* newmm_dict_t;
 
+/* Thread-safe holder of a current dictionary, see newmm_dict_slot_create() */
+typedef struct newmm_dict_slot newmm_dict_slot_t;
+
+/* Word changes layered on a shared dictionary, see newmm_overlay_create() */
+typedef struct newmm_overlay newmm_overlay_t;
+
+/* Spans of a batch, stored contiguously: the tokens of text i are
+ * [starts[j], ends[j]) for offsets[i] <= j < offsets[i + 1], with byte
+ * offsets relative to text i */
+typedef struct {
+    size_t num_texts;
+    size_t* offsets;   /* num_texts + 1 entries */
+    int32_t* starts;
+    int32_t* ends;
+} newmm_batch_result_t;
+
+/* Segmentation algorithms, see newmm_segment_spans_engine() */
+typedef enum {
+    NEWMM_ENGINE_GREEDY = 0,  /* Longest match with one word of lookahead (default) */
+    NEWMM_ENGINE_GRAPH,       /* PyThaiNLP's newmm: fewest tokens over the word graph */
+    NEWMM_ENGINE_WEIGHTED     /* Most likely reading under the dictionary's word frequencies */
+} newmm_engine_t;
+
 /**
  * @brief Load a dictionary for reuse
  * 
+ * Each line of a text dictionary holds a word, optionally followed by a
+ * tab and a 32-bit decimal payload such as a word ID or frequency, below
+ * NEWMM_UNKNOWN_ID. In a file without payloads, words are numbered by
+ * their line, counting non-empty lines from 0; in a file with some, words
+ * without one get the neutral payload 0.
+ * 
  * @param dict_path Path to dictionary file (one word per line, UTF-8 encoded)
- *                  If NULL, uses a default minimal dictionary
+ *                  or a binary dictionary from newmm_save_dict_binary()
+ *                  If NULL or unreadable, uses the default dictionary
+ *                  compiled into the library
  * @return Dictionary handle to be used with newmm_segment_with_dict()
  *         Returns NULL on error
  */
 newmm_dict_t newmm_load_dict(const char* dict_path);
 
+/* Flags for newmm_load_dict_ex() */
+#define NEWMM_DICT_BYTE_KEYS 0x1  /* Key the trie on UTF-8 bytes, skipping decoding */
+
+/**
+ * @brief Load a dictionary with build options
+ * 
+ * Segmentation results do not depend on the flags, only speed and
+ * memory use do. Binary dictionaries and the compiled-in default keep
+ * the layout they were built with.
+ * 
+ * @param dict_path Path to dictionary file, or NULL for the default dictionary
+ * @param flags Bitwise OR of NEWMM_DICT_* flags, 0 for defaults
+ * @return Dictionary handle, or NULL on error
+ */
+newmm_dict_t newmm_load_dict_ex(const char* dict_path, unsigned int flags);
+
+/**
+ * @brief Save a loaded dictionary in the binary format
+ * 
+ * The file stores the compiled trie with offsets only, so it can be
+ * memory-mapped at any address. It is tied to the byte order of the
+ * machine that wrote it.
+ * 
+ * @param dict Dictionary handle, not one from newmm_overlay_build()
+ * @param path Output file path
+ * @return 0 on success, -1 on error
+ */
+int newmm_save_dict_binary(newmm_dict_t dict, const char* path);
+
+/**
+ * @brief Map a binary dictionary read-only
+ * 
+ * Loading does no parsing, and processes that map the same file share
+ * one page-cached copy. newmm_load_dict() also recognises binary files.
+ * 
+ * @param path Path to a file written by newmm_save_dict_binary()
+ * @return Dictionary handle, or NULL if the file is missing or invalid
+ */
+newmm_dict_t newmm_load_dict_mmap(const char* path);
+
 /**
- * @brief Free a loaded dictionary
+ * @brief Release a loaded dictionary
+ * 
+ * Same as newmm_dict_release(): the dictionary is freed once every
+ * reference to it has been released.
  * 
  * @param dict Dictionary handle returned by newmm_load_dict()
  */
 void newmm_free_dict(newmm_dict_t dict);
 
+/**
+ * @brief Add a reference to a dictionary
+ * 
+ * @return dict, as a convenience
+ */
+newmm_dict_t newmm_dict_retain(newmm_dict_t dict);
+
+/**
+ * @brief Drop a reference to a dictionary, freeing it after the last one
+ */
+void newmm_dict_release(newmm_dict_t dict);
+
+/**
+ * @brief Create a slot holding a current dictionary for hot reload
+ * 
+ * Readers take the current dictionary with newmm_dict_slot_get() and
+ * release it when done. newmm_dict_slot_set() swaps in a new dictionary
+ * at any time; readers still using the old one are unaffected, and it is
+ * freed after the last of them releases it.
+ * 
+ * @param dict Initial dictionary; the slot takes its own reference
+ * @return New slot, or NULL on error
+ */
+newmm_dict_slot_t* newmm_dict_slot_create(newmm_dict_t dict);
+
+/**
+ * @brief Get a reference to the current dictionary of a slot
+ * 
+ * @return Dictionary to release with newmm_dict_release(), or NULL
+ */
+newmm_dict_t newmm_dict_slot_get(newmm_dict_slot_t* slot);
+
+/**
+ * @brief Replace the current dictionary of a slot
+ * 
+ * @param dict New dictionary; the slot takes its own reference
+ * @return 0 on success, -1 on error
+ */
+int newmm_dict_slot_set(newmm_dict_slot_t* slot, newmm_dict_t dict);
+
+/**
+ * @brief Free a slot, releasing its reference to the current dictionary
+ */
+void newmm_dict_slot_free(newmm_dict_slot_t* slot);
+
+/**
+ * @brief Get a dictionary from the process-wide cache, loading it if needed
+ * 
+ * The few most recently used dictionaries stay loaded, keyed by path. A
+ * file whose size, inode or modification time (to the nanosecond where
+ * the platform reports it) changed is loaded again. Safe to call from
+ * any thread; newmm_segment() uses this cache.
+ * 
+ * @param dict_path Path as for newmm_load_dict(), or NULL for the default
+ * @return Dictionary to release with newmm_dict_release(), or NULL on error
+ */
+newmm_dict_t newmm_dict_cache_get(const char* dict_path);
+
+/**
+ * @brief Drop every dictionary held by the process-wide cache
+ * 
+ * Dictionaries still referenced by callers are freed when released.
+ */
+void newmm_clear_dict_cache(void);
+
+/**
+ * @brief Start a set of words to add to or remove from a base dictionary
+ * 
+ * Many overlays can share one base, e.g. a mapped binary dictionary, and
+ * each costs memory and build time in proportion to its own words only.
+ * An overlay is edited by one thread; the dictionaries built from it are
+ * immutable and can be shared like any other.
+ * 
+ * @param base Dictionary to layer on; the overlay takes its own reference
+ * @return New overlay, or NULL on error
+ */
+newmm_overlay_t* newmm_overlay_create(newmm_dict_t base);
+
+/**
+ * @brief Add a word, undoing an earlier removal of it
+ * 
+ * A word the base has keeps its payload. A new word gets payload 0 if the
+ * base has frequencies, so the weighted engine sees a neutral frequency,
+ * and otherwise the next word ID after the base's words.
+ * 
+ * @return 0 on success, -1 on error (including invalid UTF-8)
+ */
+int newmm_overlay_add(newmm_overlay_t* overlay, const char* word);
+
+/**
+ * @brief Remove a word, hiding it in the base and undoing an earlier add
+ * 
+ * @return 0 on success, -1 on error (including invalid UTF-8)
+ */
+int newmm_overlay_remove(newmm_overlay_t* overlay, const char* word);
+
+/**
+ * @brief Build a dictionary of the base words with the overlay's changes
+ * 
+ * Only the overlay's words are compiled. Later edits do not affect the
+ * returned dictionary; build again and publish it, e.g. with
+ * newmm_dict_slot_set(). The dictionary holds a reference to the base.
+ * 
+ * @return Dictionary to release with newmm_free_dict(), or NULL on error
+ */
+newmm_dict_t newmm_overlay_build(newmm_overlay_t* overlay);
+
+/**
+ * @brief Free an overlay; dictionaries built from it stay valid
+ */
+void newmm_overlay_free(newmm_overlay_t* overlay);
+
 /**
  * @brief Segment Thai text using a pre-loaded dictionary
  * 
@@ -50,18 +244,293 @@ void newmm_free_dict(newmm_dict_t dict);
  */
 char** newmm_segment_with_dict(const char* text, newmm_dict_t dict, int* token_count);
 
+/**
+ * @brief Segment the len bytes at text using a pre-loaded dictionary
+ * 
+ * Same as newmm_segment_with_dict(), but text need not be NUL-terminated,
+ * so a field inside a larger buffer can be segmented in place.
+ * 
+ * @param text Input Thai text to be segmented (UTF-8 encoded)
+ * @param len Length of text in bytes
+ * @param dict Pre-loaded dictionary handle from newmm_load_dict()
+ * @param token_count Output parameter for number of tokens found
+ * @return Array of strings (tokens), caller must free using newmm_free_result()
+ *         Returns NULL on error
+ */
+char** newmm_segment_with_dict_len(const char* text, size_t len, newmm_dict_t dict,
+                                   int* token_count);
+
+/**
+ * @brief Segment Thai text into token boundaries without allocating
+ * 
+ * Token i is the byte range [starts[i], ends[i]) of text. Tokens cover
+ * the input contiguously, so no copy of the text is made.
+ * 
+ * The whole text is always segmented. If it has more tokens than
+ * capacity, only the first capacity spans are written and the return
+ * value tells the caller how large the arrays must be for a retry; len
+ * entries are always enough. Passing capacity 0 (with NULL arrays) just
+ * counts tokens.
+ * 
+ * @param text Input text (UTF-8 encoded), need not be NUL-terminated
+ * @param len Length of text in bytes
+ * @param dict Pre-loaded dictionary handle from newmm_load_dict()
+ * @param starts Caller-owned array receiving token start offsets
+ * @param ends Caller-owned array receiving token end offsets
+ * @param capacity Number of entries available in starts and ends
+ * @return Total number of tokens (may exceed capacity), or -1 on error
+ */
+int newmm_segment_spans(const char* text, size_t len, newmm_dict_t dict,
+                        int32_t* starts, int32_t* ends, size_t capacity);
+
+/**
+ * @brief Segment Thai text into token boundaries with a chosen engine
+ * 
+ * NEWMM_ENGINE_GREEDY gives the same spans as newmm_segment_spans().
+ * NEWMM_ENGINE_GRAPH follows PyThaiNLP's newmm: the dictionary words
+ * starting at each TCC boundary form a graph, and wherever several
+ * readings overlap, the one with the fewest tokens is chosen once they
+ * meet again at a common boundary. Ambiguity is resolved over a bounded
+ * window, so memory use does not grow with the input.
+ * NEWMM_ENGINE_WEIGHTED finds the reading of least cost in one Viterbi
+ * pass over the same TCC-aligned words. With dictionary payloads, a word
+ * of frequency f costs -log2(f / total); without, each word costs the
+ * same and the fewest tokens win. Unknown TCCs cost more than any word,
+ * and consecutive ones form a single token.
+ * 
+ * Output follows newmm_segment_spans().
+ * 
+ * @param text Input text (UTF-8 encoded), need not be NUL-terminated
+ * @param len Length of text in bytes
+ * @param dict Pre-loaded dictionary handle from newmm_load_dict()
+ * @param engine Segmentation algorithm
+ * @param starts Caller-owned array receiving token start offsets
+ * @param ends Caller-owned array receiving token end offsets
+ * @param capacity Number of entries available in starts and ends
+ * @return Total number of tokens (may exceed capacity), or -1 on error
+ */
+int newmm_segment_spans_engine(const char* text, size_t len, newmm_dict_t dict,
+                               newmm_engine_t engine, int32_t* starts, int32_t* ends,
+                               size_t capacity);
+
+/* Word ID of tokens that are not dictionary words, see newmm_segment_ids() */
+#define NEWMM_UNKNOWN_ID 0xFFFFFFFFu
+
+/**
+ * @brief Segment Thai text into token boundaries and word IDs
+ * 
+ * Spans follow newmm_segment_spans_engine(). ids[i] is the payload of
+ * the dictionary word the engine matched as token i, or NEWMM_UNKNOWN_ID
+ * when the engine did not match it as a word (unknown TCC runs, spaces,
+ * Latin text, ...). Payloads come from the engine's own lookups, in the
+ * same single pass.
+ * 
+ * @param text Input text (UTF-8 encoded), need not be NUL-terminated
+ * @param len Length of text in bytes
+ * @param dict Pre-loaded dictionary handle from newmm_load_dict()
+ * @param engine Segmentation algorithm
+ * @param starts Caller-owned array receiving token start offsets
+ * @param ends Caller-owned array receiving token end offsets
+ * @param ids Caller-owned array receiving token word IDs
+ * @param capacity Number of entries available in starts, ends and ids
+ * @return Total number of tokens (may exceed capacity), or -1 on error
+ */
+int newmm_segment_ids(const char* text, size_t len, newmm_dict_t dict,
+                      newmm_engine_t engine, int32_t* starts, int32_t* ends,
+                      uint32_t* ids, size_t capacity);
+
+/**
+ * @brief Look up the word ID of a dictionary word
+ * 
+ * @param dict Pre-loaded dictionary handle
+ * @param word Word (UTF-8 encoded), matched exactly
+ * @param len Length of word in bytes
+ * @return Payload of word, or NEWMM_UNKNOWN_ID if it is not in dict
+ */
+uint32_t newmm_word_id(newmm_dict_t dict, const char* word, size_t len);
+
+/**
+ * @brief Segment many texts in parallel using a pre-loaded dictionary
+ * 
+ * Texts are handed out to num_threads workers in small chunks, so a
+ * batch with a few very long texts still keeps every worker busy. The
+ * calling thread is one of the workers. A NULL text is treated as empty.
+ * 
+ * @param texts Input texts (UTF-8 encoded)
+ * @param lens Byte length of each text, or NULL if texts are NUL-terminated
+ * @param num_texts Number of texts
+ * @param dict Pre-loaded dictionary handle from newmm_load_dict()
+ * @param num_threads Number of workers, or 0 to use one per CPU
+ * @param result Output spans, free with newmm_free_batch_result()
+ * @return 0 on success, -1 on error (result is then empty)
+ */
+int newmm_segment_batch(const char* const* texts, const size_t* lens, size_t num_texts,
+                        newmm_dict_t dict, int num_threads, newmm_batch_result_t* result);
+
+/**
+ * @brief Segment one large text using several threads
+ * 
+ * The text is cut into pieces only where the sequential segmentation
+ * provably has a token boundary whose tokens on either side do not
+ * depend on the other side: after an ASCII character (such as a newline,
+ * space or the end of a Latin word) that no dictionary match can reach
+ * across. The pieces are segmented in parallel and stitched together, so
+ * the spans are identical to newmm_segment_spans(). Texts too small to
+ * be worth splitting are segmented on the calling thread.
+ * 
+ * Output follows newmm_segment_spans(): the total number of tokens is
+ * returned and only the first capacity spans are written.
+ * 
+ * @param text Input text (UTF-8 encoded), need not be NUL-terminated
+ * @param len Length of text in bytes
+ * @param dict Pre-loaded dictionary handle from newmm_load_dict()
+ * @param num_threads Number of workers, or 0 to use one per CPU
+ * @param starts Caller-owned array receiving token start offsets
+ * @param ends Caller-owned array receiving token end offsets
+ * @param capacity Number of entries available in starts and ends
+ * @return Total number of tokens (may exceed capacity), or -1 on error
+ */
+int newmm_segment_spans_parallel(const char* text, size_t len, newmm_dict_t dict, int num_threads,
+                                 int32_t* starts, int32_t* ends, size_t capacity);
+
+/**
+ * @brief Free the arrays of a batch result
+ * 
+ * @param result Result filled by newmm_segment_batch()
+ */
+void newmm_free_batch_result(newmm_batch_result_t* result);
+
+/* Reusable segmentation memory, see newmm_ctx_create() */
+typedef struct newmm_ctx newmm_ctx_t;
+
+/**
+ * @brief Create a context holding scratch and result memory
+ * 
+ * Segmenting with a context takes all temporary and result memory from
+ * it instead of the heap. Results stay valid until newmm_ctx_reset(),
+ * which releases them all at once; a context reset between documents of
+ * similar size settles into doing no heap allocation per call. A context
+ * must only be used by one thread at a time.
+ * 
+ * @return New context, or NULL on error
+ */
+newmm_ctx_t* newmm_ctx_create(void);
+
+/**
+ * @brief Release every result of a context in O(1), keeping its memory
+ */
+void newmm_ctx_reset(newmm_ctx_t* ctx);
+
+/**
+ * @brief Free a context and all of its results
+ */
+void newmm_ctx_free(newmm_ctx_t* ctx);
+
+/**
+ * @brief Segment text into token boundaries held by a context
+ * 
+ * Same spans as newmm_segment_spans(), in arrays owned by ctx.
+ * 
+ * @param ctx Context from newmm_ctx_create()
+ * @param text Input text (UTF-8 encoded), need not be NUL-terminated
+ * @param len Length of text in bytes
+ * @param dict Pre-loaded dictionary handle from newmm_load_dict()
+ * @param starts Output: token start offsets, valid until the next reset
+ * @param ends Output: token end offsets, valid until the next reset
+ * @return Number of tokens, or -1 on error
+ */
+int newmm_ctx_segment_spans(newmm_ctx_t* ctx, const char* text, size_t len, newmm_dict_t dict,
+                            const int32_t** starts, const int32_t** ends);
+
+/**
+ * @brief Segment text into token strings held by a context
+ * 
+ * Same tokens as newmm_segment_with_dict_len(). The array and strings
+ * belong to ctx and must not be passed to newmm_free_result().
+ * 
+ * @return Array of tokens valid until the next reset, or NULL on error
+ *         or empty text
+ */
+char** newmm_ctx_segment(newmm_ctx_t* ctx, const char* text, size_t len, newmm_dict_t dict,
+                         int* token_count);
+
+/* Incremental segmenter, see newmm_stream_create() */
+typedef struct newmm_stream newmm_stream_t;
+
+/* Receives each token of a stream: len bytes at token, which start at
+ * byte offset in the whole stream. token is only valid during the call. */
+typedef void (*newmm_token_fn)(const char* token, size_t len, size_t offset, void* user_data);
+
+/**
+ * @brief Create a segmenter that accepts input in arbitrary pieces
+ * 
+ * Tokens are passed to on_token as soon as later input can no longer
+ * change them, and are exactly the tokens a single call on the whole
+ * input would produce. Only the undecided tail is buffered, which is
+ * bounded by about twice the longest dictionary word plus the longest
+ * token, not by the size of the input.
+ * 
+ * @param dict Pre-loaded dictionary handle, must outlive the stream
+ * @param on_token Callback receiving tokens in order
+ * @param user_data Passed through to on_token
+ * @return New stream, or NULL on error
+ */
+newmm_stream_t* newmm_stream_create(newmm_dict_t dict, newmm_token_fn on_token, void* user_data);
+
+/**
+ * @brief Append input to a stream
+ * 
+ * Pieces may split UTF-8 sequences and character clusters anywhere.
+ * 
+ * @return 0 on success, -1 on error (the stream is then unusable)
+ */
+int newmm_stream_feed(newmm_stream_t* stream, const char* data, size_t len);
+
+/**
+ * @brief Emit all remaining tokens at the end of the input
+ * 
+ * The stream can then be fed again; offsets continue from where the
+ * previous input ended.
+ * 
+ * @return 0 on success, -1 on error
+ */
+int newmm_stream_finish(newmm_stream_t* stream);
+
+/**
+ * @brief Free a stream without emitting buffered tokens
+ */
+void newmm_stream_free(newmm_stream_t* stream);
+
 /**
  * @brief Segment Thai text into words using newmm algorithm
  * 
+ * The dictionary is loaded on first use and then kept in the cache of
+ * newmm_dict_cache_get(), so later calls with the same path do not
+ * parse it again.
+ * 
  * @param text Input Thai text to be segmented (UTF-8 encoded)
  * @param dict_path Path to dictionary file (one word per line, UTF-8 encoded)
- *                  If NULL, uses a default minimal dictionary
+ *                  If NULL, uses the default dictionary
  * @param token_count Output parameter for number of tokens found
  * @return Array of strings (tokens), caller must free using newmm_free_result()
  *         Returns NULL on error
  */
 char** newmm_segment(const char* text, const char* dict_path, int* token_count);
 
+/**
+ * @brief Segment the len bytes at text using newmm algorithm
+ * 
+ * Same as newmm_segment(), but text need not be NUL-terminated.
+ * 
+ * @param text Input Thai text to be segmented (UTF-8 encoded)
+ * @param len Length of text in bytes
+ * @param dict_path Path to dictionary file, or NULL for the default dictionary
+ * @param token_count Output parameter for number of tokens found
+ * @return Array of strings (tokens), caller must free using newmm_free_result()
+ *         Returns NULL on error
+ */
+char** newmm_segment_len(const char* text, size_t len, const char* dict_path, int* token_count);
+
 /**
  * @brief Free memory allocated by newmm_segment
  * 
@@ -70,6 +539,110 @@ char** newmm_segment(const char* text, const char* dict_path, int* token_count);
  */
 void newmm_free_result(char** tokens, int token_count);
 
+/* Work done by segmentation on one thread, see newmm_stats_get(). Counts
+ * describe work rather than output: a streamed or parallel call may
+ * segment some bytes more than once. */
+typedef struct {
+    uint64_t calls;              /* Passes of the segmenter over a text or piece */
+    uint64_t bytes;              /* Input bytes segmented */
+    uint64_t tcc_clusters;       /* Thai character clusters found */
+    uint64_t prefix_queries;     /* Dictionary lookups at token starts */
+    uint64_t lookahead_queries;  /* Lookups past a candidate word */
+    uint64_t memo_hits;          /* Lookups of either kind answered without the trie */
+    uint64_t unknown_words;      /* Thai stretches with no dictionary word */
+    uint64_t tokens;             /* Tokens produced */
+    uint64_t bytes_allocated;    /* Scratch and output memory requested */
+    uint64_t tcc_ns;             /* Time finding cluster boundaries */
+    uint64_t match_ns;           /* Time choosing tokens, lookups included */
+    uint64_t output_ns;          /* Time copying tokens into strings */
+} newmm_stats_t;
+
+/**
+ * @brief Turn statistics collection on or off for all threads
+ * 
+ * Collection is off by default. While on, each segmentation call adds
+ * to the calling thread's counters: a few increments per call and two
+ * or three clock reads. Multi-threaded calls add their workers' counts
+ * to the calling thread.
+ * 
+ * @return 0 on success, -1 if the library was built with NEWMM_NO_STATS
+ */
+int newmm_stats_enable(int enabled);
+
+/**
+ * @brief Get the calling thread's counters since its last reset
+ */
+void newmm_stats_get(newmm_stats_t* stats);
+
+/**
+ * @brief Zero the calling thread's counters
+ */
+void newmm_stats_reset(void);
+
+/* Bounded cache of the spans of repeated inputs, see
+ * newmm_span_cache_create() */
+typedef struct newmm_span_cache newmm_span_cache_t;
+
+/* Counters of a span cache, see newmm_span_cache_get_stats() */
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t entries;    /* Results held */
+    size_t capacity;   /* Results that fit */
+} newmm_span_cache_stats_t;
+
+/**
+ * @brief Create a cache of segmentation results for repeated inputs
+ * 
+ * Results are keyed by a hash of the text, checked byte for byte, plus
+ * the dictionary and engine that produced them. Dictionaries are told
+ * apart by an id given at load time, not by address, so once a handle
+ * is swapped (for example with newmm_dict_slot_set()) or released, its
+ * results are never returned for another dictionary; they are evicted
+ * as the cache fills. The cache may be shared by any number of threads.
+ * 
+ * @param max_entries Results kept, rounded up to a multiple of 16; 0
+ *                    creates a disabled cache
+ * @param max_text_len Longer texts bypass the cache; 0 for 256 bytes
+ * @return New cache, or NULL on allocation failure
+ */
+newmm_span_cache_t* newmm_span_cache_create(size_t max_entries, size_t max_text_len);
+
+/**
+ * @brief Segment through a span cache
+ * 
+ * Same contract as newmm_segment_spans_engine(). A miss segments text
+ * and keeps the result if it fits in capacity; a hit copies it.
+ * 
+ * @return Total number of tokens (may exceed capacity), or -1 on error
+ */
+int newmm_span_cache_segment(newmm_span_cache_t* cache, const char* text, size_t len,
+                             newmm_dict_t dict, newmm_engine_t engine,
+                             int32_t* starts, int32_t* ends, size_t capacity);
+
+/**
+ * @brief Drop every result and change how many are kept
+ * 
+ * @return 0 on success, -1 on error (the cache is then disabled)
+ */
+int newmm_span_cache_resize(newmm_span_cache_t* cache, size_t max_entries);
+
+/**
+ * @brief Get the counters of a cache since it was created or cleared
+ */
+void newmm_span_cache_get_stats(newmm_span_cache_t* cache, newmm_span_cache_stats_t* stats);
+
+/**
+ * @brief Drop every result and zero the counters
+ */
+void newmm_span_cache_clear(newmm_span_cache_t* cache);
+
+/**
+ * @brief Free a cache and its results
+ */
+void newmm_span_cache_free(newmm_span_cache_t* cache);
+
 #ifdef __cplusplus
 }
 #endif
@@ -9,60 +9,131 @@
 #include <stdlib.h>
 #include "newmm.h"
 
-/* Module-level dictionary cache */
-static struct {
-    newmm_dict_t dict;
-    char* dict_path;
-} dict_cache = {NULL, NULL};
+/* Span cache used by the single-text functions once set_span_cache_size()
+ * enables it. Created once with the GIL held and only resized after, so
+ * calls that released the GIL never see it freed. */
+static newmm_span_cache_t* span_cache = NULL;
 
 /**
  * Load or retrieve cached dictionary
+ * 
+ * Dictionaries come from the library's process-wide cache, which reloads
+ * one whose file changed. Called with the GIL held; it is released while
+ * a dictionary loads. Returns a reference to pass to release_dict(), or
+ * NULL with a Python exception set.
  */
-static newmm_dict_t get_or_load_dict(const char* dict_path) {
-    /* Check if we need to reload the dictionary */
-    int need_reload = 0;
-    
-    if (dict_cache.dict == NULL) {
-        /* No cached dict */
-        need_reload = 1;
-    } else if (dict_path == NULL && dict_cache.dict_path != NULL) {
-        /* Switching from custom to default */
-        need_reload = 1;
-    } else if (dict_path != NULL && dict_cache.dict_path == NULL) {
-        /* Switching from default to custom */
-        need_reload = 1;
-    } else if (dict_path != NULL && dict_cache.dict_path != NULL) {
-        /* Both custom, check if path changed */
-        if (strcmp(dict_path, dict_cache.dict_path) != 0) {
-            need_reload = 1;
-        }
+static newmm_dict_t acquire_dict(const char* dict_path) {
+    newmm_dict_t dict;
+    Py_BEGIN_ALLOW_THREADS
+    dict = newmm_dict_cache_get(dict_path);
+    Py_END_ALLOW_THREADS
+    if (!dict) {
+        PyErr_SetString(PyExc_MemoryError, "Failed to load dictionary (out of memory)");
     }
+    return dict;
+}
+
+static void release_dict(newmm_dict_t dict) {
+    newmm_dict_release(dict);
+}
+
+/* Segment one UTF-8 buffer into raw-malloc'd spans without the GIL.
+ * Returns the token count, or -1 on failure. */
+static int segment_spans_nogil(const char* text, size_t len, newmm_dict_t dict,
+                               int32_t** starts, int32_t** ends) {
+    /* Retry once if the size estimate is short */
+    size_t capacity = len / 8 + 16;
+    int token_count = -1;
+    *starts = NULL;
+    *ends = NULL;
     
-    if (need_reload) {
-        /* Free old dictionary */
-        if (dict_cache.dict) {
-            newmm_free_dict(dict_cache.dict);
-            dict_cache.dict = NULL;
-        }
-        if (dict_cache.dict_path) {
-            free(dict_cache.dict_path);
-            dict_cache.dict_path = NULL;
-        }
+    for (int attempt = 0; attempt < 2; attempt++) {
+        int32_t* new_starts = (int32_t*)PyMem_RawRealloc(*starts, capacity * sizeof(int32_t));
+        if (new_starts) *starts = new_starts;
+        int32_t* new_ends = (int32_t*)PyMem_RawRealloc(*ends, capacity * sizeof(int32_t));
+        if (new_ends) *ends = new_ends;
+        if (!new_starts || !new_ends) return -1;
         
-        /* Load new dictionary */
-        dict_cache.dict = newmm_load_dict(dict_path);
-        if (dict_cache.dict && dict_path) {
-            dict_cache.dict_path = strdup(dict_path);
-            if (!dict_cache.dict_path) {
-                /* strdup failed, clean up and return NULL */
-                newmm_free_dict(dict_cache.dict);
-                dict_cache.dict = NULL;
-                return NULL;
+        token_count = span_cache
+            ? newmm_span_cache_segment(span_cache, text, len, dict, NEWMM_ENGINE_GREEDY,
+                                       *starts, *ends, capacity)
+            : newmm_segment_spans(text, len, dict, *starts, *ends, capacity);
+        if (token_count < 0 || (size_t)token_count <= capacity) break;
+        capacity = (size_t)token_count;
+    }
+    
+    return token_count;
+}
+
+/* Build a list of str from spans of text */
+static PyObject* spans_to_list(const char* text, const int32_t* starts, const int32_t* ends,
+                               Py_ssize_t count) {
+    PyObject* result = PyList_New(count);
+    for (Py_ssize_t i = 0; result && i < count; i++) {
+        PyObject* token_str = PyUnicode_DecodeUTF8(text + starts[i], ends[i] - starts[i], NULL);
+        if (!token_str) {
+            Py_CLEAR(result);
+            break;
+        }
+        PyList_SET_ITEM(result, i, token_str);
+    }
+    return result;
+}
+
+/* Offsets and IDs are returned as array('i') and array('I'), whose items
+ * are C ints */
+typedef char int_is_32_bits[sizeof(int) == sizeof(int32_t) ? 1 : -1];
+
+/* Parse the unit argument of the offset functions: 1 for codepoints,
+ * 0 for bytes, or -1 with ValueError set */
+static int parse_unit(const char* unit) {
+    if (strcmp(unit, "codepoint") == 0) return 1;
+    if (strcmp(unit, "byte") == 0) return 0;
+    PyErr_Format(PyExc_ValueError, "unit must be 'codepoint' or 'byte', not '%.100s'", unit);
+    return -1;
+}
+
+/* Write the count + 1 token boundaries of contiguous spans ending at
+ * ends, converted from bytes of text to codepoints if asked. Does not
+ * need the GIL. */
+static void spans_to_boundaries(const char* text, const int32_t* ends, size_t count,
+                                int codepoints, int32_t* boundaries) {
+    const unsigned char* s = (const unsigned char*)text;
+    size_t pos = 0;
+    int32_t index = 0;
+    boundaries[0] = 0;
+    
+    for (size_t i = 0; i < count; i++) {
+        if (codepoints) {
+            /* Step over whole characters; str encodes to valid UTF-8 */
+            while (pos < (size_t)ends[i]) {
+                unsigned char c = s[pos];
+                pos += c < 0x80 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+                index++;
             }
+            boundaries[i + 1] = index;
+        } else {
+            boundaries[i + 1] = ends[i];
         }
     }
+}
+
+/* Copy size bytes of C values into a new array.array of typecode */
+static PyObject* new_array(const char* typecode, const void* data, size_t size) {
+    static PyObject* array_type = NULL;
+    if (!array_type) {
+        PyObject* module = PyImport_ImportModule("array");
+        if (!module) return NULL;
+        array_type = PyObject_GetAttrString(module, "array");
+        Py_DECREF(module);
+        if (!array_type) return NULL;
+    }
     
-    return dict_cache.dict;
+    PyObject* bytes = PyBytes_FromStringAndSize((const char*)data, (Py_ssize_t)size);
+    if (!bytes) return NULL;
+    PyObject* result = PyObject_CallFunction(array_type, "sO", typecode, bytes);
+    Py_DECREF(bytes);
+    return result;
 }
 
 /**
@@ -70,49 +141,338 @@ static newmm_dict_t get_or_load_dict(const char* dict_path) {
  */
 static PyObject* py_newmm_segment(PyObject* Py_UNUSED(self), PyObject* args, PyObject* kwargs) {
     const char* text;
+    Py_ssize_t text_len;
     const char* dict_path = NULL;
-    int token_count;
     
     /* Parse arguments */
     static char* kwlist[] = {"text", "dict_path", NULL};
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|z", kwlist, &text, &dict_path)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s#|z", kwlist, &text, &text_len, &dict_path)) {
         return NULL;
     }
     
     /* Get or load dictionary */
-    newmm_dict_t dict = get_or_load_dict(dict_path);
-    if (!dict) {
-        PyErr_SetString(PyExc_MemoryError, "Failed to load dictionary (out of memory)");
+    newmm_dict_t dict = acquire_dict(dict_path);
+    if (!dict) return NULL;
+    
+    /* The UTF-8 buffer belongs to the argument, which outlives the call */
+    int32_t* starts;
+    int32_t* ends;
+    int token_count;
+    Py_BEGIN_ALLOW_THREADS
+    token_count = segment_spans_nogil(text, (size_t)text_len, dict, &starts, &ends);
+    Py_END_ALLOW_THREADS
+    
+    release_dict(dict);
+    
+    PyObject* result = NULL;
+    if (token_count < 0) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to segment text");
+    } else {
+        result = spans_to_list(text, starts, ends, token_count);
+    }
+    
+    PyMem_RawFree(starts);
+    PyMem_RawFree(ends);
+    
+    return result;
+}
+
+/**
+ * Python wrapper for newmm_segment_batch function
+ */
+static PyObject* py_newmm_segment_batch(PyObject* Py_UNUSED(self), PyObject* args, PyObject* kwargs) {
+    PyObject* texts_arg;
+    const char* dict_path = NULL;
+    int num_threads = 0;
+    
+    /* Parse arguments */
+    static char* kwlist[] = {"texts", "dict_path", "num_threads", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|zi", kwlist,
+                                     &texts_arg, &dict_path, &num_threads)) {
+        return NULL;
+    }
+    
+    /* A tuple copy keeps every str alive even if the caller's list is
+     * changed while the GIL is released */
+    PyObject* texts = PySequence_Tuple(texts_arg);
+    if (!texts) return NULL;
+    
+    Py_ssize_t n = PyTuple_GET_SIZE(texts);
+    const char** buffers = (const char**)PyMem_Malloc((n > 0 ? n : 1) * sizeof(char*));
+    size_t* lens = (size_t*)PyMem_Malloc((n > 0 ? n : 1) * sizeof(size_t));
+    if (!buffers || !lens) {
+        PyMem_Free(buffers);
+        PyMem_Free(lens);
+        Py_DECREF(texts);
+        return PyErr_NoMemory();
+    }
+    
+    for (Py_ssize_t i = 0; i < n; i++) {
+        PyObject* item = PyTuple_GET_ITEM(texts, i);
+        Py_ssize_t len;
+        if (!PyUnicode_Check(item)) {
+            PyErr_Format(PyExc_TypeError, "texts[%zd] must be a string, got %.200s",
+                         i, Py_TYPE(item)->tp_name);
+            break;
+        }
+        buffers[i] = PyUnicode_AsUTF8AndSize(item, &len);
+        if (!buffers[i]) break;
+        lens[i] = (size_t)len;
+    }
+    
+    newmm_dict_t dict = PyErr_Occurred() ? NULL : acquire_dict(dict_path);
+    PyObject* result = NULL;
+    
+    if (dict) {
+        newmm_batch_result_t batch;
+        int status;
+        Py_BEGIN_ALLOW_THREADS
+        status = newmm_segment_batch(buffers, lens, (size_t)n, dict, num_threads, &batch);
+        Py_END_ALLOW_THREADS
+        
+        release_dict(dict);
+        
+        if (status != 0) {
+            PyErr_SetString(PyExc_RuntimeError, "Failed to segment texts");
+        } else {
+            /* Convert to a list of token lists */
+            result = PyList_New(n);
+            for (Py_ssize_t i = 0; result && i < n; i++) {
+                size_t first = batch.offsets[i];
+                PyObject* tokens = spans_to_list(buffers[i], batch.starts + first,
+                                                 batch.ends + first,
+                                                 (Py_ssize_t)(batch.offsets[i + 1] - first));
+                if (!tokens) {
+                    Py_CLEAR(result);
+                    break;
+                }
+                PyList_SET_ITEM(result, i, tokens);
+            }
+            newmm_free_batch_result(&batch);
+        }
+    }
+    
+    PyMem_Free(buffers);
+    PyMem_Free(lens);
+    Py_DECREF(texts);
+    
+    return result;
+}
+
+/**
+ * Token boundaries of one text as array('i'), with no str per token
+ */
+static PyObject* py_newmm_segment_offsets(PyObject* Py_UNUSED(self), PyObject* args, PyObject* kwargs) {
+    const char* text;
+    Py_ssize_t text_len;
+    const char* dict_path = NULL;
+    const char* unit = "codepoint";
+    
+    static char* kwlist[] = {"text", "dict_path", "unit", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s#|zs", kwlist,
+                                     &text, &text_len, &dict_path, &unit)) {
         return NULL;
     }
+    int codepoints = parse_unit(unit);
+    if (codepoints < 0) return NULL;
+    
+    newmm_dict_t dict = acquire_dict(dict_path);
+    if (!dict) return NULL;
+    
+    int32_t* starts;
+    int32_t* ends;
+    int32_t* boundaries = NULL;
+    int token_count;
+    Py_BEGIN_ALLOW_THREADS
+    token_count = segment_spans_nogil(text, (size_t)text_len, dict, &starts, &ends);
+    if (token_count >= 0) {
+        boundaries = (int32_t*)PyMem_RawMalloc(((size_t)token_count + 1) * sizeof(int32_t));
+        if (boundaries) {
+            spans_to_boundaries(text, ends, (size_t)token_count, codepoints, boundaries);
+        }
+    }
+    Py_END_ALLOW_THREADS
     
-    /* Call C function with cached dictionary */
-    char** tokens = newmm_segment_with_dict(text, dict, &token_count);
+    release_dict(dict);
     
-    if (!tokens) {
+    PyObject* result = NULL;
+    if (token_count < 0) {
         PyErr_SetString(PyExc_RuntimeError, "Failed to segment text");
+    } else if (!boundaries) {
+        PyErr_NoMemory();
+    } else {
+        result = new_array("i", boundaries, ((size_t)token_count + 1) * sizeof(int32_t));
+    }
+    
+    PyMem_RawFree(starts);
+    PyMem_RawFree(ends);
+    PyMem_RawFree(boundaries);
+    
+    return result;
+}
+
+/**
+ * Token boundaries as array('i') plus the word ID of each token as
+ * array('I')
+ */
+static PyObject* py_newmm_segment_ids(PyObject* Py_UNUSED(self), PyObject* args, PyObject* kwargs) {
+    const char* text;
+    Py_ssize_t text_len;
+    const char* dict_path = NULL;
+    const char* unit = "codepoint";
+    
+    static char* kwlist[] = {"text", "dict_path", "unit", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s#|zs", kwlist,
+                                     &text, &text_len, &dict_path, &unit)) {
         return NULL;
     }
+    int codepoints = parse_unit(unit);
+    if (codepoints < 0) return NULL;
     
-    /* Convert result to Python list */
-    PyObject* result = PyList_New(token_count);
-    if (!result) {
-        newmm_free_result(tokens, token_count);
+    newmm_dict_t dict = acquire_dict(dict_path);
+    if (!dict) return NULL;
+    
+    int32_t* starts;
+    int32_t* ends;
+    int32_t* boundaries = NULL;
+    uint32_t* ids = NULL;
+    int token_count;
+    Py_BEGIN_ALLOW_THREADS
+    token_count = segment_spans_nogil(text, (size_t)text_len, dict, &starts, &ends);
+    if (token_count >= 0) {
+        boundaries = (int32_t*)PyMem_RawMalloc(((size_t)token_count + 1) * sizeof(int32_t));
+        ids = (uint32_t*)PyMem_RawMalloc(((size_t)token_count + 1) * sizeof(uint32_t));
+        if (boundaries && ids) {
+            spans_to_boundaries(text, ends, (size_t)token_count, codepoints, boundaries);
+            for (int i = 0; i < token_count; i++) {
+                ids[i] = newmm_word_id(dict, text + starts[i], (size_t)(ends[i] - starts[i]));
+            }
+        }
+    }
+    Py_END_ALLOW_THREADS
+    
+    release_dict(dict);
+    
+    PyObject* result = NULL;
+    if (token_count < 0) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to segment text");
+    } else if (!boundaries || !ids) {
+        PyErr_NoMemory();
+    } else {
+        PyObject* offsets = new_array("i", boundaries, ((size_t)token_count + 1) * sizeof(int32_t));
+        PyObject* id_array = offsets ? new_array("I", ids, (size_t)token_count * sizeof(uint32_t))
+                                     : NULL;
+        if (offsets && id_array) result = PyTuple_Pack(2, offsets, id_array);
+        Py_XDECREF(offsets);
+        Py_XDECREF(id_array);
+    }
+    
+    PyMem_RawFree(starts);
+    PyMem_RawFree(ends);
+    PyMem_RawFree(boundaries);
+    PyMem_RawFree(ids);
+    
+    return result;
+}
+
+/**
+ * Token boundaries of many texts as flat array('i') plus array('q') row
+ * pointers, segmented by native threads
+ */
+static PyObject* py_newmm_segment_offsets_batch(PyObject* Py_UNUSED(self), PyObject* args,
+                                                PyObject* kwargs) {
+    PyObject* texts_arg;
+    const char* dict_path = NULL;
+    int num_threads = 0;
+    const char* unit = "codepoint";
+    
+    static char* kwlist[] = {"texts", "dict_path", "num_threads", "unit", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|zis", kwlist,
+                                     &texts_arg, &dict_path, &num_threads, &unit)) {
         return NULL;
     }
+    int codepoints = parse_unit(unit);
+    if (codepoints < 0) return NULL;
     
-    for (int i = 0; i < token_count; i++) {
-        PyObject* token_str = PyUnicode_FromString(tokens[i]);
-        if (!token_str) {
-            Py_DECREF(result);
-            newmm_free_result(tokens, token_count);
-            return NULL;
+    /* As in segment_batch(), the tuple keeps every str alive */
+    PyObject* texts = PySequence_Tuple(texts_arg);
+    if (!texts) return NULL;
+    
+    Py_ssize_t n = PyTuple_GET_SIZE(texts);
+    const char** buffers = (const char**)PyMem_Malloc((n > 0 ? n : 1) * sizeof(char*));
+    size_t* lens = (size_t*)PyMem_Malloc((n > 0 ? n : 1) * sizeof(size_t));
+    if (!buffers || !lens) {
+        PyMem_Free(buffers);
+        PyMem_Free(lens);
+        Py_DECREF(texts);
+        return PyErr_NoMemory();
+    }
+    
+    for (Py_ssize_t i = 0; i < n; i++) {
+        PyObject* item = PyTuple_GET_ITEM(texts, i);
+        Py_ssize_t len;
+        if (!PyUnicode_Check(item)) {
+            PyErr_Format(PyExc_TypeError, "texts[%zd] must be a string, got %.200s",
+                         i, Py_TYPE(item)->tp_name);
+            break;
         }
-        PyList_SET_ITEM(result, i, token_str);
+        buffers[i] = PyUnicode_AsUTF8AndSize(item, &len);
+        if (!buffers[i]) break;
+        lens[i] = (size_t)len;
+    }
+    
+    newmm_dict_t dict = PyErr_Occurred() ? NULL : acquire_dict(dict_path);
+    PyObject* result = NULL;
+    
+    if (dict) {
+        newmm_batch_result_t batch;
+        int32_t* boundaries = NULL;
+        long long* indptr = NULL;
+        size_t total = 0;
+        int status;
+        Py_BEGIN_ALLOW_THREADS
+        status = newmm_segment_batch(buffers, lens, (size_t)n, dict, num_threads, &batch);
+        if (status == 0) {
+            /* Text i has offsets[i + 1] - offsets[i] tokens, so one more
+             * boundary; rows start at offsets[i] + i */
+            total = batch.offsets[n] + (size_t)n;
+            boundaries = (int32_t*)PyMem_RawMalloc((total > 0 ? total : 1) * sizeof(int32_t));
+            indptr = (long long*)PyMem_RawMalloc(((size_t)n + 1) * sizeof(long long));
+            if (boundaries && indptr) {
+                for (Py_ssize_t i = 0; i < n; i++) {
+                    size_t first = batch.offsets[i];
+                    indptr[i] = (long long)(first + (size_t)i);
+                    spans_to_boundaries(buffers[i], batch.ends + first,
+                                        batch.offsets[i + 1] - first, codepoints,
+                                        boundaries + indptr[i]);
+                }
+                indptr[n] = (long long)total;
+            }
+            newmm_free_batch_result(&batch);
+        }
+        Py_END_ALLOW_THREADS
+        
+        release_dict(dict);
+        
+        if (status != 0) {
+            PyErr_SetString(PyExc_RuntimeError, "Failed to segment texts");
+        } else if (!boundaries || !indptr) {
+            PyErr_NoMemory();
+        } else {
+            PyObject* flat = new_array("i", boundaries, total * sizeof(int32_t));
+            PyObject* rows = flat ? new_array("q", indptr, ((size_t)n + 1) * sizeof(long long))
+                                  : NULL;
+            if (rows) result = PyTuple_Pack(2, flat, rows);
+            Py_XDECREF(flat);
+            Py_XDECREF(rows);
+        }
+        PyMem_RawFree(boundaries);
+        PyMem_RawFree(indptr);
     }
     
-    /* Free C memory */
-    newmm_free_result(tokens, token_count);
+    PyMem_Free(buffers);
+    PyMem_Free(lens);
+    Py_DECREF(texts);
     
     return result;
 }
@@ -121,17 +481,42 @@ static PyObject* py_newmm_segment(PyObject* Py_UNUSED(self), PyObject* args, PyO
  * Clear cached dictionary
  */
 static PyObject* py_clear_cache(PyObject* Py_UNUSED(self), PyObject* Py_UNUSED(args)) {
-    if (dict_cache.dict) {
-        newmm_free_dict(dict_cache.dict);
-        dict_cache.dict = NULL;
+    newmm_clear_dict_cache();
+    Py_RETURN_NONE;
+}
+
+static PyObject* py_set_span_cache_size(PyObject* Py_UNUSED(self), PyObject* args) {
+    Py_ssize_t max_entries;
+    if (!PyArg_ParseTuple(args, "n", &max_entries)) return NULL;
+    if (max_entries < 0) {
+        PyErr_SetString(PyExc_ValueError, "max_entries must not be negative");
+        return NULL;
     }
-    if (dict_cache.dict_path) {
-        free(dict_cache.dict_path);
-        dict_cache.dict_path = NULL;
+    
+    int status;
+    if (!span_cache) {
+        span_cache = newmm_span_cache_create((size_t)max_entries, 0);
+        status = span_cache ? 0 : -1;
+    } else {
+        Py_BEGIN_ALLOW_THREADS
+        status = newmm_span_cache_resize(span_cache, (size_t)max_entries);
+        Py_END_ALLOW_THREADS
     }
+    if (status != 0) return PyErr_NoMemory();
     Py_RETURN_NONE;
 }
 
+static PyObject* py_span_cache_info(PyObject* Py_UNUSED(self), PyObject* Py_UNUSED(args)) {
+    newmm_span_cache_stats_t stats;
+    newmm_span_cache_get_stats(span_cache, &stats);
+    return Py_BuildValue("{s:K,s:K,s:K,s:n,s:n}",
+                         "hits", (unsigned long long)stats.hits,
+                         "misses", (unsigned long long)stats.misses,
+                         "evictions", (unsigned long long)stats.evictions,
+                         "entries", (Py_ssize_t)stats.entries,
+                         "capacity", (Py_ssize_t)stats.capacity);
+}
+
 /**
  * Module method definitions
  */
@@ -141,6 +526,8 @@ static PyMethodDef CThaiNLPMethods[] = {
         (PyCFunction)py_newmm_segment,
         METH_VARARGS | METH_KEYWORDS,
         "Segment Thai text into words using newmm algorithm.\n\n"
+        "The GIL is released while segmenting, so calls from several\n"
+        "threads run in parallel.\n\n"
         "Args:\n"
         "    text (str): Input Thai text to segment (UTF-8 encoded)\n"
         "    dict_path (str, optional): Path to dictionary file. If None, uses default.\n\n"
@@ -152,12 +539,103 @@ static PyMethodDef CThaiNLPMethods[] = {
         "    >>> print(tokens)\n"
         "    ['ฉัน', 'ไป', 'โรงเรียน']\n"
     },
+    {
+        "segment_batch",
+        (PyCFunction)py_newmm_segment_batch,
+        METH_VARARGS | METH_KEYWORDS,
+        "Segment a sequence of texts in one call using native threads.\n\n"
+        "Args:\n"
+        "    texts (sequence of str): Input texts\n"
+        "    dict_path (str, optional): Path to dictionary file. If None, uses default.\n"
+        "    num_threads (int, optional): Worker threads, 0 for one per CPU.\n\n"
+        "Returns:\n"
+        "    list: One list of string tokens per input text\n\n"
+        "Example:\n"
+        "    >>> from cthainlp import _cthainlp\n"
+        "    >>> _cthainlp.segment_batch(['ฉันไปโรงเรียน', 'hello world'])\n"
+        "    [['ฉัน', 'ไป', 'โรงเรียน'], ['hello', ' ', 'world']]\n"
+    },
+    {
+        "segment_offsets",
+        (PyCFunction)py_newmm_segment_offsets,
+        METH_VARARGS | METH_KEYWORDS,
+        "Segment text and return token boundaries instead of strings.\n\n"
+        "Token i is text[offsets[i]:offsets[i + 1]]. No str is created per\n"
+        "token, and the result supports the buffer protocol, so\n"
+        "numpy.frombuffer(offsets, dtype=numpy.int32) does not copy it.\n\n"
+        "Args:\n"
+        "    text (str): Input text\n"
+        "    dict_path (str, optional): Path to dictionary file. If None, uses default.\n"
+        "    unit (str, optional): 'codepoint' (default) for str indices, or\n"
+        "        'byte' for offsets into the UTF-8 encoding.\n\n"
+        "Returns:\n"
+        "    array.array: Token count + 1 boundaries, typecode 'i'\n\n"
+        "Example:\n"
+        "    >>> from cthainlp import _cthainlp\n"
+        "    >>> _cthainlp.segment_offsets('ฉันไปโรงเรียน')\n"
+        "    array('i', [0, 3, 5, 13])\n"
+    },
+    {
+        "segment_ids",
+        (PyCFunction)py_newmm_segment_ids,
+        METH_VARARGS | METH_KEYWORDS,
+        "Segment text and return token boundaries with the word ID of each token.\n\n"
+        "ids[i] is the payload the dictionary stores for token i: the number\n"
+        "after a tab on its line, or else the index of its line. Tokens that\n"
+        "are not dictionary words get UNKNOWN_ID.\n\n"
+        "Args:\n"
+        "    text (str): Input text\n"
+        "    dict_path (str, optional): Path to dictionary file. If None, uses default.\n"
+        "    unit (str, optional): 'codepoint' (default) or 'byte'.\n\n"
+        "Returns:\n"
+        "    tuple: (offsets, ids) as array('i') laid out as by segment_offsets()\n"
+        "        and array('I') with one entry per token\n"
+    },
+    {
+        "segment_offsets_batch",
+        (PyCFunction)py_newmm_segment_offsets_batch,
+        METH_VARARGS | METH_KEYWORDS,
+        "Segment many texts and return all token boundaries in two arrays.\n\n"
+        "The boundaries of texts[i] are offsets[indptr[i]:indptr[i + 1]],\n"
+        "laid out as by segment_offsets().\n\n"
+        "Args:\n"
+        "    texts (sequence of str): Input texts\n"
+        "    dict_path (str, optional): Path to dictionary file. If None, uses default.\n"
+        "    num_threads (int, optional): Worker threads, 0 for one per CPU.\n"
+        "    unit (str, optional): 'codepoint' (default) or 'byte'.\n\n"
+        "Returns:\n"
+        "    tuple: (offsets, indptr) as array('i') and array('q')\n"
+    },
     {
         "clear_cache",
         py_clear_cache,
         METH_NOARGS,
-        "Clear the cached dictionary.\n\n"
-        "This forces the next tokenization to reload the dictionary.\n"
+        "Clear the cached dictionaries.\n\n"
+        "Up to four dictionaries stay loaded, keyed by path, and one is\n"
+        "reloaded automatically when its file changes. This forces the\n"
+        "next tokenization to reload the dictionary.\n"
+    },
+    {
+        "set_span_cache_size",
+        py_set_span_cache_size,
+        METH_VARARGS,
+        "Keep the tokens of recently segmented texts for reuse.\n\n"
+        "segment(), segment_offsets() and segment_ids() then look repeated\n"
+        "texts of up to 256 UTF-8 bytes up in a shared cache before\n"
+        "segmenting them. Results are tied to the dictionary that made\n"
+        "them, so reloading an edited dictionary file never returns stale\n"
+        "tokens. Changing the size drops every cached result.\n\n"
+        "Args:\n"
+        "    max_entries (int): Results kept (rounded up to a multiple of 16),\n"
+        "        or 0 to disable the cache (the default).\n"
+    },
+    {
+        "span_cache_info",
+        py_span_cache_info,
+        METH_NOARGS,
+        "Get the counters of the span cache.\n\n"
+        "Returns:\n"
+        "    dict: hits, misses, evictions, entries and capacity\n"
     },
     {NULL, NULL, 0, NULL}  /* Sentinel */
 };
@@ -181,15 +659,10 @@ static struct PyModuleDef cthainlp_module = {
  * Module cleanup function
  */
 static void module_free(void* Py_UNUSED(self)) {
-    /* Clean up cached dictionary on module unload */
-    if (dict_cache.dict) {
-        newmm_free_dict(dict_cache.dict);
-        dict_cache.dict = NULL;
-    }
-    if (dict_cache.dict_path) {
-        free(dict_cache.dict_path);
-        dict_cache.dict_path = NULL;
-    }
+    /* Clean up cached dictionaries and results on module unload */
+    newmm_clear_dict_cache();
+    newmm_span_cache_free(span_cache);
+    span_cache = NULL;
 }
 
 /**
@@ -198,5 +671,10 @@ static void module_free(void* Py_UNUSED(self)) {
 PyMODINIT_FUNC PyInit__cthainlp(void) {
     /* Update module definition with cleanup function */
     cthainlp_module.m_free = module_free;
-    return PyModule_Create(&cthainlp_module);
+    PyObject* module = PyModule_Create(&cthainlp_module);
+    if (module && PyModule_AddObject(module, "UNKNOWN_ID",
+                                     PyLong_FromUnsignedLong(NEWMM_UNKNOWN_ID)) < 0) {
+        Py_CLEAR(module);
+    }
+    return module;
 }
@@ -12,21 +12,40 @@ with open("README.md", "r", encoding="utf-8") as fh:
 if sys.platform == "win32":
     # MSVC compiler flags
     extra_compile_args = ["/W3", "/O2"]
+    extra_link_args = []
 else:
     # GCC/Clang compiler flags
-    extra_compile_args = ["-Wall", "-Wextra", "-O2"]
+    extra_compile_args = ["-Wall", "-Wextra", "-O2", "-pthread"]
+    extra_link_args = ["-pthread"]
+
+# Default dictionary compiled into the extension: the full word list
+# generated by `make`, or the small fallback shipped in src/
+default_dict_source = "build/default_dict.c"
+if not os.path.exists(default_dict_source):
+    default_dict_source = "src/default_dict.c"
 
 # Define the C extension module
 cthainlp_extension = Extension(
     name="_cthainlp",
     sources=[
         "src/trie.c",
+        "src/datrie.c",
         "src/tcc.c",
         "src/newmm.c",
+        "src/batch.c",
+        "src/stream.c",
+        "src/arena.c",
+        "src/ctx.c",
+        "src/dict.c",
+        "src/overlay.c",
+        "src/stats.c",
+        "src/cache.c",
+        default_dict_source,
         "python/cthainlp_wrapper.c",
     ],
-    include_dirs=["include"],
+    include_dirs=["include", "src"],
     extra_compile_args=extra_compile_args,
+    extra_link_args=extra_link_args,
 )
 
 setup(
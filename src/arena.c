@@ -0,0 +1,68 @@
+/**
+ * @file arena.c
+ * @brief Bump allocator for per-call scratch and result memory
+ */
+
+#include "arena.h"
+#include <stdlib.h>
+
+/* Smallest block worth allocating */
+#define ARENA_MIN_BLOCK (64 * 1024)
+
+static ArenaBlock* block_create(size_t size) {
+    ArenaBlock* block = (ArenaBlock*)malloc(ARENA_HEADER_SIZE + size);
+    if (!block) return NULL;
+    
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+void arena_init(Arena* arena) {
+    arena->head = NULL;
+    arena->total = 0;
+}
+
+void* arena_alloc_block(Arena* arena, size_t size) {
+    /* Grow geometrically so a large input needs few blocks */
+    size_t block_size = arena->total > ARENA_MIN_BLOCK ? arena->total : ARENA_MIN_BLOCK;
+    if (block_size < size) block_size = size;
+    if (block_size > (size_t)-1 - ARENA_HEADER_SIZE) return NULL;
+    
+    ArenaBlock* block = block_create(block_size);
+    if (!block) return NULL;
+    
+    block->next = arena->head;
+    block->used = size;
+    arena->head = block;
+    arena->total += block_size;
+    return (char*)block + ARENA_HEADER_SIZE;
+}
+
+void arena_reset(Arena* arena) {
+    ArenaBlock* block = arena->head;
+    if (!block) return;
+    
+    if (!block->next) {
+        block->used = 0;
+        return;
+    }
+    
+    /* Coalesce, so the next round of the same size fits in one block */
+    size_t total = arena->total;
+    arena_destroy(arena);
+    arena->head = block_create(total);
+    if (arena->head) arena->total = total;
+}
+
+void arena_destroy(Arena* arena) {
+    ArenaBlock* block = arena->head;
+    while (block) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+    arena->total = 0;
+}
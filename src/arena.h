@@ -0,0 +1,61 @@
+/**
+ * @file arena.h
+ * @brief Bump allocator for per-call scratch and result memory
+ *
+ * Internal header. Allocations are carved from large blocks and are
+ * only released all at once by arena_reset(). A reset that finds more
+ * than one block replaces them with a single block as large as all of
+ * them, so an arena reused for similar inputs settles on one block and
+ * then allocates without touching the heap.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* Allocation alignment, enough for any scalar type used here */
+#define ARENA_ALIGN 8
+
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;   /* Previously filled block */
+    size_t size;               /* Usable bytes after the header */
+    size_t used;
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock* head;          /* Block being filled, NULL when empty */
+    size_t total;              /* Usable bytes in all blocks */
+} Arena;
+
+/* Size of the block header, rounded so block data stays aligned */
+#define ARENA_HEADER_SIZE ((sizeof(ArenaBlock) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+void arena_init(Arena* arena);
+
+/* Slow path of arena_alloc(): start a new block */
+void* arena_alloc_block(Arena* arena, size_t size);
+
+/**
+ * @brief Allocate size bytes, aligned to ARENA_ALIGN
+ *
+ * @return Pointer valid until the next reset, or NULL on failure
+ */
+static inline void* arena_alloc(Arena* arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    ArenaBlock* block = arena->head;
+    if (block && block->size - block->used >= size) {
+        void* ptr = (char*)block + ARENA_HEADER_SIZE + block->used;
+        block->used += size;
+        return ptr;
+    }
+    return arena_alloc_block(arena, size);
+}
+
+/* Release every allocation; O(1) once the arena has a single block */
+void arena_reset(Arena* arena);
+
+/* Free all blocks */
+void arena_destroy(Arena* arena);
+
+#endif /* ARENA_H */
@@ -0,0 +1,318 @@
+/**
+ * @file batch.c
+ * @brief Multi-threaded segmentation of many texts or one large text
+ *
+ * Workers share the read-only dictionary and claim small chunks of the
+ * batch from a shared counter, so a few long texts do not hold up the
+ * rest. Each worker appends spans to its own buffer; the buffers are
+ * stitched into one contiguous result after all workers finish.
+ *
+ * A single large text is cut into pieces at points where the sequential
+ * segmentation provably has a token boundary and makes no decision that
+ * looks across it, then run through the same batch machinery.
+ */
+
+#include "../include/newmm.h"
+#include "arena.h"
+#include "datrie.h"
+#include "segment.h"
+#include "stats.h"
+#include "thread.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Upper bound on chunk size; small enough to balance skewed batches */
+#define BATCH_MAX_CHUNK 64
+
+/* Smallest piece a single text is cut into, and pieces per worker */
+#define PARALLEL_MIN_PIECE (16 * 1024)
+#define PARALLEL_PIECES_PER_THREAD 4
+
+/* Where the spans of one text ended up */
+typedef struct {
+    int32_t worker;
+    int32_t count;
+    size_t local;   /* Index of the first span in the worker's buffer */
+} BatchItem;
+
+typedef struct BatchShared BatchShared;
+
+typedef struct {
+    BatchShared* shared;
+    int32_t id;
+    SpanBuffer spans;
+    Arena scratch;   /* Reset after each text */
+    newmm_stats_t stats;   /* Counts of a worker thread, for the caller */
+    bool failed;
+} BatchWorker;
+
+struct BatchShared {
+    const char* const* texts;
+    const size_t* lens;
+    size_t num_texts;
+    size_t chunk;
+    const DATrie* trie;
+    BatchItem* items;
+    thread_counter_t next_chunk;
+};
+
+static void batch_worker_segment(BatchWorker* worker) {
+    BatchShared* shared = worker->shared;
+    
+    for (;;) {
+        size_t first = (size_t)thread_fetch_add(&shared->next_chunk, 1) * shared->chunk;
+        if (first >= shared->num_texts) break;
+        
+        size_t last = first + shared->chunk;
+        if (last > shared->num_texts) last = shared->num_texts;
+        
+        for (size_t i = first; i < last; i++) {
+            const char* text = shared->texts[i];
+            size_t len = text ? (shared->lens ? shared->lens[i] : strlen(text)) : 0;
+            
+            if (len > INT32_MAX) {
+                worker->failed = true;
+                return;
+            }
+            
+            /* Spans are appended after the previous texts' spans, with
+             * offsets relative to this text */
+            int before = worker->spans.count;
+            if (len > 0 && segment_text(text, (int)len, shared->trie, &worker->scratch,
+                                        &worker->spans) < 0) {
+                worker->failed = true;
+                return;
+            }
+            arena_reset(&worker->scratch);
+            
+            shared->items[i].worker = worker->id;
+            shared->items[i].count = worker->spans.count - before;
+            shared->items[i].local = (size_t)before;
+        }
+    }
+}
+
+/* Entry point of the extra worker threads */
+static void* batch_worker_run(void* arg) {
+    BatchWorker* worker = (BatchWorker*)arg;
+    batch_worker_segment(worker);
+    newmm_stats_get(&worker->stats);
+    return NULL;
+}
+
+int newmm_segment_batch(const char* const* texts, const size_t* lens, size_t num_texts,
+                        newmm_dict_t dict, int num_threads, newmm_batch_result_t* result) {
+    if (!result) return -1;
+    memset(result, 0, sizeof(*result));
+    if (!dict || (num_texts > 0 && !texts)) return -1;
+    
+    result->offsets = (size_t*)calloc(num_texts + 1, sizeof(size_t));
+    if (!result->offsets) return -1;
+    result->num_texts = num_texts;
+    if (num_texts == 0) return 0;
+    
+    if (num_threads <= 0) num_threads = thread_cpu_count();
+    if ((size_t)num_threads > num_texts) num_threads = (int)num_texts;
+    
+    BatchShared shared;
+    shared.texts = texts;
+    shared.lens = lens;
+    shared.num_texts = num_texts;
+    shared.trie = (const DATrie*)dict;
+    shared.next_chunk = 0;
+    
+    /* Aim for many chunks per worker so idle workers keep finding work */
+    shared.chunk = num_texts / ((size_t)num_threads * 16);
+    if (shared.chunk < 1) shared.chunk = 1;
+    if (shared.chunk > BATCH_MAX_CHUNK) shared.chunk = BATCH_MAX_CHUNK;
+    
+    shared.items = (BatchItem*)malloc(num_texts * sizeof(BatchItem));
+    BatchWorker* workers = (BatchWorker*)calloc(num_threads, sizeof(BatchWorker));
+    thread_t* threads = (thread_t*)malloc(num_threads * sizeof(thread_t));
+    bool ok = shared.items && workers && threads;
+    
+    if (ok) {
+        for (int t = 0; t < num_threads; t++) {
+            workers[t].shared = &shared;
+            workers[t].id = t;
+            workers[t].spans.growable = true;
+            arena_init(&workers[t].scratch);
+        }
+        
+        /* The calling thread is worker 0 */
+        int started = 1;
+        for (; started < num_threads; started++) {
+            if (thread_start(&threads[started], batch_worker_run, &workers[started]) != 0) break;
+        }
+        batch_worker_segment(&workers[0]);
+        for (int t = 1; t < started; t++) {
+            thread_join(threads[t]);
+            stats_add(&workers[t].stats);
+        }
+        
+        for (int t = 0; t < num_threads; t++) {
+            if (workers[t].failed) ok = false;
+        }
+    }
+    
+    /* Stitch the per-worker buffers together in input order */
+    if (ok) {
+        size_t total = 0;
+        for (size_t i = 0; i < num_texts; i++) {
+            total += (size_t)shared.items[i].count;
+            result->offsets[i + 1] = total;
+        }
+        
+        result->starts = (int32_t*)malloc((total > 0 ? total : 1) * sizeof(int32_t));
+        result->ends = (int32_t*)malloc((total > 0 ? total : 1) * sizeof(int32_t));
+        stats_add_allocated(2 * (total > 0 ? total : 1) * sizeof(int32_t));
+        ok = result->starts && result->ends;
+        
+        for (size_t i = 0; ok && i < num_texts; i++) {
+            const BatchItem* item = &shared.items[i];
+            const SpanBuffer* spans = &workers[item->worker].spans;
+            memcpy(result->starts + result->offsets[i], spans->starts + item->local,
+                   (size_t)item->count * sizeof(int32_t));
+            memcpy(result->ends + result->offsets[i], spans->ends + item->local,
+                   (size_t)item->count * sizeof(int32_t));
+        }
+    }
+    
+    if (workers) {
+        for (int t = 0; t < num_threads; t++) {
+            free(workers[t].spans.starts);
+            free(workers[t].spans.ends);
+            arena_destroy(&workers[t].scratch);
+        }
+    }
+    free(workers);
+    free(threads);
+    free(shared.items);
+    
+    if (!ok) {
+        newmm_free_batch_result(result);
+        return -1;
+    }
+    return 0;
+}
+
+void newmm_free_batch_result(newmm_batch_result_t* result) {
+    if (!result) return;
+    
+    free(result->offsets);
+    free(result->starts);
+    free(result->ends);
+    memset(result, 0, sizeof(*result));
+}
+
+/* Check whether a non-Thai run containing c1 always ends before c2,
+ * mirroring the run grouping in segment_text() */
+static bool run_ends_between(unsigned char c1, unsigned char c2) {
+    bool alpha1 = (c1 >= 'a' && c1 <= 'z') || (c1 >= 'A' && c1 <= 'Z');
+    bool alpha2 = (c2 >= 'a' && c2 <= 'z') || (c2 >= 'A' && c2 <= 'Z');
+    bool digit1 = c1 >= '0' && c1 <= '9';
+    bool digit2 = c2 >= '0' && c2 <= '9';
+    
+    if (c1 == ' ' || c1 == '\t') return c2 != ' ' && c2 != '\t';
+    if (alpha1) return !alpha2;
+    if (digit1) return !digit2 && c2 != '.' && c2 != ',';
+    return c2 != c1;
+}
+
+/* A cut at p (0 < p < len) is safe when the character before it is an
+ * ASCII character c1 that
+ *  - is its own TCC, so TCC positions on both sides are unchanged,
+ *  - is not '.' or ',', whose digit grouping looks one character ahead,
+ *  - ends any non-Thai run containing it, so a token ends at p, and
+ *  - is not covered by any dictionary match, so no lookup from a start
+ *    before p sees past p.
+ * Every decision before p then only reads bytes before p, and every
+ * decision from p on only reads forward, so segmenting the two sides
+ * separately gives the sequential result. */
+static bool is_safe_cut(const char* text, size_t len, const DATrie* trie, size_t p) {
+    unsigned char c1 = (unsigned char)text[p - 1];
+    unsigned char c2 = (unsigned char)text[p];
+    
+    if (c1 >= 0x80 || c1 == '.' || c1 == ',') return false;
+    if (!run_ends_between(c1, c2)) return false;
+    if (!datrie_uses_ascii(trie, c1)) return true;
+    
+    /* Some words contain c1: no match from a start within one word
+     * length before it may reach it */
+    size_t first = p > (size_t)trie->max_word_bytes ? p - trie->max_word_bytes : 0;
+    for (size_t q = first; q < p; q++) {
+        int ends[TRIE_MAX_PREFIXES];
+        int n = datrie_prefix_ends(trie, text + q, len - q, ends, TRIE_MAX_PREFIXES);
+        if (n > 0 && q + ends[n - 1] >= p) return false;
+    }
+    return true;
+}
+
+int newmm_segment_spans_parallel(const char* text, size_t len, newmm_dict_t dict, int num_threads,
+                                 int32_t* starts, int32_t* ends, size_t capacity) {
+    if (!text || !dict || (capacity > 0 && (!starts || !ends))) return -1;
+    if (len > INT32_MAX) return -1;
+    
+    const DATrie* trie = (const DATrie*)dict;
+    if (num_threads <= 0) num_threads = thread_cpu_count();
+    
+    size_t num_pieces = len / PARALLEL_MIN_PIECE;
+    if (num_pieces > (size_t)num_threads * PARALLEL_PIECES_PER_THREAD) {
+        num_pieces = (size_t)num_threads * PARALLEL_PIECES_PER_THREAD;
+    }
+    if (num_threads == 1 || num_pieces < 2) {
+        return newmm_segment_spans(text, len, dict, starts, ends, capacity);
+    }
+    
+    /* Cut at the first safe point after each target; a piece simply grows
+     * when no safe point is found before the next target */
+    const char** pieces = (const char**)malloc(num_pieces * sizeof(char*));
+    size_t* piece_lens = (size_t*)malloc(num_pieces * sizeof(size_t));
+    if (!pieces || !piece_lens) {
+        free(pieces);
+        free(piece_lens);
+        return -1;
+    }
+    
+    size_t piece_size = len / num_pieces;
+    size_t count = 0;
+    size_t cut = 0;
+    while (cut < len) {
+        size_t next = len;
+        if (count + 1 < num_pieces) {
+            for (size_t p = cut + piece_size; p < len; p++) {
+                if (is_safe_cut(text, len, trie, p)) {
+                    next = p;
+                    break;
+                }
+            }
+        }
+        pieces[count] = text + cut;
+        piece_lens[count] = next - cut;
+        count++;
+        cut = next;
+    }
+    
+    newmm_batch_result_t batch;
+    int status = newmm_segment_batch(pieces, piece_lens, count, dict, num_threads, &batch);
+    
+    /* Stitch pieces back together with offsets relative to text */
+    size_t total = 0;
+    if (status == 0) {
+        total = batch.offsets[count];
+        for (size_t i = 0; i < count; i++) {
+            int32_t shift = (int32_t)(pieces[i] - text);
+            for (size_t j = batch.offsets[i]; j < batch.offsets[i + 1] && j < capacity; j++) {
+                starts[j] = batch.starts[j] + shift;
+                ends[j] = batch.ends[j] + shift;
+            }
+        }
+        newmm_free_batch_result(&batch);
+    }
+    
+    free(pieces);
+    free(piece_lens);
+    return status == 0 ? (int)total : -1;
+}
@@ -0,0 +1,301 @@
+/**
+ * @file cache.c
+ * @brief Reuse of the spans of repeated inputs
+ *
+ * A span cache maps (dictionary, engine, text) to the spans segmentation
+ * produced for them. Entries are split over shards, each a small
+ * chained hash table under its own lock, and replaced by the CLOCK
+ * algorithm: a hit marks its entry, and the hand evicts the first
+ * unmarked entry it meets, clearing marks as it passes.
+ *
+ * Dictionaries are identified by the id every DATrie gets when it is
+ * created, never by address, so results for a released or swapped
+ * dictionary cannot be returned for a new one; they simply stop being
+ * hit and are evicted in time.
+ */
+
+#include "../include/newmm.h"
+#include "datrie.h"
+#include "thread.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define CACHE_SHARD_BITS 4
+#define CACHE_SHARDS (1 << CACHE_SHARD_BITS)
+#define CACHE_DEFAULT_MAX_TEXT 256
+
+/* Spans of one input; block holds starts, ends, then the text bytes */
+typedef struct {
+    uint64_t hash;
+    uint64_t dict_id;
+    int32_t* block;
+    int32_t len;
+    int32_t count;
+    int32_t next;      /* Next entry in the same bucket, or -1 */
+    uint8_t engine;
+    bool referenced;
+} CacheEntry;
+
+typedef struct {
+    thread_mutex_t lock;
+    CacheEntry* entries;
+    int32_t* buckets;   /* First entry of each chain, or -1 */
+    uint64_t bucket_mask;
+    int capacity;
+    int used;
+    int hand;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+} CacheShard;
+
+struct newmm_span_cache {
+    size_t max_text_len;
+    CacheShard shards[CACHE_SHARDS];
+};
+
+/* Hash 8 bytes at a time; seeded so that each dictionary and engine
+ * spreads its texts differently */
+static uint64_t cache_hash(const char* text, size_t len, uint64_t seed) {
+    const uint64_t k = 0x9E3779B97F4A7C15ull;
+    uint64_t h = (seed + len) * k;
+    
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t chunk;
+        memcpy(&chunk, text + i, 8);
+        h = (h ^ chunk) * k;
+        h ^= h >> 29;
+    }
+    uint64_t tail = 0;
+    for (int shift = 0; i < len; i++, shift += 8) {
+        tail |= (uint64_t)(unsigned char)text[i] << shift;
+    }
+    h = (h ^ tail) * k;
+    h ^= h >> 32;
+    return h;
+}
+
+/* Buckets are twice the entries, rounded up to a power of two */
+static int shard_buckets(int capacity) {
+    int buckets = 1;
+    while (buckets < 2 * capacity) buckets <<= 1;
+    return buckets;
+}
+
+/* Drop every entry and resize the shard; false if out of memory, which
+ * leaves it empty with no capacity */
+static bool shard_reset(CacheShard* shard, int capacity) {
+    for (int i = 0; i < shard->used; i++) {
+        free(shard->entries[i].block);
+    }
+    free(shard->entries);
+    free(shard->buckets);
+    shard->entries = NULL;
+    shard->buckets = NULL;
+    shard->bucket_mask = 0;
+    shard->capacity = 0;
+    shard->used = 0;
+    shard->hand = 0;
+    if (capacity == 0) return true;
+    
+    int buckets = shard_buckets(capacity);
+    shard->entries = (CacheEntry*)malloc((size_t)capacity * sizeof(CacheEntry));
+    shard->buckets = (int32_t*)malloc((size_t)buckets * sizeof(int32_t));
+    if (!shard->entries || !shard->buckets) {
+        free(shard->entries);
+        free(shard->buckets);
+        shard->entries = NULL;
+        shard->buckets = NULL;
+        return false;
+    }
+    for (int i = 0; i < buckets; i++) {
+        shard->buckets[i] = -1;
+    }
+    shard->bucket_mask = (uint64_t)buckets - 1;
+    shard->capacity = capacity;
+    return true;
+}
+
+static inline int32_t* shard_bucket(CacheShard* shard, uint64_t hash) {
+    return &shard->buckets[hash & shard->bucket_mask];
+}
+
+static CacheEntry* shard_find(CacheShard* shard, uint64_t hash, uint64_t dict_id, int engine,
+                              const char* text, size_t len) {
+    for (int32_t i = *shard_bucket(shard, hash); i >= 0; i = shard->entries[i].next) {
+        CacheEntry* entry = &shard->entries[i];
+        if (entry->hash == hash && entry->dict_id == dict_id && entry->engine == engine &&
+            (size_t)entry->len == len &&
+            memcmp(entry->block + 2 * entry->count, text, len) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/* Take an entry slot for a new result, evicting one if the shard is full */
+static CacheEntry* shard_claim(CacheShard* shard) {
+    if (shard->used < shard->capacity) return &shard->entries[shard->used++];
+    
+    for (;;) {
+        CacheEntry* entry = &shard->entries[shard->hand];
+        shard->hand = (shard->hand + 1) % shard->capacity;
+        if (entry->referenced) {
+            entry->referenced = false;
+            continue;
+        }
+        
+        int32_t index = (int32_t)(entry - shard->entries);
+        int32_t* link = shard_bucket(shard, entry->hash);
+        while (*link != index) link = &shard->entries[*link].next;
+        *link = entry->next;
+        free(entry->block);
+        shard->evictions++;
+        return entry;
+    }
+}
+
+static void shard_insert(CacheShard* shard, uint64_t hash, uint64_t dict_id, int engine,
+                         const char* text, size_t len, const int32_t* starts,
+                         const int32_t* ends, int count) {
+    if (shard->capacity == 0 || shard_find(shard, hash, dict_id, engine, text, len)) return;
+    
+    int32_t* block = (int32_t*)malloc(2 * (size_t)count * sizeof(int32_t) + len);
+    if (!block) return;
+    memcpy(block, starts, (size_t)count * sizeof(int32_t));
+    memcpy(block + count, ends, (size_t)count * sizeof(int32_t));
+    memcpy(block + 2 * count, text, len);
+    
+    CacheEntry* entry = shard_claim(shard);
+    int32_t* bucket = shard_bucket(shard, hash);
+    entry->hash = hash;
+    entry->dict_id = dict_id;
+    entry->block = block;
+    entry->len = (int32_t)len;
+    entry->count = count;
+    entry->engine = (uint8_t)engine;
+    entry->referenced = false;
+    entry->next = *bucket;
+    *bucket = (int32_t)(entry - shard->entries);
+}
+
+newmm_span_cache_t* newmm_span_cache_create(size_t max_entries, size_t max_text_len) {
+    newmm_span_cache_t* cache = (newmm_span_cache_t*)calloc(1, sizeof(newmm_span_cache_t));
+    if (!cache) return NULL;
+    
+    cache->max_text_len = max_text_len > 0 ? max_text_len : CACHE_DEFAULT_MAX_TEXT;
+    for (int i = 0; i < CACHE_SHARDS; i++) {
+        thread_mutex_init(&cache->shards[i].lock);
+    }
+    if (newmm_span_cache_resize(cache, max_entries) != 0) {
+        newmm_span_cache_free(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+int newmm_span_cache_resize(newmm_span_cache_t* cache, size_t max_entries) {
+    if (!cache || max_entries > INT32_MAX) return -1;
+    
+    int per_shard = (int)((max_entries + CACHE_SHARDS - 1) / CACHE_SHARDS);
+    int status = 0;
+    for (int i = 0; i < CACHE_SHARDS; i++) {
+        CacheShard* shard = &cache->shards[i];
+        thread_mutex_lock(&shard->lock);
+        if (!shard_reset(shard, per_shard)) status = -1;
+        thread_mutex_unlock(&shard->lock);
+    }
+    return status;
+}
+
+int newmm_span_cache_segment(newmm_span_cache_t* cache, const char* text, size_t len,
+                             newmm_dict_t dict, newmm_engine_t engine,
+                             int32_t* starts, int32_t* ends, size_t capacity) {
+    if (!cache || !text || !dict || (capacity > 0 && (!starts || !ends))) return -1;
+    if (len > cache->max_text_len) {
+        return newmm_segment_spans_engine(text, len, dict, engine, starts, ends, capacity);
+    }
+    
+    uint64_t dict_id = ((const DATrie*)dict)->id;
+    uint64_t hash = cache_hash(text, len, dict_id * CACHE_SHARDS + (uint64_t)engine);
+    CacheShard* shard = &cache->shards[hash >> (64 - CACHE_SHARD_BITS)];
+    
+    thread_mutex_lock(&shard->lock);
+    if (shard->capacity == 0) {
+        thread_mutex_unlock(&shard->lock);
+        return newmm_segment_spans_engine(text, len, dict, engine, starts, ends, capacity);
+    }
+    CacheEntry* entry = shard_find(shard, hash, dict_id, (int)engine, text, len);
+    if (entry) {
+        int count = entry->count;
+        size_t copied = (size_t)count < capacity ? (size_t)count : capacity;
+        memcpy(starts, entry->block, copied * sizeof(int32_t));
+        memcpy(ends, entry->block + count, copied * sizeof(int32_t));
+        entry->referenced = true;
+        shard->hits++;
+        thread_mutex_unlock(&shard->lock);
+        return count;
+    }
+    shard->misses++;
+    thread_mutex_unlock(&shard->lock);
+    
+    /* Segment outside the lock; a result that did not fit is not kept */
+    int count = newmm_segment_spans_engine(text, len, dict, engine, starts, ends, capacity);
+    if (count >= 0 && (size_t)count <= capacity) {
+        thread_mutex_lock(&shard->lock);
+        shard_insert(shard, hash, dict_id, (int)engine, text, len, starts, ends, count);
+        thread_mutex_unlock(&shard->lock);
+    }
+    return count;
+}
+
+void newmm_span_cache_get_stats(newmm_span_cache_t* cache, newmm_span_cache_stats_t* stats) {
+    if (!stats) return;
+    
+    memset(stats, 0, sizeof(*stats));
+    if (!cache) return;
+    
+    for (int i = 0; i < CACHE_SHARDS; i++) {
+        CacheShard* shard = &cache->shards[i];
+        thread_mutex_lock(&shard->lock);
+        stats->hits += shard->hits;
+        stats->misses += shard->misses;
+        stats->evictions += shard->evictions;
+        stats->entries += (size_t)shard->used;
+        stats->capacity += (size_t)shard->capacity;
+        thread_mutex_unlock(&shard->lock);
+    }
+}
+
+void newmm_span_cache_clear(newmm_span_cache_t* cache) {
+    if (!cache) return;
+    
+    for (int i = 0; i < CACHE_SHARDS; i++) {
+        CacheShard* shard = &cache->shards[i];
+        thread_mutex_lock(&shard->lock);
+        for (int j = 0; j < shard->used; j++) {
+            free(shard->entries[j].block);
+        }
+        for (uint64_t j = 0; shard->buckets && j <= shard->bucket_mask; j++) {
+            shard->buckets[j] = -1;
+        }
+        shard->used = 0;
+        shard->hand = 0;
+        shard->hits = 0;
+        shard->misses = 0;
+        shard->evictions = 0;
+        thread_mutex_unlock(&shard->lock);
+    }
+}
+
+void newmm_span_cache_free(newmm_span_cache_t* cache) {
+    if (!cache) return;
+    
+    for (int i = 0; i < CACHE_SHARDS; i++) {
+        shard_reset(&cache->shards[i], 0);
+        thread_mutex_destroy(&cache->shards[i].lock);
+    }
+    free(cache);
+}
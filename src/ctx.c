@@ -0,0 +1,101 @@
+/**
+ * @file ctx.c
+ * @brief Segmentation with caller-owned, reusable memory
+ *
+ * A context owns an arena that holds the TCC bitmap, the spans and the
+ * token strings of every call made with it until it is reset. Once the
+ * arena has grown to fit the largest document, calls do no heap
+ * allocation at all.
+ */
+
+#include "../include/newmm.h"
+#include "arena.h"
+#include "datrie.h"
+#include "segment.h"
+#include "stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+struct newmm_ctx {
+    Arena arena;
+};
+
+newmm_ctx_t* newmm_ctx_create(void) {
+    newmm_ctx_t* ctx = (newmm_ctx_t*)malloc(sizeof(newmm_ctx_t));
+    if (!ctx) return NULL;
+    
+    arena_init(&ctx->arena);
+    return ctx;
+}
+
+void newmm_ctx_reset(newmm_ctx_t* ctx) {
+    if (ctx) arena_reset(&ctx->arena);
+}
+
+void newmm_ctx_free(newmm_ctx_t* ctx) {
+    if (!ctx) return;
+    
+    arena_destroy(&ctx->arena);
+    free(ctx);
+}
+
+int newmm_ctx_segment_spans(newmm_ctx_t* ctx, const char* text, size_t len, newmm_dict_t dict,
+                            const int32_t** starts, const int32_t** ends) {
+    if (!ctx || !text || !dict || !starts || !ends) return -1;
+    if (len > INT32_MAX) return -1;
+    
+    *starts = NULL;
+    *ends = NULL;
+    if (len == 0) return 0;
+    
+    SpanBuffer out = {NULL, NULL, NULL, 0, 0, true, &ctx->arena};
+    int initial = (int)(len / 8) + 16;
+    out.starts = (int32_t*)arena_alloc(&ctx->arena, initial * sizeof(int32_t));
+    out.ends = (int32_t*)arena_alloc(&ctx->arena, initial * sizeof(int32_t));
+    if (!out.starts || !out.ends) return -1;
+    out.capacity = initial;
+    stats_add_allocated(2 * (size_t)initial * sizeof(int32_t));
+    
+    int count = segment_text(text, (int)len, (const DATrie*)dict, &ctx->arena, &out);
+    if (count < 0) return -1;
+    
+    *starts = out.starts;
+    *ends = out.ends;
+    return count;
+}
+
+char** newmm_ctx_segment(newmm_ctx_t* ctx, const char* text, size_t len, newmm_dict_t dict,
+                         int* token_count) {
+    if (!token_count) return NULL;
+    *token_count = 0;
+    
+    const int32_t* starts;
+    const int32_t* ends;
+    int count = newmm_ctx_segment_spans(ctx, text, len, dict, &starts, &ends);
+    if (count <= 0) return NULL;
+    
+    /* Tokens cover the text, so all strings fit in len + count bytes */
+    newmm_stats_t output;
+    memset(&output, 0, sizeof(output));
+    bool timed = stats_enabled();
+    uint64_t started = timed ? stats_now_ns() : 0;
+    char** tokens = (char**)arena_alloc(&ctx->arena, count * sizeof(char*));
+    char* pool = (char*)arena_alloc(&ctx->arena, len + (size_t)count);
+    if (!tokens || !pool) return NULL;
+    
+    for (int i = 0; i < count; i++) {
+        size_t token_len = (size_t)(ends[i] - starts[i]);
+        memcpy(pool, text + starts[i], token_len);
+        pool[token_len] = '\0';
+        tokens[i] = pool;
+        pool += token_len + 1;
+    }
+    
+    output.bytes_allocated = (uint64_t)count * (sizeof(char*) + 1) + len;
+    if (timed) output.output_ns = stats_now_ns() - started;
+    stats_add(&output);
+    
+    *token_count = count;
+    return tokens;
+}
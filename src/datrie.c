@@ -0,0 +1,1005 @@
+/**
+ * @file datrie.c
+ * @brief Compact double-array trie implementation
+ *
+ * State s has children at cells base[s] + label, and a cell t belongs to s
+ * only if check[t] == s. Codepoints are mapped to dense labels so the
+ * arrays stay small even though Thai sits at U+0E00.
+ */
+
+#include "datrie.h"
+#include "thread.h"
+#include "utf8.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define DA_INITIAL_UNITS 1024
+
+/* Binary dictionary file format */
+#define DA_FILE_MAGIC "CTNLPDA"
+#define DA_FILE_VERSION 3
+#define DA_FILE_BYTE_ORDER 0x01020304u
+#define DA_FILE_HAS_VALUES 0x1u
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;      /* Files are only valid on the writer's endianness */
+    uint32_t key_mode;
+    int32_t num_units;
+    int32_t num_words;
+    int32_t num_labels;
+    int32_t num_ext;
+    int32_t max_word_bytes;
+    uint32_t flags;           /* DA_FILE_HAS_VALUES */
+    uint64_t value_total;
+    uint64_t units_offset;
+    uint64_t ext_cps_offset;
+    uint64_t ext_labels_offset;
+    uint64_t values_offset;
+    uint64_t file_size;
+    int32_t ascii_labels[128];
+    int32_t thai_labels[DA_THAI_SIZE];
+} DAFileHeader;
+
+/* Source of DATrie.id */
+static thread_counter_t da_last_id = 0;
+
+/* Allocate an empty trie with a fresh id */
+static DATrie* da_new(void) {
+    DATrie* da = (DATrie*)calloc(1, sizeof(DATrie));
+    if (da) da->id = (uint64_t)(unsigned long)thread_fetch_add(&da_last_id, 1) + 1;
+    return da;
+}
+
+/* Map a codepoint to its dense label, 0 if no word uses it */
+static inline int32_t da_label(const DATrie* da, int codepoint) {
+    if (codepoint >= 0 && codepoint < 0x80) {
+        return da->ascii_labels[codepoint];
+    }
+    if (codepoint >= DA_THAI_FIRST && codepoint < DA_THAI_FIRST + DA_THAI_SIZE) {
+        return da->thai_labels[codepoint - DA_THAI_FIRST];
+    }
+
+    int lo = 0, hi = da->num_ext - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (da->ext_cps[mid] == codepoint) return da->ext_labels[mid];
+        if (da->ext_cps[mid] < codepoint) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return 0;
+}
+
+/* Label of a source trie edge */
+static inline int32_t da_edge_label(const DATrie* da, int key) {
+    return da->key_mode == TRIE_KEY_BYTE ? key + 1 : da_label(da, key);
+}
+
+/* Follow the transition from state s on label, -1 if there is none */
+static inline int32_t da_next(const DATrie* da, int32_t s, int32_t label) {
+    int32_t t = (int32_t)(da->units[s].base & DA_BASE_MASK) + label;
+    return da->units[t].check == s ? t : -1;
+}
+
+static int compare_int(const void* a, const void* b) {
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+/* Count nodes and collect every child codepoint of the subtree */
+static void collect_chars(const TrieNode* node, int* chars, int* count) {
+    for (int i = 0; i < node->num_children; i++) {
+        chars[(*count)++] = trie_node_keys(node)[i];
+        collect_chars(node->children[i], chars, count);
+    }
+}
+
+static int count_edges(const TrieNode* node) {
+    int count = node->num_children;
+    for (int i = 0; i < node->num_children; i++) {
+        count += count_edges(node->children[i]);
+    }
+    return count;
+}
+
+/* Assign dense labels in codepoint order */
+static bool build_labels(DATrie* da, const Trie* trie, int num_edges) {
+    int* chars = (int*)malloc((num_edges > 0 ? num_edges : 1) * sizeof(int));
+    if (!chars) return false;
+
+    int count = 0;
+    collect_chars(trie->root, chars, &count);
+    qsort(chars, count, sizeof(int), compare_int);
+
+    int unique = 0;
+    for (int i = 0; i < count; i++) {
+        if (unique == 0 || chars[unique - 1] != chars[i]) {
+            chars[unique++] = chars[i];
+        }
+    }
+
+    int num_ext = 0;
+    for (int i = 0; i < unique; i++) {
+        int cp = chars[i];
+        if (!(cp >= 0 && cp < 0x80) &&
+            !(cp >= DA_THAI_FIRST && cp < DA_THAI_FIRST + DA_THAI_SIZE)) {
+            num_ext++;
+        }
+    }
+
+    da->ext_cps = (int32_t*)malloc((num_ext > 0 ? num_ext : 1) * sizeof(int32_t));
+    da->ext_labels = (int32_t*)malloc((num_ext > 0 ? num_ext : 1) * sizeof(int32_t));
+    if (!da->ext_cps || !da->ext_labels) {
+        free(chars);
+        return false;
+    }
+
+    for (int i = 0; i < unique; i++) {
+        int cp = chars[i];
+        int32_t label = i + 1;
+        if (cp >= 0 && cp < 0x80) {
+            da->ascii_labels[cp] = label;
+        } else if (cp >= DA_THAI_FIRST && cp < DA_THAI_FIRST + DA_THAI_SIZE) {
+            da->thai_labels[cp - DA_THAI_FIRST] = label;
+        } else {
+            da->ext_cps[da->num_ext] = cp;
+            da->ext_labels[da->num_ext] = label;
+            da->num_ext++;
+        }
+    }
+    da->num_labels = unique;
+
+    free(chars);
+    return true;
+}
+
+/* Record the longest word in bytes and, in byte mode, which ASCII bytes
+ * occur in words (codepoint mode has this in its labels already) */
+static void scan_words(DATrie* da, const TrieNode* node, int32_t depth) {
+    if (node->is_end && depth > da->max_word_bytes) da->max_word_bytes = depth;
+
+    for (int i = 0; i < node->num_children; i++) {
+        int key = trie_node_keys(node)[i];
+        int bytes = 1;
+        if (da->key_mode == TRIE_KEY_BYTE) {
+            if (key < 0x80) da->ascii_labels[key] = key + 1;
+        } else {
+            bytes = utf8_encoded_len(key);
+        }
+        scan_words(da, node->children[i], depth + bytes);
+    }
+}
+
+/* Builder state while placing child blocks. Free cells are kept on a
+ * circular doubly-linked list (cell 0, the root, is the list head) so the
+ * base search only visits cells that can actually take a child. */
+typedef struct {
+    DAUnit* units;
+    int32_t* next_free;
+    int32_t* prev_free;
+    int32_t capacity;
+    int32_t max_base;
+} DABuilder;
+
+static bool builder_reserve(DABuilder* b, int32_t size) {
+    if (size <= b->capacity) return true;
+
+    int32_t new_capacity = b->capacity;
+    while (new_capacity < size) new_capacity *= 2;
+
+    DAUnit* units = (DAUnit*)realloc(b->units, new_capacity * sizeof(DAUnit));
+    if (!units) return false;
+    b->units = units;
+    int32_t* next_free = (int32_t*)realloc(b->next_free, new_capacity * sizeof(int32_t));
+    if (!next_free) return false;
+    b->next_free = next_free;
+    int32_t* prev_free = (int32_t*)realloc(b->prev_free, new_capacity * sizeof(int32_t));
+    if (!prev_free) return false;
+    b->prev_free = prev_free;
+
+    int32_t last = b->prev_free[0];
+    for (int32_t i = b->capacity; i < new_capacity; i++) {
+        units[i].base = 0;
+        units[i].check = -1;
+        next_free[last] = i;
+        prev_free[i] = last;
+        last = i;
+    }
+    next_free[last] = 0;
+    prev_free[0] = last;
+    b->capacity = new_capacity;
+    return true;
+}
+
+static void builder_take(DABuilder* b, int32_t t, int32_t parent) {
+    b->units[t].check = parent;
+    b->next_free[b->prev_free[t]] = b->next_free[t];
+    b->prev_free[b->next_free[t]] = b->prev_free[t];
+}
+
+/* Find a base where every label of the sorted child set lands on a free cell */
+static int32_t builder_find_base(DABuilder* b, const int32_t* labels, int k, int32_t max_label) {
+    int32_t pos = b->next_free[0];
+
+    for (;;) {
+        if (pos == 0) {
+            /* Ran off the end of the free list: grow and continue there */
+            int32_t old_capacity = b->capacity;
+            if (!builder_reserve(b, old_capacity * 2)) return -1;
+            pos = old_capacity;
+        }
+
+        int32_t base = pos - labels[0];
+        if (base >= 1) {
+            if (base + max_label >= b->capacity &&
+                !builder_reserve(b, base + max_label + 1)) {
+                return -1;
+            }
+
+            bool fits = true;
+            for (int i = 1; i < k; i++) {
+                if (b->units[base + labels[i]].check != -1) {
+                    fits = false;
+                    break;
+                }
+            }
+            if (fits) return base;
+        }
+
+        pos = b->next_free[pos];
+    }
+}
+
+typedef struct {
+    const TrieNode* node;
+    int32_t state;
+} DAQueueItem;
+
+typedef struct {
+    int32_t label;
+    const TrieNode* child;
+} DAChild;
+
+static int compare_child(const void* a, const void* b) {
+    int32_t x = ((const DAChild*)a)->label;
+    int32_t y = ((const DAChild*)b)->label;
+    return (x > y) - (x < y);
+}
+
+DATrie* datrie_build(const Trie* trie) {
+    if (!trie || !trie->root) return NULL;
+
+    DATrie* da = da_new();
+    if (!da) return NULL;
+
+    da->key_mode = trie->key_mode;
+    int num_edges = count_edges(trie->root);
+    if (da->key_mode == TRIE_KEY_BYTE) {
+        da->num_labels = 256;
+    } else if (!build_labels(da, trie, num_edges)) {
+        datrie_free(da);
+        return NULL;
+    }
+    scan_words(da, trie->root, 0);
+
+    DABuilder b = {NULL, NULL, NULL, 0, 0};
+    DAQueueItem* queue = (DAQueueItem*)malloc((num_edges + 1) * sizeof(DAQueueItem));
+    DAChild* children = (DAChild*)malloc((da->num_labels + 1) * sizeof(DAChild));
+    int32_t* labels = (int32_t*)malloc((da->num_labels + 1) * sizeof(int32_t));
+    b.capacity = 1;
+    b.units = (DAUnit*)malloc(sizeof(DAUnit));
+    b.next_free = (int32_t*)malloc(sizeof(int32_t));
+    b.prev_free = (int32_t*)malloc(sizeof(int32_t));
+    bool ok = queue && children && labels && b.units && b.next_free && b.prev_free;
+    if (ok) {
+        /* Root is nobody's child and doubles as the free list head */
+        b.units[0].base = 0;
+        b.units[0].check = -2;
+        b.next_free[0] = 0;
+        b.prev_free[0] = 0;
+        ok = builder_reserve(&b, DA_INITIAL_UNITS);
+    }
+    if (!ok) {
+        free(queue);
+        free(children);
+        free(labels);
+        free(b.units);
+        free(b.next_free);
+        free(b.prev_free);
+        datrie_free(da);
+        return NULL;
+    }
+
+    /* Breadth-first placement keeps siblings of shallow nodes close */
+    int head = 0, tail = 0;
+    queue[tail].node = trie->root;
+    queue[tail].state = 0;
+    tail++;
+
+    while (head < tail) {
+        const TrieNode* node = queue[head].node;
+        int32_t state = queue[head].state;
+        head++;
+
+        uint32_t base = 0;
+        int k = node->num_children;
+        if (k > 0) {
+            for (int i = 0; i < k; i++) {
+                children[i].label = da_edge_label(da, trie_node_keys(node)[i]);
+                children[i].child = node->children[i];
+            }
+            qsort(children, k, sizeof(DAChild), compare_child);
+            for (int i = 0; i < k; i++) labels[i] = children[i].label;
+
+            int32_t found = builder_find_base(&b, labels, k, labels[k - 1]);
+            if (found < 0) {
+                ok = false;
+                break;
+            }
+            base = (uint32_t)found;
+            if (found > b.max_base) b.max_base = found;
+
+            for (int i = 0; i < k; i++) {
+                int32_t t = found + labels[i];
+                builder_take(&b, t, state);
+                queue[tail].node = children[i].child;
+                queue[tail].state = t;
+                tail++;
+            }
+        }
+        b.units[state].base = base | (node->is_end ? DA_END_FLAG : 0);
+    }
+
+    free(children);
+    free(labels);
+    free(b.next_free);
+    free(b.prev_free);
+
+    if (!ok) {
+        free(queue);
+        free(b.units);
+        datrie_free(da);
+        return NULL;
+    }
+
+    /* Pad so base + label never needs a bounds check. The base search
+     * already reserved this much, so this only trims the tail. */
+    int32_t size = b.max_base + da->num_labels + 1;
+    DAUnit* units = (DAUnit*)realloc(b.units, size * sizeof(DAUnit));
+    da->units = units ? units : b.units;
+    da->num_units = size;
+    da->num_words = trie->num_words;
+
+    /* The queue still pairs every node with its state */
+    da->values = (uint32_t*)calloc((size_t)size, sizeof(uint32_t));
+    if (!da->values) {
+        free(queue);
+        datrie_free(da);
+        return NULL;
+    }
+    for (int i = 0; i < tail; i++) {
+        if (!queue[i].node->is_end) continue;
+        da->values[queue[i].state] = queue[i].node->value;
+        da->value_total += queue[i].node->value;
+    }
+    da->has_values = trie->has_values;
+    free(queue);
+
+    return da;
+}
+
+/* Running payload total of an overlay being built */
+typedef struct {
+    const DATrie* base;
+    uint64_t total;
+} DAOverlayTotal;
+
+/* A word the base already has keeps its payload, so it is counted once */
+static void da_total_add(const char* word, size_t len, uint32_t value, void* user_data) {
+    DAOverlayTotal* t = (DAOverlayTotal*)user_data;
+    uint32_t base_value;
+    if (!datrie_word_value(t->base, word, len, &base_value)) t->total += value;
+}
+
+static void da_total_remove(const char* word, size_t len, uint32_t value, void* user_data) {
+    (void)value;
+    DAOverlayTotal* t = (DAOverlayTotal*)user_data;
+    uint32_t base_value;
+    if (datrie_word_value(t->base, word, len, &base_value)) {
+        t->total -= base_value < t->total ? base_value : t->total;
+    }
+}
+
+DATrie* datrie_build_overlay(DATrie* base, const Trie* added, const Trie* removed) {
+    if (!base || !added || !removed) return NULL;
+    if (added->key_mode != base->key_mode || removed->key_mode != base->key_mode) return NULL;
+
+    DATrie* da = datrie_build(added);
+    if (!da) return NULL;
+
+    if (removed->num_words > 0) {
+        da->removed = datrie_build(removed);
+        if (!da->removed) {
+            datrie_free(da);
+            return NULL;
+        }
+    }
+
+    /* Callers size look-behind windows from the longest visible word */
+    da->base = base;
+    if (base->max_word_bytes > da->max_word_bytes) da->max_word_bytes = base->max_word_bytes;
+    da->has_values = base->has_values;
+
+    /* The weighted engine scales costs by the total of the visible words */
+    DAOverlayTotal total = {base, base->value_total};
+    if (trie_for_each_word(added, da_total_add, &total) != 0 ||
+        trie_for_each_word(removed, da_total_remove, &total) != 0) {
+        datrie_free(da);
+        return NULL;
+    }
+    da->value_total = total.total;
+    return da;
+}
+
+/* Record a prefix end and, if values is not NULL, its payload; keep
+ * overwriting the last slot once full so the longest match wins */
+static inline void da_push_end(int* ends, uint32_t* values, int* count, int max_ends,
+                               int end, uint32_t value) {
+    int slot = *count < max_ends ? (*count)++ : max_ends - 1;
+    ends[slot] = end;
+    if (values) values[slot] = value;
+}
+
+/* Prefix ends and payloads of the words stored in da itself, ignoring
+ * any base; values may be NULL */
+static inline int da_own_prefix_ends(const DATrie* da, const char* text, size_t len, int* ends,
+                                     uint32_t* values, int max_ends) {
+    int count = 0;
+    int32_t state = 0;
+    const DAUnit* units = da->units;
+
+    if (da->key_mode == TRIE_KEY_BYTE) {
+        const unsigned char* s = (const unsigned char*)text;
+        for (size_t i = 0; i < len; i++) {
+            int32_t t = (int32_t)(units[state].base & DA_BASE_MASK) + s[i] + 1;
+            if (units[t].check != state) break;
+            state = t;
+            if (units[state].base & DA_END_FLAG) {
+                da_push_end(ends, values, &count, max_ends, (int)i + 1,
+                            values ? da->values[state] : 0);
+            }
+        }
+        return count;
+    }
+
+    const char* ptr = text;
+    const char* end = text + len;
+    int byte_pos = 0;
+
+    while (ptr < end) {
+        int byte_len;
+        int32_t label = da_label(da, utf8_decode_n(ptr, end - ptr, &byte_len));
+        if (!label) break;
+
+        state = da_next(da, state, label);
+        if (state < 0) break;
+
+        byte_pos += byte_len;
+
+        if (units[state].base & DA_END_FLAG) {
+            da_push_end(ends, values, &count, max_ends, byte_pos,
+                        values ? da->values[state] : 0);
+        }
+
+        ptr += byte_len;
+    }
+
+    return count;
+}
+
+/* Prefix ends of all layers, with payloads if values is not NULL */
+static int da_prefix_ends(const DATrie* da, const char* text, size_t len, int* ends,
+                          uint32_t* values, int max_ends) {
+    if (!da->base) return da_own_prefix_ends(da, text, len, ends, values, max_ends);
+
+    /* Merge the ascending ends of the base and of this layer, dropping base
+     * words this layer removed */
+    int below[TRIE_MAX_PREFIXES];
+    int own[TRIE_MAX_PREFIXES];
+    int gone[TRIE_MAX_PREFIXES];
+    uint32_t below_values[TRIE_MAX_PREFIXES];
+    uint32_t own_values[TRIE_MAX_PREFIXES];
+    int num_below = da_prefix_ends(da->base, text, len, below, values ? below_values : NULL,
+                                   TRIE_MAX_PREFIXES);
+    int num_own = da_own_prefix_ends(da, text, len, own, values ? own_values : NULL,
+                                     TRIE_MAX_PREFIXES);
+    int num_gone = da->removed ? da_own_prefix_ends(da->removed, text, len, gone, NULL,
+                                                    TRIE_MAX_PREFIXES) : 0;
+
+    int count = 0;
+    int i = 0, j = 0, k = 0;
+    while (i < num_below || j < num_own) {
+        if (j < num_own && (i >= num_below || own[j] <= below[i])) {
+            if (i < num_below && below[i] == own[j]) i++;
+            da_push_end(ends, values, &count, max_ends, own[j],
+                        values ? own_values[j] : 0);
+            j++;
+            continue;
+        }
+
+        int end = below[i++];
+        while (k < num_gone && gone[k] < end) k++;
+        if (k < num_gone && gone[k] == end) continue;
+        da_push_end(ends, values, &count, max_ends, end, values ? below_values[i - 1] : 0);
+    }
+
+    return count;
+}
+
+int datrie_prefix_ends(const DATrie* da, const char* text, size_t len, int* ends, int max_ends) {
+    if (!da || !text || !ends || max_ends <= 0) return 0;
+
+    return da_prefix_ends(da, text, len, ends, NULL, max_ends);
+}
+
+int datrie_prefix_values(const DATrie* da, const char* text, size_t len, int* ends,
+                         uint32_t* values, int max_ends) {
+    if (!da || !text || !ends || !values || max_ends <= 0) return 0;
+
+    return da_prefix_ends(da, text, len, ends, values, max_ends);
+}
+
+/* Same as datrie_has_prefix() for the words stored in da itself */
+static bool da_own_has_prefix(const DATrie* da, const char* text, size_t len) {
+    int32_t state = 0;
+    const DAUnit* units = da->units;
+
+    if (da->key_mode == TRIE_KEY_BYTE) {
+        const unsigned char* s = (const unsigned char*)text;
+        for (size_t i = 0; i < len; i++) {
+            int32_t t = (int32_t)(units[state].base & DA_BASE_MASK) + s[i] + 1;
+            if (units[t].check != state) return false;
+            state = t;
+            if (units[state].base & DA_END_FLAG) return true;
+        }
+        return false;
+    }
+
+    const char* ptr = text;
+    const char* end = text + len;
+
+    while (ptr < end) {
+        int byte_len;
+        int32_t label = da_label(da, utf8_decode_n(ptr, end - ptr, &byte_len));
+        if (!label) return false;
+
+        state = da_next(da, state, label);
+        if (state < 0) return false;
+        if (units[state].base & DA_END_FLAG) return true;
+
+        ptr += byte_len;
+    }
+
+    return false;
+}
+
+bool datrie_has_prefix(const DATrie* da, const char* text, size_t len) {
+    if (!da || !text) return false;
+    if (!da->base) return da_own_has_prefix(da, text, len);
+
+    if (da_own_has_prefix(da, text, len)) return true;
+    if (!da->removed) return datrie_has_prefix(da->base, text, len);
+
+    int ends[TRIE_MAX_PREFIXES];
+    return datrie_prefix_ends(da, text, len, ends, TRIE_MAX_PREFIXES) > 0;
+}
+
+/* State reached by consuming all of text in da itself, -1 if none */
+static int32_t da_own_walk(const DATrie* da, const char* text, size_t len) {
+    int32_t state = 0;
+    const DAUnit* units = da->units;
+
+    if (da->key_mode == TRIE_KEY_BYTE) {
+        const unsigned char* s = (const unsigned char*)text;
+        for (size_t i = 0; i < len; i++) {
+            int32_t t = (int32_t)(units[state].base & DA_BASE_MASK) + s[i] + 1;
+            if (units[t].check != state) return -1;
+            state = t;
+        }
+        return state;
+    }
+
+    const char* ptr = text;
+    const char* end = text + len;
+
+    while (ptr < end) {
+        int byte_len;
+        int32_t label = da_label(da, utf8_decode_n(ptr, end - ptr, &byte_len));
+        if (!label) return -1;
+
+        state = da_next(da, state, label);
+        if (state < 0) return -1;
+
+        ptr += byte_len;
+    }
+
+    return state;
+}
+
+/* Whether text is a word stored in da itself */
+static inline bool da_own_is_word(const DATrie* da, int32_t state) {
+    return state > 0 && (da->units[state].base & DA_END_FLAG);
+}
+
+bool datrie_word_value(const DATrie* da, const char* word, size_t len, uint32_t* value) {
+    if (!word || len == 0) return false;
+
+    for (; da; da = da->base) {
+        int32_t state = da_own_walk(da, word, len);
+        if (da_own_is_word(da, state)) {
+            if (value) *value = da->values[state];
+            return true;
+        }
+        if (da->removed && da_own_is_word(da->removed, da_own_walk(da->removed, word, len))) {
+            return false;
+        }
+    }
+    return false;
+}
+
+/* Round up to the 8-byte alignment used for every array in the file */
+static uint64_t da_align(uint64_t offset) {
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+static bool write_padded(FILE* fp, const void* data, size_t size, uint64_t* offset) {
+    static const char zeros[8] = {0};
+
+    if (size > 0 && fwrite(data, 1, size, fp) != size) return false;
+    *offset += size;
+
+    size_t pad = (size_t)(da_align(*offset) - *offset);
+    if (pad > 0 && fwrite(zeros, 1, pad, fp) != pad) return false;
+    *offset += pad;
+    return true;
+}
+
+int datrie_save(const DATrie* da, const char* path) {
+    if (!da || !path || da->base) return -1;
+
+    DAFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DA_FILE_MAGIC, sizeof(DA_FILE_MAGIC));
+    header.version = DA_FILE_VERSION;
+    header.byte_order = DA_FILE_BYTE_ORDER;
+    header.key_mode = (uint32_t)da->key_mode;
+    header.num_units = da->num_units;
+    header.num_words = da->num_words;
+    header.num_labels = da->num_labels;
+    header.num_ext = da->num_ext;
+    header.max_word_bytes = da->max_word_bytes;
+    header.flags = da->has_values ? DA_FILE_HAS_VALUES : 0;
+    header.value_total = da->value_total;
+    memcpy(header.ascii_labels, da->ascii_labels, sizeof(header.ascii_labels));
+    memcpy(header.thai_labels, da->thai_labels, sizeof(header.thai_labels));
+
+    size_t units_size = (size_t)da->num_units * sizeof(DAUnit);
+    size_t ext_size = (size_t)da->num_ext * sizeof(int32_t);
+    size_t values_size = (size_t)da->num_units * sizeof(uint32_t);
+    header.units_offset = da_align(sizeof(DAFileHeader));
+    header.ext_cps_offset = header.units_offset + da_align(units_size);
+    header.ext_labels_offset = header.ext_cps_offset + da_align(ext_size);
+    header.values_offset = header.ext_labels_offset + da_align(ext_size);
+    header.file_size = header.values_offset + da_align(values_size);
+
+    FILE* fp = fopen(path, "wb");
+    if (!fp) return -1;
+
+    uint64_t offset = 0;
+    bool ok = write_padded(fp, &header, sizeof(header), &offset) &&
+              write_padded(fp, da->units, units_size, &offset) &&
+              write_padded(fp, da->ext_cps, ext_size, &offset) &&
+              write_padded(fp, da->ext_labels, ext_size, &offset) &&
+              write_padded(fp, da->values, values_size, &offset);
+
+    if (fclose(fp) != 0) ok = false;
+    if (!ok) {
+        remove(path);
+        return -1;
+    }
+    return 0;
+}
+
+/* Write count ints of a label table as initializer rows */
+static void write_labels(FILE* fp, const int32_t* labels, int count) {
+    for (int i = 0; i < count; i++) {
+        fprintf(fp, "%s%d,%s", i % 16 == 0 ? "        " : " ", labels[i],
+                i % 16 == 15 || i == count - 1 ? "\n" : "");
+    }
+}
+
+/* Write an int array definition, or nothing if it is empty */
+static void write_int_array(FILE* fp, const char* name, const char* suffix,
+                            const int32_t* values, int count) {
+    if (count == 0) return;
+
+    fprintf(fp, "static const int32_t %s_%s[%d] = {\n", name, suffix, count);
+    for (int i = 0; i < count; i++) {
+        fprintf(fp, "%s%d,%s", i % 8 == 0 ? "    " : " ", values[i],
+                i % 8 == 7 || i == count - 1 ? "\n" : "");
+    }
+    fprintf(fp, "};\n\n");
+}
+
+int datrie_save_source(const DATrie* da, const char* path, const char* name, const char* origin) {
+    if (!da || !path || !name || !origin || da->base) return -1;
+
+    FILE* fp = fopen(path, "w");
+    if (!fp) return -1;
+
+    const char* file = strrchr(path, '/');
+    file = file ? file + 1 : path;
+    fprintf(fp, "/**\n * @file %s\n * @brief Compact trie of %s\n *\n", file, origin);
+    fprintf(fp, " * Generated by embed_dict; do not edit.\n */\n\n");
+    fprintf(fp, "#include \"datrie.h\"\n#include <stddef.h>\n\n");
+
+    fprintf(fp, "static const DAUnit %s_units[%d] = {\n", name, da->num_units);
+    for (int32_t i = 0; i < da->num_units; i++) {
+        fprintf(fp, "%s{0x%08Xu, %d},%s", i % 4 == 0 ? "    " : " ",
+                (unsigned)da->units[i].base, (int)da->units[i].check,
+                i % 4 == 3 || i == da->num_units - 1 ? "\n" : "");
+    }
+    fprintf(fp, "};\n\n");
+    write_int_array(fp, name, "ext_cps", da->ext_cps, da->num_ext);
+    write_int_array(fp, name, "ext_labels", da->ext_labels, da->num_ext);
+
+    fprintf(fp, "static const uint32_t %s_values[%d] = {\n", name, da->num_units);
+    for (int32_t i = 0; i < da->num_units; i++) {
+        fprintf(fp, "%s%uu,%s", i % 8 == 0 ? "    " : " ", (unsigned)da->values[i],
+                i % 8 == 7 || i == da->num_units - 1 ? "\n" : "");
+    }
+    fprintf(fp, "};\n\n");
+
+    fprintf(fp, "const DAImage %s = {\n", name);
+    fprintf(fp, "    %s_units,\n    %d,\n    %d,\n    %s,\n", name, da->num_units,
+            da->num_words, da->key_mode == TRIE_KEY_BYTE ? "TRIE_KEY_BYTE" : "TRIE_KEY_CODEPOINT");
+    fprintf(fp, "    {\n");
+    write_labels(fp, da->ascii_labels, 128);
+    fprintf(fp, "    },\n    {\n");
+    write_labels(fp, da->thai_labels, DA_THAI_SIZE);
+    fprintf(fp, "    },\n");
+    if (da->num_ext > 0) {
+        fprintf(fp, "    %s_ext_cps,\n    %s_ext_labels,\n", name, name);
+    } else {
+        fprintf(fp, "    NULL,\n    NULL,\n");
+    }
+    fprintf(fp, "    %d,\n    %d,\n    %d,\n", da->num_ext, da->num_labels,
+            da->max_word_bytes);
+    fprintf(fp, "    %s_values,\n    %s,\n    %lluu\n};\n", name,
+            da->has_values ? "true" : "false", (unsigned long long)da->value_total);
+
+    bool ok = !ferror(fp);
+    if (fclose(fp) != 0) ok = false;
+    if (!ok) {
+        remove(path);
+        return -1;
+    }
+    return 0;
+}
+
+DATrie* datrie_from_image(const DAImage* image) {
+    if (!image) return NULL;
+
+    DATrie* da = da_new();
+    if (!da) return NULL;
+
+    /* The arrays are never written through these pointers */
+    da->units = (DAUnit*)image->units;
+    da->num_units = image->num_units;
+    da->num_words = image->num_words;
+    da->key_mode = image->key_mode;
+    memcpy(da->ascii_labels, image->ascii_labels, sizeof(da->ascii_labels));
+    memcpy(da->thai_labels, image->thai_labels, sizeof(da->thai_labels));
+    da->ext_cps = (int32_t*)image->ext_cps;
+    da->ext_labels = (int32_t*)image->ext_labels;
+    da->num_ext = image->num_ext;
+    da->num_labels = image->num_labels;
+    da->max_word_bytes = image->max_word_bytes;
+    da->values = (uint32_t*)image->values;
+    da->has_values = image->has_values;
+    da->value_total = image->value_total;
+    da->image = image;
+    return da;
+}
+
+/* Make sure no lookup in a loaded image can index out of bounds */
+static bool da_image_valid(const DATrie* da) {
+    if (da->num_units < 1 || da->num_labels < 0 || da->num_ext < 0) return false;
+    if (da->key_mode != TRIE_KEY_CODEPOINT && da->key_mode != TRIE_KEY_BYTE) return false;
+    if (da->key_mode == TRIE_KEY_BYTE && da->num_labels != 256) return false;
+
+    for (int i = 0; i < 128; i++) {
+        if (da->ascii_labels[i] < 0 || da->ascii_labels[i] > da->num_labels) return false;
+    }
+    for (int i = 0; i < DA_THAI_SIZE; i++) {
+        if (da->thai_labels[i] < 0 || da->thai_labels[i] > da->num_labels) return false;
+    }
+    for (int i = 0; i < da->num_ext; i++) {
+        if (da->ext_labels[i] < 0 || da->ext_labels[i] > da->num_labels) return false;
+    }
+    for (int32_t i = 0; i < da->num_units; i++) {
+        int64_t last = (int64_t)(da->units[i].base & DA_BASE_MASK) + da->num_labels;
+        if (last >= da->num_units || da->units[i].check >= da->num_units) return false;
+    }
+    return true;
+}
+
+/* Map the whole file read-only, or read it where mmap is unavailable */
+static void* da_map_file(const char* path, size_t* size) {
+#ifdef _WIN32
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    if (fseek(fp, 0, SEEK_END) != 0) {
+        fclose(fp);
+        return NULL;
+    }
+    long length = ftell(fp);
+    if (length <= 0 || fseek(fp, 0, SEEK_SET) != 0) {
+        fclose(fp);
+        return NULL;
+    }
+    void* data = malloc((size_t)length);
+    if (data && fread(data, 1, (size_t)length, fp) != (size_t)length) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    *size = (size_t)length;
+    return data;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+
+    *size = (size_t)st.st_size;
+    return data;
+#endif
+}
+
+static void da_unmap_file(void* data, size_t size) {
+#ifdef _WIN32
+    (void)size;
+    free(data);
+#else
+    munmap(data, size);
+#endif
+}
+
+/* Check that n bytes at offset lie within a file of size bytes, written
+ * so that no offset in a crafted header can wrap around */
+static bool da_range_ok(uint64_t offset, size_t n, size_t size) {
+    return offset <= size && size - offset >= n;
+}
+
+DATrie* datrie_load_mmap(const char* path) {
+    if (!path) return NULL;
+
+    size_t size = 0;
+    void* data = da_map_file(path, &size);
+    if (!data) return NULL;
+
+    const DAFileHeader* header = (const DAFileHeader*)data;
+    size_t units_size = 0, ext_size = 0, values_size = 0;
+    bool ok = size >= sizeof(DAFileHeader) &&
+              memcmp(header->magic, DA_FILE_MAGIC, sizeof(DA_FILE_MAGIC)) == 0 &&
+              header->version == DA_FILE_VERSION &&
+              header->byte_order == DA_FILE_BYTE_ORDER &&
+              header->file_size == size &&
+              header->num_units > 0 && header->num_ext >= 0 &&
+              header->max_word_bytes >= 0;
+    if (ok) {
+        units_size = (size_t)header->num_units * sizeof(DAUnit);
+        ext_size = (size_t)header->num_ext * sizeof(int32_t);
+        values_size = (size_t)header->num_units * sizeof(uint32_t);
+        ok = header->units_offset % 8 == 0 && header->ext_cps_offset % 8 == 0 &&
+             header->ext_labels_offset % 8 == 0 && header->values_offset % 8 == 0 &&
+             da_range_ok(header->units_offset, units_size, size) &&
+             da_range_ok(header->ext_cps_offset, ext_size, size) &&
+             da_range_ok(header->ext_labels_offset, ext_size, size) &&
+             da_range_ok(header->values_offset, values_size, size);
+    }
+
+    DATrie* da = ok ? da_new() : NULL;
+    if (!da) {
+        da_unmap_file(data, size);
+        return NULL;
+    }
+
+    const char* base = (const char*)data;
+    da->units = (DAUnit*)(base + header->units_offset);
+    da->num_units = header->num_units;
+    da->num_words = header->num_words;
+    da->key_mode = (TrieKeyMode)header->key_mode;
+    memcpy(da->ascii_labels, header->ascii_labels, sizeof(da->ascii_labels));
+    memcpy(da->thai_labels, header->thai_labels, sizeof(da->thai_labels));
+    da->ext_cps = (int32_t*)(base + header->ext_cps_offset);
+    da->ext_labels = (int32_t*)(base + header->ext_labels_offset);
+    da->num_ext = header->num_ext;
+    da->num_labels = header->num_labels;
+    da->max_word_bytes = header->max_word_bytes;
+    da->values = (uint32_t*)(base + header->values_offset);
+    da->has_values = (header->flags & DA_FILE_HAS_VALUES) != 0;
+    da->value_total = header->value_total;
+    da->mapping = data;
+    da->mapping_size = size;
+
+    if (!da_image_valid(da)) {
+        datrie_free(da);
+        return NULL;
+    }
+    return da;
+}
+
+bool datrie_file_is_binary(const char* path) {
+    if (!path) return false;
+
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return false;
+
+    char magic[8];
+    bool is_binary = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) &&
+                     memcmp(magic, DA_FILE_MAGIC, sizeof(DA_FILE_MAGIC)) == 0;
+    fclose(fp);
+    return is_binary;
+}
+
+size_t datrie_memory_usage(const DATrie* da) {
+    if (!da) return 0;
+
+    /* A shared base is accounted to its own handle */
+    return sizeof(DATrie) +
+           (size_t)da->num_units * (sizeof(DAUnit) + sizeof(uint32_t)) +
+           (size_t)da->num_ext * 2 * sizeof(int32_t) +
+           datrie_memory_usage(da->removed);
+}
+
+void datrie_free(DATrie* da) {
+    if (!da) return;
+
+    datrie_free(da->removed);
+
+    if (da->mapping) {
+        da_unmap_file(da->mapping, da->mapping_size);
+        free(da);
+        return;
+    }
+    if (da->image) {
+        free(da);
+        return;
+    }
+
+    free(da->units);
+    free(da->ext_cps);
+    free(da->ext_labels);
+    free(da->values);
+    free(da);
+}
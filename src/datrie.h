@@ -0,0 +1,230 @@
+/**
+ * @file datrie.h
+ * @brief Compact double-array trie for dictionary lookup
+ *
+ * Internal header. A DATrie is a frozen, read-only copy of a Trie laid
+ * out in two flat arrays (base/check), so every child transition is a
+ * single array access instead of a linear scan over heap-allocated
+ * child lists.
+ *
+ * The keying mode is inherited from the source Trie. Codepoint keying
+ * decodes UTF-8 and maps each codepoint to a dense label; byte keying
+ * uses byte + 1 as the label and never decodes.
+ *
+ * An overlay is a small DATrie layered on a shared base: lookups see the
+ * base words minus those in the overlay's removed trie, plus its own.
+ */
+
+#ifndef DATRIE_H
+#define DATRIE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "trie.h"
+
+/* High bit of DAUnit.base marks a state where a word ends */
+#define DA_END_FLAG  0x80000000u
+#define DA_BASE_MASK 0x7FFFFFFFu
+
+/* Range of the Thai block labelled through a direct table */
+#define DA_THAI_FIRST 0x0E00
+#define DA_THAI_SIZE  128
+
+typedef struct {
+    uint32_t base;   /* Offset of the child block, plus DA_END_FLAG */
+    int32_t check;   /* Parent state of this cell, -1 if free */
+} DAUnit;
+
+typedef struct DATrie {
+    DAUnit* units;
+    int32_t num_units;
+    int32_t num_words;
+    TrieKeyMode key_mode;
+
+    /* Codepoint -> dense label (1..num_labels), 0 if never used.
+     * In byte mode, where num_labels is 256, ascii_labels only records
+     * which ASCII bytes occur in words and thai_labels is unused. */
+    int32_t ascii_labels[128];
+    int32_t thai_labels[DA_THAI_SIZE];
+    int32_t* ext_cps;      /* Sorted codepoints outside ASCII and Thai */
+    int32_t* ext_labels;   /* Labels for ext_cps */
+    int32_t num_ext;
+    int32_t num_labels;
+    int32_t max_word_bytes;   /* Byte length of the longest word */
+
+    /* Payload of the word ending at each state, indexed like units */
+    uint32_t* values;
+    bool has_values;   /* Payloads were given explicitly, not numbered */
+    uint64_t value_total;   /* Sum of the word payloads */
+
+    /* Backing file image when loaded by datrie_load_mmap(); the arrays
+     * above then point into it and are read-only */
+    void* mapping;
+    size_t mapping_size;
+
+    /* Image compiled into the program that the arrays above belong to,
+     * or NULL; they are then read-only and never freed */
+    const struct DAImage* image;
+
+    /* Handle references beyond the creator's, updated atomically by
+     * newmm_dict_retain() and newmm_dict_release() */
+    long extra_refs;
+
+    /* Unique among the tries created by the process, unlike addresses,
+     * which are reused once a trie is freed */
+    uint64_t id;
+
+    /* Overlay layering, both NULL for a plain trie. The overlay holds a
+     * handle reference to base and owns removed. */
+    struct DATrie* base;
+    struct DATrie* removed;
+} DATrie;
+
+/* Compact trie held in constant arrays of the program, as written by
+ * datrie_save_source() */
+typedef struct DAImage {
+    const DAUnit* units;
+    int32_t num_units;
+    int32_t num_words;
+    TrieKeyMode key_mode;
+    int32_t ascii_labels[128];
+    int32_t thai_labels[DA_THAI_SIZE];
+    const int32_t* ext_cps;
+    const int32_t* ext_labels;
+    int32_t num_ext;
+    int32_t num_labels;
+    int32_t max_word_bytes;
+    const uint32_t* values;
+    bool has_values;
+    uint64_t value_total;
+} DAImage;
+
+/* Default dictionary linked into the library, see default_dict.c */
+extern const DAImage default_dict_image;
+
+/**
+ * @brief Build a compact trie from a mutable trie
+ *
+ * The source trie is not modified and can be freed afterwards. Word
+ * payloads are copied along.
+ *
+ * @return New compact trie, or NULL on allocation failure
+ */
+DATrie* datrie_build(const Trie* trie);
+
+/**
+ * @brief Build an overlay of base that adds and removes some words
+ *
+ * Only added and removed are compiled, so the cost is proportional to the
+ * overlay, not the base. The two tries must have base's keying mode and
+ * no word in common. The overlay keeps a pointer to base but does not
+ * take a reference; the caller gives it one.
+ *
+ * @return New overlay trie, or NULL on allocation failure
+ */
+DATrie* datrie_build_overlay(DATrie* base, const Trie* added, const Trie* removed);
+
+/**
+ * @brief Check whether ASCII character c occurs in any word
+ */
+static inline bool datrie_uses_ascii(const DATrie* da, unsigned char c) {
+    if (c >= 0x80) return false;
+    for (; da; da = da->base) {
+        if (da->ascii_labels[c] != 0) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Get the end offsets of all word prefixes of text
+ *
+ * Same contract as trie_prefix_ends(), but text is the len bytes at
+ * text and need not be NUL-terminated.
+ */
+int datrie_prefix_ends(const DATrie* da, const char* text, size_t len, int* ends, int max_ends);
+
+/**
+ * @brief Same as datrie_prefix_ends(), also writing each word's payload
+ *        to values
+ */
+int datrie_prefix_values(const DATrie* da, const char* text, size_t len, int* ends,
+                         uint32_t* values, int max_ends);
+
+/**
+ * @brief Check whether any word is a prefix of the len bytes at text
+ *
+ * Same contract as trie_has_prefix().
+ */
+bool datrie_has_prefix(const DATrie* da, const char* text, size_t len);
+
+/**
+ * @brief Look up the payload of a word
+ *
+ * The len bytes at word must match a word exactly; overlays see their own
+ * words, then the base words they did not remove.
+ *
+ * @return true and the payload in *value if word is in the trie
+ */
+bool datrie_word_value(const DATrie* da, const char* word, size_t len, uint32_t* value);
+
+/**
+ * @brief Write the compact trie to a binary file
+ *
+ * The file holds only offsets, so it can be mapped at any address.
+ * Overlays cannot be saved.
+ *
+ * @return 0 on success, -1 on error
+ */
+int datrie_save(const DATrie* da, const char* path);
+
+/**
+ * @brief Write the compact trie as a C source file defining a DAImage
+ *
+ * The file defines `const DAImage name` over static const arrays, so once
+ * compiled in, the trie sits in read-only data and needs no loading.
+ * origin names the word list in the file's header comment. Overlays
+ * cannot be written.
+ *
+ * @return 0 on success, -1 on error
+ */
+int datrie_save_source(const DATrie* da, const char* path, const char* name, const char* origin);
+
+/**
+ * @brief Use a compiled-in image as a compact trie
+ *
+ * Only the small header is allocated; the arrays are used in place.
+ *
+ * @return Compact trie, or NULL on allocation failure
+ */
+DATrie* datrie_from_image(const DAImage* image);
+
+/**
+ * @brief Map a file written by datrie_save() read-only
+ *
+ * The arrays are used in place, so loading does no parsing and processes
+ * mapping the same file share its pages. On platforms without mmap the
+ * file is read into memory instead.
+ *
+ * @return Compact trie, or NULL if the file is missing or not a valid image
+ */
+DATrie* datrie_load_mmap(const char* path);
+
+/**
+ * @brief Check whether a file starts with the binary dictionary magic
+ */
+bool datrie_file_is_binary(const char* path);
+
+/**
+ * @brief Bytes held by the compact trie (heap or mapped)
+ */
+size_t datrie_memory_usage(const DATrie* da);
+
+/**
+ * @brief Free compact trie memory
+ *
+ * An overlay's removed trie is freed with it; its base is not.
+ */
+void datrie_free(DATrie* da);
+
+#endif /* DATRIE_H */
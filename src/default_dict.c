@@ -0,0 +1,112 @@
+/**
+ * @file default_dict.c
+ * @brief Compact trie of data/default_words.txt
+ *
+ * Generated by embed_dict; do not edit.
+ */
+
+#include "datrie.h"
+#include <stddef.h>
+
+static const DAUnit default_dict_image_units[162] = {
+    {0x00000001u, -2}, {0x00000000u, -1}, {0x00000001u, 0}, {0x00000002u, 0},
+    {0x0000001Du, 0}, {0x00000002u, 0}, {0x00000005u, 0}, {0x00000001u, 0},
+    {0x00000059u, 36}, {0x00000007u, 0}, {0x0000000Cu, 0}, {0x0000000Fu, 0},
+    {0x00000014u, 0}, {0x80000000u, 26}, {0x00000010u, 0}, {0x0000001Fu, 0},
+    {0x80000000u, 25}, {0x00000019u, 0}, {0x0000001Du, 0}, {0x0000001Eu, 0},
+    {0x00000042u, 23}, {0x0000001Fu, 0}, {0x0000001Eu, 0}, {0x00000002u, 0},
+    {0x00000029u, 0}, {0x0000000Cu, 3}, {0x00000001u, 2}, {0x0000002Eu, 2},
+    {0x00000044u, 5}, {0x80000000u, 6}, {0x0000002Au, 7}, {0x0000004Fu, 6},
+    {0x0000003Eu, 9}, {0x00000043u, 9}, {0x00000035u, 0}, {0x00000035u, 0},
+    {0x00000001u, 0}, {0x00000033u, 0}, {0x0000003Au, 0}, {0x80000000u, 2},
+    {0x80000000u, 4}, {0x00000050u, 10}, {0x0000002Cu, 3}, {0x0000002Fu, 11},
+    {0x80000000u, 14}, {0x00000057u, 12}, {0x00000056u, 11}, {0x00000032u, 4},
+    {0x00000031u, 12}, {0x00000033u, 4}, {0x80000000u, 15}, {0x80000000u, 17},
+    {0x0000003Bu, 10}, {0x80000000u, 17}, {0x00000057u, 18}, {0x00000050u, 19},
+    {0x00000052u, 21}, {0x00000038u, 22}, {0x00000041u, 24}, {0x00000037u, 4},
+    {0x00000044u, 34}, {0x00000040u, 35}, {0x80000000u, 37}, {0x00000032u, 15},
+    {0x80000000u, 27}, {0x00000044u, 38}, {0x0000003Du, 34}, {0x80000000u, 42},
+    {0x00000046u, 34}, {0x00000047u, 34}, {0x00000044u, 21}, {0x80000000u, 38},
+    {0x00000051u, 35}, {0x00000043u, 37}, {0x00000046u, 38}, {0x00000046u, 47},
+    {0x00000062u, 34}, {0x0000005Fu, 49}, {0x80000000u, 59}, {0x80000000u, 28},
+    {0x80000000u, 31}, {0x0000006Cu, 30}, {0x80000000u, 32}, {0x80000000u, 33},
+    {0x80000000u, 41}, {0x80000000u, 52}, {0x80000000u, 43}, {0x80000000u, 46},
+    {0x80000000u, 45}, {0x80000000u, 48}, {0x80000000u, 63}, {0x80000000u, 54},
+    {0x80000000u, 55}, {0x80000000u, 56}, {0x80000000u, 70}, {0x0000006Eu, 57},
+    {0x0000005Cu, 20}, {0x0000004Du, 58}, {0x0000005Fu, 60}, {0x0000006Cu, 66},
+    {0x00000051u, 68}, {0x00000053u, 69}, {0x80000000u, 76}, {0x80000000u, 61},
+    {0x0000005Bu, 58}, {0x80000000u, 72}, {0x80000000u, 8}, {0x80000000u, 73},
+    {0x80000000u, 65}, {0x80000000u, 74}, {0x00000078u, 75}, {0x80000000u, 77},
+    {0x80000000u, 81}, {0x80000000u, 127}, {0x80000000u, 95}, {0x80000000u, 96},
+    {0x80000000u, 97}, {0x00000079u, 104}, {0x00000073u, 98}, {0x80000000u, 99},
+    {0x00000069u, 100}, {0x00000067u, 72}, {0x0000006Au, 101}, {0x80000000u, 121},
+    {0x80000000u, 110}, {0x80000000u, 117}, {0x80000000u, 118}, {0x00000066u, 45},
+    {0x80000000u, 120}, {0x80000000u, 122}, {0x00000000u, -1}, {0x00000000u, -1},
+    {0x00000000u, -1}, {0x00000000u, -1}, {0x00000000u, -1}, {0x00000000u, -1},
+    {0x00000000u, -1}, {0x00000000u, -1}, {0x00000000u, -1}, {0x00000000u, -1},
+    {0x00000000u, -1}, {0x00000000u, -1}, {0x00000000u, -1}, {0x00000000u, -1},
+    {0x00000000u, -1}, {0x00000000u, -1}, {0x00000000u, -1}, {0x00000000u, -1},
+    {0x00000000u, -1}, {0x00000000u, -1}, {0x00000000u, -1}, {0x00000000u, -1},
+    {0x00000000u, -1}, {0x00000000u, -1}, {0x00000000u, -1}, {0x00000000u, -1},
+    {0x00000000u, -1}, {0x00000000u, -1}, {0x00000000u, -1}, {0x00000000u, -1},
+    {0x00000000u, -1}, {0x00000000u, -1},
+};
+
+static const uint32_t default_dict_image_values[162] = {
+    0u, 0u, 0u, 0u, 0u, 0u, 0u, 0u,
+    0u, 0u, 0u, 0u, 0u, 13u, 0u, 0u,
+    12u, 0u, 0u, 0u, 0u, 0u, 0u, 0u,
+    0u, 0u, 0u, 0u, 0u, 10u, 0u, 0u,
+    0u, 0u, 0u, 0u, 0u, 0u, 0u, 14u,
+    39u, 0u, 0u, 0u, 41u, 0u, 0u, 0u,
+    0u, 0u, 37u, 1u, 0u, 8u, 0u, 0u,
+    0u, 0u, 0u, 0u, 0u, 0u, 2u, 0u,
+    24u, 0u, 0u, 48u, 0u, 0u, 0u, 0u,
+    0u, 0u, 0u, 0u, 0u, 0u, 6u, 47u,
+    26u, 0u, 44u, 34u, 29u, 16u, 3u, 32u,
+    35u, 20u, 38u, 36u, 49u, 40u, 30u, 0u,
+    0u, 0u, 0u, 0u, 0u, 0u, 31u, 33u,
+    0u, 4u, 27u, 15u, 9u, 11u, 0u, 25u,
+    19u, 21u, 46u, 5u, 22u, 0u, 0u, 7u,
+    0u, 0u, 0u, 17u, 43u, 28u, 42u, 0u,
+    23u, 18u, 0u, 0u, 0u, 0u, 0u, 0u,
+    0u, 0u, 0u, 0u, 0u, 0u, 0u, 0u,
+    0u, 0u, 0u, 0u, 0u, 0u, 0u, 0u,
+    0u, 0u, 0u, 0u, 0u, 0u, 0u, 0u,
+    0u, 0u,
+};
+
+const DAImage default_dict_image = {
+    default_dict_image_units,
+    162,
+    49,
+    TRIE_KEY_CODEPOINT,
+    {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    },
+    {
+        0, 1, 2, 0, 3, 0, 0, 4, 5, 0, 0, 6, 0, 0, 0, 0,
+        0, 0, 0, 0, 7, 8, 9, 10, 0, 11, 12, 13, 14, 0, 15, 0,
+        0, 16, 17, 18, 0, 19, 0, 20, 0, 0, 21, 22, 0, 23, 0, 0,
+        24, 25, 26, 0, 27, 28, 29, 30, 31, 32, 0, 0, 0, 0, 0, 0,
+        33, 34, 35, 36, 37, 0, 0, 38, 39, 40, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    },
+    NULL,
+    NULL,
+    0,
+    40,
+    15,
+    default_dict_image_values,
+    false,
+    1180u
+};
@@ -0,0 +1,220 @@
+/**
+ * @file dict.c
+ * @brief Reference counting and hot swapping of dictionary handles
+ *
+ * A dictionary is never modified after loading, so sharing it only
+ * needs its lifetime managed: every user holds a reference, and the last
+ * release frees it. A slot publishes the current dictionary of a
+ * long-running service; replacing it never disturbs readers that are
+ * still segmenting with the previous one, which is freed once they
+ * release it.
+ *
+ * The process-wide cache keeps the dictionaries most recently loaded by
+ * path, so the path-based API does not parse the file on every call.
+ */
+
+#include "../include/newmm.h"
+#include "datrie.h"
+#include "thread.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/* Dictionaries kept loaded by the cache, most recently used first */
+#define DICT_CACHE_SIZE 4
+
+struct newmm_dict_slot {
+    thread_mutex_t lock;   /* Guards dict against a concurrent swap */
+    newmm_dict_t dict;     /* Holds one reference */
+};
+
+newmm_dict_t newmm_dict_retain(newmm_dict_t dict) {
+    if (dict) thread_fetch_add_acq_rel((thread_counter_t*)&((DATrie*)dict)->extra_refs, 1);
+    return dict;
+}
+
+void newmm_dict_release(newmm_dict_t dict) {
+    /* The creator's reference is not counted, so 0 means it was the last.
+     * A freed overlay then drops the reference it held to its base. */
+    while (dict && thread_fetch_add_acq_rel((thread_counter_t*)&((DATrie*)dict)->extra_refs, -1) == 0) {
+        DATrie* base = ((DATrie*)dict)->base;
+        datrie_free((DATrie*)dict);
+        dict = (newmm_dict_t)base;
+    }
+}
+
+void newmm_free_dict(newmm_dict_t dict) {
+    newmm_dict_release(dict);
+}
+
+newmm_dict_slot_t* newmm_dict_slot_create(newmm_dict_t dict) {
+    if (!dict) return NULL;
+    
+    newmm_dict_slot_t* slot = (newmm_dict_slot_t*)malloc(sizeof(newmm_dict_slot_t));
+    if (!slot) return NULL;
+    
+    thread_mutex_init(&slot->lock);
+    slot->dict = newmm_dict_retain(dict);
+    return slot;
+}
+
+newmm_dict_t newmm_dict_slot_get(newmm_dict_slot_t* slot) {
+    if (!slot) return NULL;
+    
+    thread_mutex_lock(&slot->lock);
+    newmm_dict_t dict = newmm_dict_retain(slot->dict);
+    thread_mutex_unlock(&slot->lock);
+    return dict;
+}
+
+int newmm_dict_slot_set(newmm_dict_slot_t* slot, newmm_dict_t dict) {
+    if (!slot || !dict) return -1;
+    
+    newmm_dict_retain(dict);
+    thread_mutex_lock(&slot->lock);
+    newmm_dict_t old = slot->dict;
+    slot->dict = dict;
+    thread_mutex_unlock(&slot->lock);
+    
+    /* Readers that fetched old before the swap still hold it */
+    newmm_dict_release(old);
+    return 0;
+}
+
+void newmm_dict_slot_free(newmm_dict_slot_t* slot) {
+    if (!slot) return;
+    
+    newmm_dict_release(slot->dict);
+    thread_mutex_destroy(&slot->lock);
+    free(slot);
+}
+
+/* What identifies one version of a dictionary file; all -1 if unknown */
+typedef struct {
+    long long mtime_ns;    /* Modification time in nanoseconds */
+    long long size;
+    long long inode;       /* Changes when a new file is renamed over it */
+} FileVersion;
+
+/* A cached dictionary and the version of the file it came from. Callers
+ * hold their own references, so an entry evicted or reloaded while they
+ * segment stays alive until they release it. */
+typedef struct {
+    newmm_dict_t dict;     /* The cache's reference */
+    char* dict_path;       /* NULL for the default dictionary */
+    FileVersion version;
+} CachedDict;
+
+static CachedDict dict_cache[DICT_CACHE_SIZE];
+static int dict_cache_count = 0;
+static thread_mutex_t dict_cache_lock = THREAD_MUTEX_INITIALIZER;
+
+/* Version of dict_path; a change to any field makes the cached copy
+ * stale. Whole seconds would miss a same-size rewrite within one second,
+ * so the nanoseconds are kept where stat() reports them. */
+static FileVersion dict_file_version(const char* dict_path) {
+    FileVersion version = {-1, -1, -1};
+    struct stat st;
+    if (!dict_path || stat(dict_path, &st) != 0) return version;
+    
+    long long nsec = 0;
+#if defined(__APPLE__)
+    nsec = (long long)st.st_mtimespec.tv_nsec;
+#elif defined(st_mtime)
+    /* st_mtime is a macro for st_mtim.tv_sec where st_mtim exists */
+    nsec = (long long)st.st_mtim.tv_nsec;
+#endif
+    version.mtime_ns = (long long)st.st_mtime * 1000000000LL + nsec;
+    version.size = (long long)st.st_size;
+    version.inode = (long long)st.st_ino;
+    return version;
+}
+
+static bool file_version_equal(const FileVersion* a, const FileVersion* b) {
+    return a->mtime_ns == b->mtime_ns && a->size == b->size && a->inode == b->inode;
+}
+
+/* Check whether entry was loaded from dict_path (NULL = default) */
+static bool cached_dict_matches(const CachedDict* entry, const char* dict_path) {
+    if (!entry->dict_path || !dict_path) return entry->dict_path == dict_path;
+    return strcmp(entry->dict_path, dict_path) == 0;
+}
+
+/* Drop entry i; caller holds dict_cache_lock */
+static void cached_dict_remove(int i) {
+    newmm_dict_release(dict_cache[i].dict);
+    free(dict_cache[i].dict_path);
+    memmove(dict_cache + i, dict_cache + i + 1, (dict_cache_count - i - 1) * sizeof(CachedDict));
+    dict_cache_count--;
+}
+
+/* Move entry i to the front and return a new reference to it; caller
+ * holds dict_cache_lock */
+static newmm_dict_t cached_dict_take(int i) {
+    CachedDict entry = dict_cache[i];
+    memmove(dict_cache + 1, dict_cache, i * sizeof(CachedDict));
+    dict_cache[0] = entry;
+    return newmm_dict_retain(entry.dict);
+}
+
+/* Find the entry for dict_path, dropping it if the file changed since it
+ * was loaded. Returns its index, or -1. Caller holds dict_cache_lock. */
+static int cached_dict_find(const char* dict_path, const FileVersion* version) {
+    for (int i = 0; i < dict_cache_count; i++) {
+        if (!cached_dict_matches(&dict_cache[i], dict_path)) continue;
+        
+        if (file_version_equal(&dict_cache[i].version, version)) return i;
+        cached_dict_remove(i);
+        return -1;
+    }
+    return -1;
+}
+
+newmm_dict_t newmm_dict_cache_get(const char* dict_path) {
+    FileVersion version = dict_file_version(dict_path);
+    
+    thread_mutex_lock(&dict_cache_lock);
+    int i = cached_dict_find(dict_path, &version);
+    if (i >= 0) {
+        newmm_dict_t dict = cached_dict_take(i);
+        thread_mutex_unlock(&dict_cache_lock);
+        return dict;
+    }
+    thread_mutex_unlock(&dict_cache_lock);
+    
+    /* Load unlocked so callers of other cached dictionaries never wait */
+    char* path_copy = NULL;
+    if (dict_path) {
+        path_copy = (char*)malloc(strlen(dict_path) + 1);
+        if (!path_copy) return NULL;
+        strcpy(path_copy, dict_path);
+    }
+    newmm_dict_t loaded = newmm_load_dict(dict_path);
+    if (!loaded) {
+        free(path_copy);
+        return NULL;
+    }
+    
+    thread_mutex_lock(&dict_cache_lock);
+    i = cached_dict_find(dict_path, &version);
+    if (i >= 0) {
+        /* Another thread loaded the same file first */
+        newmm_free_dict(loaded);
+        free(path_copy);
+    } else {
+        if (dict_cache_count == DICT_CACHE_SIZE) cached_dict_remove(DICT_CACHE_SIZE - 1);
+        i = dict_cache_count++;
+        dict_cache[i].dict = loaded;
+        dict_cache[i].dict_path = path_copy;
+        dict_cache[i].version = version;
+    }
+    newmm_dict_t dict = cached_dict_take(i);
+    thread_mutex_unlock(&dict_cache_lock);
+    return dict;
+}
+
+void newmm_clear_dict_cache(void) {
+    thread_mutex_lock(&dict_cache_lock);
+    while (dict_cache_count > 0) cached_dict_remove(dict_cache_count - 1);
+    thread_mutex_unlock(&dict_cache_lock);
+}
@@ -5,24 +5,55 @@
 
 #include "../include/newmm.h"
 #include "trie.h"
+#include "datrie.h"
+#include "segment.h"
+#include "stats.h"
 #include "tcc.h"
+#include "arena.h"
+#include "utf8.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <ctype.h>
 
+/* Edges after which each graph position keeps only its shortest word */
 #define MAX_GRAPH_SIZE 50
-#define MAX_TOKENS 10000
+#define GRAPH_MAX_EDGES (2 * MAX_GRAPH_SIZE)
+#define FRONTIER_SIZE (MAX_GRAPH_SIZE + 2)
 
-/* Graph structure for BFS */
+/* Word graph of the ambiguous stretch being resolved; edge i is a
+ * dictionary word spanning [from[i], to[i]) with payload id[i] */
 typedef struct {
-    int* edges;
-    int* edge_counts;
-    int* capacities;
+    int from[GRAPH_MAX_EDGES];
+    int to[GRAPH_MAX_EDGES];
+    uint32_t id[GRAPH_MAX_EDGES];
     int size;
 } Graph;
 
+/* Bytes of text the weighted engine keeps open at once, and the costs
+ * of its lattice edges in 1/256 bits */
+#define VITERBI_WINDOW 1024
+#define VITERBI_TOKEN_COST 256
+#define VITERBI_UNKNOWN_PENALTY (16 * 256)
+#define VITERBI_INF INT32_MAX
+
+/* Kinds of weighted lattice edges */
+enum { EDGE_WORD, EDGE_RUN, EDGE_UNKNOWN };
+
+/* Best reading of the positions since the last settled one: position
+ * cut + i is reached at cost[i] by an edge of kind[i] and payload id[i]
+ * from cut + back[i]. Only the entries up to the furthest edge end are
+ * valid. */
+typedef struct {
+    int32_t cost[VITERBI_WINDOW + 1];
+    int32_t back[VITERBI_WINDOW + 1];
+    uint32_t id[VITERBI_WINDOW + 1];
+    uint8_t kind[VITERBI_WINDOW + 1];
+    bool open_unknown;   /* The last token emitted is an unknown word */
+} Lattice;
+
 /* Helper: Check if character is non-Thai */
 static bool is_non_thai_char(int codepoint) {
     /* Latin letters, digits, spaces */
@@ -41,35 +72,6 @@ static bool is_non_thai_char(int codepoint) {
     return true;
 }
 
-/* UTF-8 helper */
-static int utf8_char_len(unsigned char c) {
-    if ((c & 0x80) == 0) return 1;
-    if ((c & 0xE0) == 0xC0) return 2;
-    if ((c & 0xF0) == 0xE0) return 3;
-    if ((c & 0xF8) == 0xF0) return 4;
-    return 1;
-}
-
-static int get_utf8_codepoint(const char* str, int* byte_len) {
-    unsigned char c = (unsigned char)str[0];
-    int len = utf8_char_len(c);
-    int codepoint = 0;
-    
-    if (len == 1) {
-        codepoint = c;
-    } else if (len == 2) {
-        codepoint = ((c & 0x1F) << 6) | (str[1] & 0x3F);
-    } else if (len == 3) {
-        codepoint = ((c & 0x0F) << 12) | ((str[1] & 0x3F) << 6) | (str[2] & 0x3F);
-    } else if (len == 4) {
-        codepoint = ((c & 0x07) << 18) | ((str[1] & 0x3F) << 12) | 
-                    ((str[2] & 0x3F) << 6) | (str[3] & 0x3F);
-    }
-    
-    *byte_len = len;
-    return codepoint;
-}
-
 /* Helper: Extract substring */
 static char* substring(const char* text, int start, int end) {
     int len = end - start;
@@ -81,37 +83,244 @@ static char* substring(const char* text, int start, int end) {
     return result;
 }
 
-/* Simplified newmm segmentation */
-static int segment_text(const char* text, Trie* trie, char*** tokens) {
-    int text_len = strlen(text);
-    if (text_len == 0) return 0;
+/* Kinds of ASCII characters that group into runs */
+enum { RUN_OTHER, RUN_SPACE, RUN_ALPHA, RUN_DIGIT };
+
+/* Kind of byte c; bytes of multi-byte characters are RUN_OTHER */
+static inline int ascii_run_kind(unsigned char c) {
+    if ((unsigned)((c | 0x20) - 'a') < 26) return RUN_ALPHA;
+    if ((unsigned)(c - '0') < 10) return RUN_DIGIT;
+    if (c == ' ' || c == '\t') return RUN_SPACE;
+    return RUN_OTHER;
+}
+
+/* End of the run starting at the ASCII character at pos, scanned a byte
+ * at a time: strict decoding only yields an ASCII codepoint from an
+ * ASCII byte, so no decoding is needed */
+static int ascii_run_end(const unsigned char* s, int text_len, int pos) {
+    int kind = ascii_run_kind(s[pos]);
+    int end = pos + 1;
     
-    /* Get valid TCC positions */
-    int* valid_pos;
-    int num_valid = tcc_pos(text, &valid_pos);
-    if (num_valid == 0) {
-        free(valid_pos);
-        return 0;
+    if (kind == RUN_OTHER) {
+        /* Same punctuation character - group together */
+        while (end < text_len && s[end] == s[pos]) end++;
+    } else if (kind == RUN_DIGIT) {
+        /* Digits, with a '.' or ',' only between two of them */
+        while (end < text_len) {
+            if (ascii_run_kind(s[end]) == RUN_DIGIT) {
+                end++;
+            } else if ((s[end] == '.' || s[end] == ',') && end + 1 < text_len &&
+                       ascii_run_kind(s[end + 1]) == RUN_DIGIT) {
+                end += 2;
+            } else {
+                break;
+            }
+        }
+    } else {
+        while (end < text_len && ascii_run_kind(s[end]) == kind) end++;
     }
+    return end;
+}
+
+/* End of the non-Thai token starting at pos: a run of spaces, Latin
+ * letters or digits (with the separators of a number), or a repeated
+ * punctuation character. Returns -1 if pos starts a Thai character. */
+static int non_thai_end(const char* text, int text_len, int pos) {
+    const unsigned char* s = (const unsigned char*)text;
+    if (s[pos] < 0x80) return ascii_run_end(s, text_len, pos);
+    
+    int byte_len;
+    int cp = utf8_decode_n(text + pos, text_len - pos, &byte_len);
+    if (!is_non_thai_char(cp)) return -1;
     
-    /* Allocate token array */
-    *tokens = (char**)malloc(MAX_TOKENS * sizeof(char*));
-    if (!*tokens) {
-        free(valid_pos);
-        return 0;
+    /* Other characters only group with repeats of themselves */
+    int end = pos + byte_len;
+    while (end < text_len) {
+        int next_cp = utf8_decode_n(text + end, text_len - end, &byte_len);
+        if (next_cp != cp) break;
+        end += byte_len;
     }
     
-    int token_count = 0;
+    return end;
+}
+
+/* Statistics of one segmentation pass, added to the thread's counters
+ * once at the end */
+typedef struct {
+    newmm_stats_t counts;
+    bool timed;
+    uint64_t clock;
+    int first_token;
+} PassStats;
+
+/* Start a pass: mark the TCC boundaries of text in a bitmap taken from
+ * scratch, or from the heap without one; release with end_pass() */
+static uint64_t* begin_pass(PassStats* pass, const char* text, int text_len, Arena* scratch,
+                            const SpanBuffer* out) {
+    memset(&pass->counts, 0, sizeof(pass->counts));
+    pass->timed = stats_enabled();
+    pass->clock = pass->timed ? stats_now_ns() : 0;
+    pass->first_token = out->count;
+    
+    size_t size = TCC_BITMAP_WORDS(text_len) * sizeof(uint64_t);
+    uint64_t* boundaries = scratch ? (uint64_t*)arena_alloc(scratch, size) : (uint64_t*)malloc(size);
+    if (!boundaries) return NULL;
+    
+    pass->counts.tcc_clusters = (uint64_t)tcc_boundaries_into(text, text_len, boundaries);
+    pass->counts.bytes_allocated = size;
+    if (pass->timed) {
+        uint64_t now = stats_now_ns();
+        pass->counts.tcc_ns = now - pass->clock;
+        pass->clock = now;
+    }
+    return boundaries;
+}
+
+static void end_pass(PassStats* pass, uint64_t* boundaries, int text_len, Arena* scratch,
+                     const SpanBuffer* out) {
+    if (!scratch) free(boundaries);
+    
+    pass->counts.calls = 1;
+    pass->counts.bytes = (uint64_t)text_len;
+    pass->counts.tokens = (uint64_t)(out->count - pass->first_token);
+    if (pass->timed) pass->counts.match_ns = stats_now_ns() - pass->clock;
+    stats_add(&pass->counts);
+}
+
+/* Keep only the prefix lengths, and their payloads if values is not
+ * NULL, that end on a TCC boundary */
+static int filter_prefix_ends(const uint64_t* boundaries, int pos, int* lengths, uint32_t* values,
+                              int count) {
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        if (tcc_is_boundary(boundaries, pos + lengths[i])) {
+            if (values) values[kept] = values[i];
+            lengths[kept++] = lengths[i];
+        }
+    }
+    return kept;
+}
+
+/* Dictionary words found at recently visited positions, so that each
+ * offset is looked up in the trie once per call. Positions asked about
+ * only move forward and lie within a word of the current token start,
+ * so a slot is only reused for a position still needed when words are
+ * MEMO_SLOTS bytes long; it is then looked up again. */
+#define MEMO_SLOTS 64
+
+typedef struct {
+    const char* text;
+    int text_len;
+    const DATrie* trie;
+    const uint64_t* boundaries;
+    bool with_values;          /* Payloads are kept for word IDs */
+    int pos[MEMO_SLOTS];       /* Position held by each slot, or -1 */
+    int count[MEMO_SLOTS];
+    int lengths[MEMO_SLOTS][TRIE_MAX_PREFIXES];
+    uint32_t values[MEMO_SLOTS][TRIE_MAX_PREFIXES];
+} PrefixMemo;
+
+static void memo_init(PrefixMemo* memo, const char* text, int text_len, const DATrie* trie,
+                      const uint64_t* boundaries, bool with_values) {
+    memo->text = text;
+    memo->text_len = text_len;
+    memo->trie = trie;
+    memo->boundaries = boundaries;
+    memo->with_values = with_values;
+    for (int i = 0; i < MEMO_SLOTS; i++) {
+        memo->pos[i] = -1;
+    }
+}
+
+/* Get the lengths of the dictionary words ending on a TCC boundary that
+ * start at pos, valid until the next lookup of a position in the same
+ * slot. Sets *count to their number and, if values is not NULL, *values
+ * to their payloads, which are only kept when the memo has with_values. */
+static const int* memo_prefix_ends(PrefixMemo* memo, int pos, newmm_stats_t* counts, int* count,
+                                   const uint32_t** values) {
+    int slot = pos & (MEMO_SLOTS - 1);
+    if (memo->pos[slot] == pos) {
+        counts->memo_hits++;
+    } else {
+        int n;
+        if (memo->with_values) {
+            n = datrie_prefix_values(memo->trie, memo->text + pos, memo->text_len - pos,
+                                     memo->lengths[slot], memo->values[slot], TRIE_MAX_PREFIXES);
+        } else {
+            n = datrie_prefix_ends(memo->trie, memo->text + pos, memo->text_len - pos,
+                                   memo->lengths[slot], TRIE_MAX_PREFIXES);
+        }
+        memo->count[slot] = filter_prefix_ends(memo->boundaries, pos, memo->lengths[slot],
+                                               memo->with_values ? memo->values[slot] : NULL, n);
+        memo->pos[slot] = pos;
+    }
+    *count = memo->count[slot];
+    if (values) *values = memo->values[slot];
+    return memo->lengths[slot];
+}
+
+/* Check whether pos holds an ASCII character no word contains, so no
+ * word starts there and the lookup can be skipped */
+static inline bool skips_lookup(const PrefixMemo* memo, int pos) {
+    unsigned char c = (unsigned char)memo->text[pos];
+    return c < 0x80 && !datrie_uses_ascii(memo->trie, c);
+}
+
+/* Check whether a dictionary word ending on a TCC boundary starts at pos */
+static bool has_word_at(PrefixMemo* memo, int pos, newmm_stats_t* counts) {
+    if (skips_lookup(memo, pos)) return false;
+    
+    int count;
+    counts->lookahead_queries++;
+    memo_prefix_ends(memo, pos, counts, &count, NULL);
+    return count > 0;
+}
+
+/* Simplified newmm segmentation
+ * 
+ * Appends token boundaries as [start, end) byte offsets into text to out.
+ * Dictionary words only match when they end on a TCC boundary, so every
+ * token boundary is a TCC boundary.
+ * Returns the number of tokens, or -1 on allocation failure. */
+int segment_text(const char* text, int text_len, const DATrie* trie, Arena* scratch,
+                 SpanBuffer* out) {
+    if (text_len <= 0) return out->count;
+    
+    /* Get valid TCC boundaries */
+    PassStats pass;
+    uint64_t* boundaries = begin_pass(&pass, text, text_len, scratch, out);
+    if (!boundaries) return -1;
+    
+    PrefixMemo memo;
+    memo_init(&memo, text, text_len, trie, boundaries, out->ids != NULL);
+    
     int pos = 0;
+    bool ok = true;
     
-    while (pos < text_len) {
-        /* Try to find longest matching word from dictionary */
-        char** prefixes;
-        int* lengths;
-        int num_prefixes = trie_prefixes(trie, text + pos, &prefixes, &lengths);
+    while (pos < text_len && ok) {
+        /* Latin letters, digits, spaces and punctuation that no word
+         * starts with make their token without a lookup */
+        if (skips_lookup(&memo, pos)) {
+            int end = ascii_run_end((const unsigned char*)text, text_len, pos);
+            ok = span_push(out, pos, end, NEWMM_UNKNOWN_ID);
+            pos = end;
+            continue;
+        }
+        
+        /* Try to find longest matching word from dictionary; copied, as
+         * the lookahead below may reuse its memo slot */
+        int lengths[TRIE_MAX_PREFIXES];
+        uint32_t values[TRIE_MAX_PREFIXES];
+        int num_prefixes;
+        const uint32_t* found_values;
+        const int* found = memo_prefix_ends(&memo, pos, &pass.counts, &num_prefixes, &found_values);
+        memcpy(lengths, found, num_prefixes * sizeof(int));
+        if (memo.with_values) memcpy(values, found_values, num_prefixes * sizeof(uint32_t));
+        pass.counts.prefix_queries++;
         
         int best_len = 0;
         int best_end_pos = pos;
+        int best = -1;
         
         /* Simple greedy: find longest match */
         /* But prefer shorter match if longer one leaves us with unknown Thai character */
@@ -121,226 +330,584 @@ static int segment_text(const char* text, Trie* trie, char*** tokens) {
             if (lengths[i] > best_len) {
                 best_len = lengths[i];
                 best_end_pos = end_pos;
+                best = i;
             }
         }
         
         /* Now check if a shorter match would be better */
         /* Only if the best match leads to an unknown Thai character */
         /* and a shorter match leads to a known word */
-        if (best_len > 0 && best_end_pos < text_len) {
-            char** best_next_prefixes;
-            int* best_next_lengths;
-            int num_best_next = trie_prefixes(trie, text + best_end_pos, &best_next_prefixes, &best_next_lengths);
+        if (best_len > 0 && best_end_pos < text_len &&
+            !has_word_at(&memo, best_end_pos, &pass.counts)) {
+            /* Best match doesn't lead to a dictionary word */
+            /* Check if it's a Thai character (not Latin/digit) */
+            int byte_len;
+            int next_cp = utf8_decode_n(text + best_end_pos, text_len - best_end_pos, &byte_len);
             
-            if (num_best_next == 0) {
-                /* Best match doesn't lead to a dictionary word */
-                /* Check if it's a Thai character (not Latin/digit) */
-                int byte_len;
-                int next_cp = get_utf8_codepoint(text + best_end_pos, &byte_len);
-                
-                if (!is_non_thai_char(next_cp)) {
-                    /* It's a Thai character that's not in dictionary */
-                    /* Try shorter matches to see if they lead to dictionary words */
-                    for (int i = 0; i < num_prefixes; i++) {
-                        int end_pos = pos + lengths[i];
-                        if (lengths[i] < best_len && end_pos < text_len) {
-                            char** next_prefixes;
-                            int* next_lengths;
-                            int num_next = trie_prefixes(trie, text + end_pos, &next_prefixes, &next_lengths);
-                            
-                            if (num_next > 0) {
-                                /* This shorter match leads to a dictionary word */
-                                /* Prefer it */
-                                best_len = lengths[i];
-                                best_end_pos = end_pos;
-                            }
-                            
-                            /* Free lookahead results */
-                            for (int j = 0; j < num_next; j++) {
-                                free(next_prefixes[j]);
-                            }
-                            free(next_prefixes);
-                            free(next_lengths);
-                            
-                            if (num_next > 0) {
-                                /* We found a better match, stop looking */
-                                break;
-                            }
-                        }
+            if (!is_non_thai_char(next_cp)) {
+                /* It's a Thai character that's not in dictionary */
+                /* Try shorter matches to see if they lead to dictionary words */
+                for (int i = 0; i < num_prefixes; i++) {
+                    int end_pos = pos + lengths[i];
+                    if (lengths[i] < best_len && end_pos < text_len &&
+                        has_word_at(&memo, end_pos, &pass.counts)) {
+                        /* This shorter match leads to a dictionary word */
+                        /* Prefer it, and stop looking */
+                        best_len = lengths[i];
+                        best_end_pos = end_pos;
+                        best = i;
+                        break;
                     }
                 }
             }
-            
-            /* Free lookahead results */
-            for (int j = 0; j < num_best_next; j++) {
-                free(best_next_prefixes[j]);
-            }
-            free(best_next_prefixes);
-            free(best_next_lengths);
         }
         
-        /* Free prefix results */
-        for (int i = 0; i < num_prefixes; i++) {
-            free(prefixes[i]);
-        }
-        free(prefixes);
-        free(lengths);
-        
         /* If found a dictionary word, use it */
         if (best_len > 0) {
-            (*tokens)[token_count++] = substring(text, pos, best_end_pos);
+            ok = span_push(out, pos, best_end_pos,
+                           memo.with_values ? values[best] : NEWMM_UNKNOWN_ID);
             pos = best_end_pos;
         } else {
             /* Handle non-dictionary word */
             /* Check if it's a non-Thai sequence */
-            int byte_len;
-            int cp = get_utf8_codepoint(text + pos, &byte_len);
+            int end = non_thai_end(text, text_len, pos);
             
-            if (is_non_thai_char(cp)) {
-                /* Skip all consecutive non-Thai characters of same type */
-                int end = pos + byte_len;
-                bool is_space = (cp == ' ' || cp == '\t');
-                bool is_alpha = ((cp >= 'a' && cp <= 'z') || (cp >= 'A' && cp <= 'Z'));
-                bool is_digit = (cp >= '0' && cp <= '9');
-                bool is_punctuation = !is_space && !is_alpha && !is_digit;
-                
-                while (end < text_len) {
-                    int next_cp = get_utf8_codepoint(text + end, &byte_len);
-                    bool match = false;
-                    
-                    if (is_space && (next_cp == ' ' || next_cp == '\t')) match = true;
-                    else if (is_alpha && ((next_cp >= 'a' && next_cp <= 'z') || (next_cp >= 'A' && next_cp <= 'Z'))) match = true;
-                    else if (is_digit && (next_cp >= '0' && next_cp <= '9')) {
-                        match = true;
-                    } else if (is_digit && (next_cp == '.' || next_cp == ',')) {
-                        /* Check if this is a valid numeric pattern */
-                        int temp_end = end + byte_len;
-                        /* Look ahead to see if followed by digit */
-                        if (temp_end < text_len) {
-                            int lookahead_len;
-                            int lookahead_cp = get_utf8_codepoint(text + temp_end, &lookahead_len);
-                            if (lookahead_cp >= '0' && lookahead_cp <= '9') {
-                                /* Followed by digit, it's part of number */
-                                match = true;
-                            } else if (lookahead_cp == '.' || lookahead_cp == ',') {
-                                /* Multiple punctuation - stop here */
-                                match = false;
-                            } else {
-                                /* Followed by non-digit - stop before the punctuation */
-                                match = false;
-                            }
-                        } else {
-                            /* At end of text - punctuation is separate */
-                            match = false;
-                        }
-                    } else if (is_punctuation && next_cp == cp) {
-                        /* Same punctuation character - group together */
-                        match = true;
-                    }
-                    
-                    if (!match) break;
-                    end += byte_len;
-                }
-                
-                (*tokens)[token_count++] = substring(text, pos, end);
+            if (end >= 0) {
+                ok = span_push(out, pos, end, NEWMM_UNKNOWN_ID);
                 pos = end;
             } else {
                 /* Thai character not in dictionary - advance to next TCC boundary */
-                /* Find next valid TCC boundary after current position */
-                int next_pos = text_len; /* Default to end of text */
-                for (int i = 0; i < num_valid; i++) {
-                    if (valid_pos[i] > pos) {
-                        next_pos = valid_pos[i];
+                int next_pos = tcc_next_boundary(boundaries, text_len, pos);
+                pass.counts.unknown_words++;
+                
+                ok = span_push(out, pos, next_pos, NEWMM_UNKNOWN_ID);
+                pos = next_pos;
+            }
+        }
+    }
+    
+    end_pass(&pass, boundaries, text_len, scratch, out);
+    return ok ? out->count : -1;
+}
+
+/* Check whether a word of len bytes at text is at most two Thai
+ * consonants, too short to mark the end of an unknown word */
+static bool is_short_consonant_word(const char* text, int len) {
+    if (len > 6) return false;
+    
+    const char* ptr = text;
+    const char* end = text + len;
+    while (ptr < end) {
+        int byte_len;
+        int cp = utf8_decode_n(ptr, end - ptr, &byte_len);
+        if (cp < 0x0E01 || cp > 0x0E2E) return false;
+        ptr += byte_len;
+    }
+    return true;
+}
+
+/* Emit the shortest path (fewest tokens) from start to goal through the
+ * word graph, preferring edges in insertion order among equal paths */
+static bool emit_graph_path(const Graph* graph, int start, int goal, SpanBuffer* out) {
+    int nodes[GRAPH_MAX_EDGES + 1];
+    int parents[GRAPH_MAX_EDGES + 1];
+    int edges[GRAPH_MAX_EDGES + 1];   /* Edge each node was reached by */
+    int num_nodes = 1;
+    int found = -1;
+    nodes[0] = start;
+    parents[0] = -1;
+    
+    for (int head = 0; head < num_nodes && found < 0; head++) {
+        for (int e = 0; e < graph->size && found < 0; e++) {
+            if (graph->from[e] != nodes[head]) continue;
+            
+            int to = graph->to[e];
+            int seen = 0;
+            while (seen < num_nodes && nodes[seen] != to) seen++;
+            if (seen < num_nodes) continue;
+            
+            nodes[num_nodes] = to;
+            parents[num_nodes] = head;
+            edges[num_nodes] = e;
+            if (to == goal) found = num_nodes;
+            num_nodes++;
+        }
+    }
+    
+    /* Every frontier position is reachable; keep going if not */
+    if (found < 0) return span_push(out, start, goal, NEWMM_UNKNOWN_ID);
+    
+    int path[GRAPH_MAX_EDGES + 1];
+    int length = 0;
+    for (int node = found; node > 0; node = parents[node]) {
+        path[length++] = edges[node];
+    }
+    
+    bool ok = true;
+    for (int i = length - 1; i >= 0 && ok; i--) {
+        int e = path[i];
+        ok = span_push(out, graph->from[e], graph->to[e], graph->id[e]);
+    }
+    return ok;
+}
+
+/* Add pos to a frontier kept in descending order, so the smallest
+ * position is popped from the end. Returns false if it is full. */
+static bool frontier_push(int* frontier, int* size, int pos) {
+    int i = *size;
+    while (i > 0 && frontier[i - 1] <= pos) {
+        if (frontier[i - 1] == pos) return true;
+        i--;
+    }
+    if (*size >= FRONTIER_SIZE) return false;
+    
+    memmove(frontier + i + 1, frontier + i, (*size - i) * sizeof(int));
+    frontier[i] = pos;
+    (*size)++;
+    return true;
+}
+
+/* newmm graph segmentation, following PyThaiNLP's newmm
+ * 
+ * Positions are visited in increasing order. The dictionary words
+ * starting at each one (ending on TCC boundaries) become edges of a word
+ * graph, and their ends join the frontier of open positions. Once the
+ * frontier narrows to a single position every reading agrees on, the
+ * path with the fewest tokens up to it is emitted and the graph is
+ * cleared. A position with no words is an unknown word, which extends
+ * to the next non-Thai character or the next position where a word of
+ * more than two consonants starts.
+ * 
+ * Each position is looked up once, through the prefix memo. The graph
+ * and frontier live on the stack; if an ambiguous stretch outgrows them,
+ * the path to the nearest open position is emitted early. Returns the span count, or -1. */
+int segment_text_graph(const char* text, int text_len, const DATrie* trie, Arena* scratch,
+                       SpanBuffer* out) {
+    if (text_len <= 0) return out->count;
+    
+    PassStats pass;
+    uint64_t* boundaries = begin_pass(&pass, text, text_len, scratch, out);
+    if (!boundaries) return -1;
+    
+    Graph graph;
+    graph.size = 0;
+    int frontier[FRONTIER_SIZE];
+    int frontier_size = 1;
+    frontier[0] = 0;
+    
+    /* Words found while extending an unknown word are reused when the
+     * position they start at is visited */
+    PrefixMemo memo;
+    memo_init(&memo, text, text_len, trie, boundaries, out->ids != NULL);
+    
+    int end_pos = 0;
+    bool ok = true;
+    
+    while (ok && frontier_size > 0 && frontier[frontier_size - 1] < text_len) {
+        int begin = frontier[--frontier_size];
+        
+        int count = 0;
+        const int* lengths = NULL;
+        const uint32_t* values = NULL;
+        if (!skips_lookup(&memo, begin)) {
+            lengths = memo_prefix_ends(&memo, begin, &pass.counts, &count, &values);
+            pass.counts.prefix_queries++;
+        }
+        
+        bool full = false;
+        for (int i = 0; i < count; i++) {
+            if (graph.size >= GRAPH_MAX_EDGES ||
+                !frontier_push(frontier, &frontier_size, begin + lengths[i])) {
+                full = true;
+                break;
+            }
+            graph.from[graph.size] = begin;
+            graph.to[graph.size] = begin + lengths[i];
+            graph.id[graph.size] = memo.with_values ? values[i] : NEWMM_UNKNOWN_ID;
+            graph.size++;
+            if (graph.size > MAX_GRAPH_SIZE) break;
+        }
+        
+        if (frontier_size == 1 || (full && frontier_size > 0)) {
+            /* No longer ambiguous, or out of room: settle up to the
+             * nearest open position */
+            int goal = frontier[frontier_size - 1];
+            ok = emit_graph_path(&graph, end_pos, goal, out);
+            frontier[0] = goal;
+            frontier_size = 1;
+            end_pos = goal;
+            graph.size = 0;
+        } else if (frontier_size == 0) {
+            /* Unknown word */
+            int end = non_thai_end(text, text_len, begin);
+            if (end < 0) {
+                end = text_len;
+                pass.counts.unknown_words++;
+                for (int pos = begin + 1; pos < text_len; pos++) {
+                    if (!tcc_is_boundary(boundaries, pos)) continue;
+                    if (skips_lookup(&memo, pos)) {
+                        /* Starts a non-Thai run */
+                        end = pos;
+                        break;
+                    }
+                    
+                    int n;
+                    const int* words = memo_prefix_ends(&memo, pos, &pass.counts, &n, NULL);
+                    pass.counts.lookahead_queries++;
+                    
+                    bool word = false;
+                    for (int i = 0; i < n && !word; i++) {
+                        word = !is_short_consonant_word(text + pos, words[i]);
+                    }
+                    if (word || non_thai_end(text, text_len, pos) >= 0) {
+                        end = pos;
                         break;
                     }
                 }
+            }
+            
+            ok = span_push(out, begin, end, NEWMM_UNKNOWN_ID);
+            frontier[0] = end;
+            frontier_size = 1;
+            end_pos = end;
+            graph.size = 0;
+        }
+    }
+    
+    end_pass(&pass, boundaries, text_len, scratch, out);
+    return ok ? out->count : -1;
+}
+
+/* log2(x) in 1/256 bits, with the fraction interpolated linearly; exact
+ * at powers of two and the same on every platform */
+static int32_t log2_fixed(uint64_t x) {
+    int msb = 0;
+    for (int shift = 32; shift > 0; shift >>= 1) {
+        if (x >> (msb + shift)) msb += shift;
+    }
+    uint64_t frac = msb >= 8 ? x >> (msb - 8) : x << (8 - msb);
+    return (int32_t)(msb * 256 + (frac & 0xFF));
+}
+
+/* Emit the best path from the cut to position cut + rel, then make that
+ * position the new cut. Unknown TCCs in a row make one unknown word. */
+static bool lattice_settle(Lattice* lattice, int* cut, int rel, int* reach,
+                           newmm_stats_t* counts, SpanBuffer* out) {
+    int path[VITERBI_WINDOW + 1];
+    int length = 0;
+    for (int i = rel; i > 0; i = lattice->back[i]) {
+        path[length++] = i;
+    }
+    
+    bool ok = true;
+    for (int i = length - 1; i >= 0 && ok; i--) {
+        int to = path[i];
+        bool unknown = lattice->kind[to] == EDGE_UNKNOWN;
+        if (unknown && lattice->open_unknown) {
+            /* Past capacity only the count is kept, and it is unchanged */
+            if (out->count <= out->capacity) out->ends[out->count - 1] = *cut + to;
+        } else {
+            if (unknown) counts->unknown_words++;
+            ok = span_push(out, *cut + lattice->back[to], *cut + to, lattice->id[to]);
+        }
+        lattice->open_unknown = unknown;
+    }
+    
+    *cut += rel;
+    *reach = 0;
+    return ok;
+}
+
+/* Frequency-weighted segmentation
+ * 
+ * The lattice nodes are the positions between tokens; its edges are the
+ * dictionary words ending on TCC boundaries, the non-Thai runs, and,
+ * where no word starts, one TCC as an unknown word. A single Viterbi
+ * pass finds the reading of least total cost, and unknown TCCs in a row
+ * are joined into one token. With explicit payloads a
+ * word costs -log2 of its share of all payloads, so readings made of
+ * frequent words win; otherwise every word costs the same and the
+ * reading with the fewest tokens wins. Unknown TCCs cost more than any
+ * word, and ties go to the reading whose last token is longest.
+ * 
+ * Costs live on the stack in a window of VITERBI_WINDOW bytes. A
+ * position no edge crosses is settled as soon as it is reached; if an
+ * edge would leave the window, the best path to the current position is
+ * settled instead. Words longer than the window are ignored, and runs
+ * longer than it are emitted whole. Returns the span count, or -1. */
+int segment_text_weighted(const char* text, int text_len, const DATrie* trie, Arena* scratch,
+                          SpanBuffer* out) {
+    if (text_len <= 0) return out->count;
+    
+    PassStats pass;
+    uint64_t* boundaries = begin_pass(&pass, text, text_len, scratch, out);
+    if (!boundaries) return -1;
+    
+    PrefixMemo memo;
+    memo_init(&memo, text, text_len, trie, boundaries, false);
+    
+    /* A token of frequency f costs log2(total) - log2(f + 1) */
+    int32_t token_cost = trie->has_values ? log2_fixed(trie->value_total + 1)
+                                          : VITERBI_TOKEN_COST;
+    int32_t unknown_cost = token_cost + VITERBI_UNKNOWN_PENALTY;
+    
+    Lattice lattice_storage;
+    Lattice* lattice = &lattice_storage;
+    lattice->cost[0] = 0;
+    lattice->open_unknown = false;
+    
+    int cut = 0;     /* Every reading goes through this position */
+    int reach = 0;   /* Furthest edge end, relative to cut */
+    bool ok = true;
+    
+    for (int rel = 0; ok && cut + rel < text_len; rel++) {
+        if (rel > 0 && lattice->cost[rel] == VITERBI_INF) continue;
+        if (rel > 0 && rel == reach) {
+            /* Nothing crosses this position: settle it */
+            ok = lattice_settle(lattice, &cut, rel, &reach, &pass.counts, out);
+            rel = 0;
+        }
+        
+        int pos = cut + rel;
+        int ends[TRIE_MAX_PREFIXES];
+        int32_t costs[TRIE_MAX_PREFIXES];
+        uint32_t ids[TRIE_MAX_PREFIXES];
+        int kind = EDGE_WORD;
+        int count = 0;
+        
+        if (skips_lookup(&memo, pos)) {
+            ends[count] = ascii_run_end((const unsigned char*)text, text_len, pos);
+            ids[count] = NEWMM_UNKNOWN_ID;
+            costs[count++] = token_cost;
+            kind = EDGE_RUN;
+        } else {
+            /* Each position is looked up once, so the memo is not used */
+            int lengths[TRIE_MAX_PREFIXES];
+            uint32_t values[TRIE_MAX_PREFIXES];
+            int n = datrie_prefix_values(trie, text + pos, text_len - pos, lengths, values,
+                                         TRIE_MAX_PREFIXES);
+            pass.counts.prefix_queries++;
+            for (int i = 0; i < n; i++) {
+                if (lengths[i] > VITERBI_WINDOW ||
+                    !tcc_is_boundary(boundaries, pos + lengths[i])) continue;
                 
-                (*tokens)[token_count++] = substring(text, pos, next_pos);
-                pos = next_pos;
+                int32_t cost = token_cost;
+                if (trie->has_values) {
+                    cost -= log2_fixed((uint64_t)values[i] + 1);
+                    if (cost < 1) cost = 1;
+                }
+                ends[count] = pos + lengths[i];
+                ids[count] = values[i];
+                costs[count++] = cost;
+            }
+            if (count == 0) {
+                int end = non_thai_end(text, text_len, pos);
+                kind = end >= 0 ? EDGE_RUN : EDGE_UNKNOWN;
+                ends[count] = end >= 0 ? end : tcc_next_boundary(boundaries, text_len, pos);
+                ids[count] = NEWMM_UNKNOWN_ID;
+                costs[count++] = end >= 0 ? token_cost : unknown_cost;
             }
         }
         
-        if (token_count >= MAX_TOKENS - 1) break;
+        /* Keep every edge inside the window */
+        if (ends[count - 1] - cut > VITERBI_WINDOW && rel > 0) {
+            ok = lattice_settle(lattice, &cut, rel, &reach, &pass.counts, out);
+            rel = 0;
+        }
+        if (ends[count - 1] - cut > VITERBI_WINDOW) {
+            /* A run too long for the window is a token on its own */
+            ok = ok && span_push(out, pos, ends[count - 1], NEWMM_UNKNOWN_ID);
+            lattice->open_unknown = false;
+            cut = ends[count - 1];
+            rel = -1;
+            continue;
+        }
+        
+        int32_t here = lattice->cost[rel];
+        for (int i = 0; i < count; i++) {
+            int to = ends[i] - cut;
+            while (reach < to) lattice->cost[++reach] = VITERBI_INF;
+            if (here + costs[i] < lattice->cost[to]) {
+                lattice->cost[to] = here + costs[i];
+                lattice->back[to] = rel;
+                lattice->id[to] = ids[i];
+                lattice->kind[to] = (uint8_t)kind;
+            }
+        }
+    }
+    
+    if (ok && text_len > cut) {
+        ok = lattice_settle(lattice, &cut, text_len - cut, &reach, &pass.counts, out);
     }
     
-    free(valid_pos);
-    return token_count;
+    end_pass(&pass, boundaries, text_len, scratch, out);
+    return ok ? out->count : -1;
 }
 
-/* Default minimal Thai dictionary */
-static const char* default_words[] = {
-    "ไป", "มา", "ใน", "ที่", "และ", "หรือ", "คือ", "เป็น", "มี", "ได้",
-    "จะ", "ไม่", "ของ", "กับ", "ก็", "ให้", "ถ้า", "แล้ว", "เมื่อ", "ซึ่ง",
-    "นี้", "นั้น", "อยู่", "เพื่อ", "การ", "ความ", "จาก", "โดย", "อย่าง", "ถึง",
-    "ว่า", "เอง", "ทุก", "แต่", "ตาม", "นัก", "ยัง", "ผล", "ผู้", "คน",
-    "วัน", "ปี", "เดือน", "ครั้ง", "ตัว", "คน", "สิ่ง", "งาน", "ข้อ", "รับ",
-    NULL
-};
-
 newmm_dict_t newmm_load_dict(const char* dict_path) {
+    return newmm_load_dict_ex(dict_path, 0);
+}
+
+newmm_dict_t newmm_load_dict_ex(const char* dict_path, unsigned int flags) {
+    /* Compiled dictionaries are mapped as they are */
+    if (dict_path && datrie_file_is_binary(dict_path)) {
+        return newmm_load_dict_mmap(dict_path);
+    }
+    
+    /* The default dictionary is compiled in and used in place */
+    if (!dict_path) return (newmm_dict_t)datrie_from_image(&default_dict_image);
+    
     /* Create trie */
-    Trie* trie = trie_create();
+    Trie* trie = trie_create_keyed((flags & NEWMM_DICT_BYTE_KEYS) ? TRIE_KEY_BYTE
+                                                                  : TRIE_KEY_CODEPOINT);
     if (!trie) return NULL;
     
-    /* Load dictionary */
-    if (dict_path) {
-        if (trie_load_dict(trie, dict_path) < 0) {
-            /* Failed to load, use default */
-            for (int i = 0; default_words[i] != NULL; i++) {
-                trie_add(trie, default_words[i]);
-            }
-        }
-    } else {
-        /* Use default dictionary */
-        for (int i = 0; default_words[i] != NULL; i++) {
-            trie_add(trie, default_words[i]);
-        }
+    /* Load dictionary, falling back to the default one */
+    if (trie_load_dict(trie, dict_path) < 0) {
+        trie_free(trie);
+        return (newmm_dict_t)datrie_from_image(&default_dict_image);
+    }
+    
+    /* Freeze into the compact layout used for all lookups */
+    DATrie* da = datrie_build(trie);
+    trie_free(trie);
+    
+    return (newmm_dict_t)da;
+}
+
+newmm_dict_t newmm_load_dict_mmap(const char* path) {
+    return (newmm_dict_t)datrie_load_mmap(path);
+}
+
+int newmm_save_dict_binary(newmm_dict_t dict, const char* path) {
+    if (!dict || !path) return -1;
+    
+    return datrie_save((const DATrie*)dict, path);
+}
+
+/* Run engine into caller arrays of capacity spans; ids may be NULL */
+static int segment_engine(const char* text, size_t len, newmm_dict_t dict, newmm_engine_t engine,
+                          int32_t* starts, int32_t* ends, uint32_t* ids, size_t capacity) {
+    if (!text || !dict || (capacity > 0 && (!starts || !ends))) return -1;
+    if (len > INT32_MAX) return -1;
+    
+    SpanBuffer out = {starts, ends, capacity > 0 ? ids : NULL,
+                      capacity > INT32_MAX ? INT32_MAX : (int)capacity, 0, false, NULL};
+    switch (engine) {
+    case NEWMM_ENGINE_GREEDY:
+        return segment_text(text, (int)len, (const DATrie*)dict, NULL, &out);
+    case NEWMM_ENGINE_GRAPH:
+        return segment_text_graph(text, (int)len, (const DATrie*)dict, NULL, &out);
+    case NEWMM_ENGINE_WEIGHTED:
+        return segment_text_weighted(text, (int)len, (const DATrie*)dict, NULL, &out);
+    default:
+        return -1;
     }
+}
+
+int newmm_segment_spans(const char* text, size_t len, newmm_dict_t dict,
+                        int32_t* starts, int32_t* ends, size_t capacity) {
+    return newmm_segment_spans_engine(text, len, dict, NEWMM_ENGINE_GREEDY,
+                                      starts, ends, capacity);
+}
+
+int newmm_segment_spans_engine(const char* text, size_t len, newmm_dict_t dict,
+                               newmm_engine_t engine, int32_t* starts, int32_t* ends,
+                               size_t capacity) {
+    return segment_engine(text, len, dict, engine, starts, ends, NULL, capacity);
+}
+
+int newmm_segment_ids(const char* text, size_t len, newmm_dict_t dict,
+                      newmm_engine_t engine, int32_t* starts, int32_t* ends,
+                      uint32_t* ids, size_t capacity) {
+    if (capacity > 0 && !ids) return -1;
     
-    return (newmm_dict_t)trie;
+    /* The engines record the payload of each word as they match it */
+    return segment_engine(text, len, dict, engine, starts, ends, ids, capacity);
 }
 
-void newmm_free_dict(newmm_dict_t dict) {
-    if (dict) {
-        trie_free((Trie*)dict);
+uint32_t newmm_word_id(newmm_dict_t dict, const char* word, size_t len) {
+    uint32_t value;
+    if (!dict || !word || !datrie_word_value((const DATrie*)dict, word, len, &value)) {
+        return NEWMM_UNKNOWN_ID;
     }
+    return value;
 }
 
 char** newmm_segment_with_dict(const char* text, newmm_dict_t dict, int* token_count) {
+    if (!text) return NULL;
+    
+    return newmm_segment_with_dict_len(text, strlen(text), dict, token_count);
+}
+
+char** newmm_segment_with_dict_len(const char* text, size_t len, newmm_dict_t dict,
+                                   int* token_count) {
     if (!text || !token_count || !dict) return NULL;
     
     *token_count = 0;
     
     /* Empty text */
-    if (!text[0]) return NULL;
+    if (len == 0) return NULL;
+    if (len > INT32_MAX) return NULL;
     
-    Trie* trie = (Trie*)dict;
+    /* Segment into growable spans sized from the input, then copy out */
+    SpanBuffer out = {NULL, NULL, NULL, 0, 0, true, NULL};
+    int initial = (int)(len / 8) + 16;
+    out.starts = (int32_t*)malloc(initial * sizeof(int32_t));
+    out.ends = (int32_t*)malloc(initial * sizeof(int32_t));
+    if (out.starts && out.ends) out.capacity = initial;
     
-    /* Segment text */
-    char** tokens = NULL;
-    int count = segment_text(text, trie, &tokens);
+    int count = out.capacity > 0 ? segment_text(text, (int)len, (const DATrie*)dict, NULL, &out) : -1;
+    
+    newmm_stats_t output;
+    memset(&output, 0, sizeof(output));
+    bool timed = stats_enabled();
+    uint64_t started = timed ? stats_now_ns() : 0;
+    char** tokens = count > 0 ? (char**)malloc(count * sizeof(char*)) : NULL;
+    if (tokens) {
+        for (int i = 0; i < count; i++) {
+            tokens[i] = substring(text, out.starts[i], out.ends[i]);
+            if (!tokens[i]) {
+                newmm_free_result(tokens, i);
+                tokens = NULL;
+                break;
+            }
+        }
+    }
+    if (tokens) *token_count = count;
+    
+    output.bytes_allocated = 2 * (uint64_t)initial * sizeof(int32_t) +
+                             (count > 0 ? (uint64_t)count * (sizeof(char*) + 1) + len : 0);
+    if (timed) output.output_ns = stats_now_ns() - started;
+    stats_add(&output);
     
-    *token_count = count;
+    free(out.starts);
+    free(out.ends);
     return tokens;
 }
 
 char** newmm_segment(const char* text, const char* dict_path, int* token_count) {
+    if (!text) return NULL;
+    
+    return newmm_segment_len(text, strlen(text), dict_path, token_count);
+}
+
+char** newmm_segment_len(const char* text, size_t len, const char* dict_path, int* token_count) {
     if (!text || !token_count) return NULL;
     
     *token_count = 0;
     
     /* Empty text */
-    if (!text[0]) return NULL;
+    if (len == 0) return NULL;
     
-    /* Create and load dictionary */
-    newmm_dict_t dict = newmm_load_dict(dict_path);
+    /* Loaded once per path and kept by the cache */
+    newmm_dict_t dict = newmm_dict_cache_get(dict_path);
     if (!dict) return NULL;
     
     /* Segment text */
-    char** tokens = newmm_segment_with_dict(text, dict, token_count);
+    char** tokens = newmm_segment_with_dict_len(text, len, dict, token_count);
     
-    /* Cleanup */
-    newmm_free_dict(dict);
+    newmm_dict_release(dict);
     
     return tokens;
 }
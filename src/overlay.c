@@ -0,0 +1,101 @@
+/**
+ * @file overlay.c
+ * @brief Dictionaries layered on a shared base
+ *
+ * An overlay records words added to and removed from a base dictionary in
+ * two small mutable tries, kept disjoint. Building compiles just those
+ * into a DATrie that lookups consult together with the base, so the base
+ * is never copied or rebuilt.
+ */
+
+#include "../include/newmm.h"
+#include "trie.h"
+#include "datrie.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct newmm_overlay {
+    DATrie* base;     /* Holds one reference */
+    Trie* added;
+    Trie* removed;
+};
+
+newmm_overlay_t* newmm_overlay_create(newmm_dict_t base) {
+    if (!base) return NULL;
+    
+    newmm_overlay_t* overlay = (newmm_overlay_t*)malloc(sizeof(newmm_overlay_t));
+    if (!overlay) return NULL;
+    
+    TrieKeyMode key_mode = ((const DATrie*)base)->key_mode;
+    overlay->added = trie_create_keyed(key_mode);
+    overlay->removed = trie_create_keyed(key_mode);
+    if (!overlay->added || !overlay->removed) {
+        trie_free(overlay->added);
+        trie_free(overlay->removed);
+        free(overlay);
+        return NULL;
+    }
+    
+    /* Where payloads are numbered, words new to the chain follow all its
+     * layers' words */
+    for (const DATrie* da = (const DATrie*)base; da; da = da->base) {
+        overlay->added->next_value += (uint32_t)da->num_words;
+    }
+    
+    overlay->base = (DATrie*)newmm_dict_retain(base);
+    return overlay;
+}
+
+/* Move word from one side of the overlay to the other */
+static int overlay_move(Trie* from, Trie* to, const char* word) {
+    if (!word) return -1;
+    
+    size_t len = strlen(word);
+    if (!trie_add_n(to, word, len)) return -1;
+    trie_remove_n(from, word, len);
+    return 0;
+}
+
+int newmm_overlay_add(newmm_overlay_t* overlay, const char* word) {
+    if (!overlay) return -1;
+    
+    /* A word the base already has keeps its payload. Where payloads are
+     * frequencies a new word gets the neutral 0, not a number the
+     * weighted engine would read as a frequency. */
+    uint32_t value = 0;
+    size_t len = word ? strlen(word) : 0;
+    if (word && (datrie_word_value(overlay->base, word, len, &value) ||
+                 overlay->base->has_values)) {
+        if (!trie_add_value_n(overlay->added, word, len, value)) return -1;
+        trie_remove_n(overlay->removed, word, len);
+        return 0;
+    }
+    
+    return overlay_move(overlay->removed, overlay->added, word);
+}
+
+int newmm_overlay_remove(newmm_overlay_t* overlay, const char* word) {
+    if (!overlay) return -1;
+    
+    return overlay_move(overlay->added, overlay->removed, word);
+}
+
+newmm_dict_t newmm_overlay_build(newmm_overlay_t* overlay) {
+    if (!overlay) return NULL;
+    
+    DATrie* da = datrie_build_overlay(overlay->base, overlay->added, overlay->removed);
+    if (!da) return NULL;
+    
+    /* Released along with the overlay dictionary by newmm_dict_release() */
+    newmm_dict_retain(overlay->base);
+    return (newmm_dict_t)da;
+}
+
+void newmm_overlay_free(newmm_overlay_t* overlay) {
+    if (!overlay) return;
+    
+    trie_free(overlay->added);
+    trie_free(overlay->removed);
+    newmm_dict_release(overlay->base);
+    free(overlay);
+}
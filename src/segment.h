@@ -0,0 +1,97 @@
+/**
+ * @file segment.h
+ * @brief Core newmm segmentation shared by the public entry points
+ *
+ * Internal header. segment_text() only reads the dictionary, so any
+ * number of threads may run it on the same DATrie at once.
+ */
+
+#ifndef SEGMENT_H
+#define SEGMENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "datrie.h"
+#include "stats.h"
+
+/* Token boundary output. A growable buffer reallocs geometrically, or
+ * takes new arrays from arena when it has one; a fixed one keeps counting
+ * past capacity so callers learn the size they need. ids, when not NULL,
+ * receives the payload of the word each engine matched, or
+ * NEWMM_UNKNOWN_ID for a span that is not a dictionary match; a growable
+ * buffer that wants them starts with all three arrays allocated. */
+typedef struct {
+    int32_t* starts;
+    int32_t* ends;
+    uint32_t* ids;
+    int capacity;
+    int count;
+    bool growable;
+    Arena* arena;
+} SpanBuffer;
+
+/* Grow a span array of count entries to capacity entries */
+static inline void* span_grow(SpanBuffer* out, void* array, int capacity) {
+    if (!out->arena) return realloc(array, capacity * sizeof(int32_t));
+    
+    void* grown = arena_alloc(out->arena, capacity * sizeof(int32_t));
+    if (grown && out->count > 0) memcpy(grown, array, out->count * sizeof(int32_t));
+    return grown;
+}
+
+static inline bool span_push(SpanBuffer* out, int start, int end, uint32_t id) {
+    if (out->count >= out->capacity) {
+        if (!out->growable) {
+            out->count++;
+            return true;
+        }
+        
+        int new_capacity = out->capacity < 16 ? 16 : out->capacity * 2;
+        stats_add_allocated((out->ids ? 3 : 2) * (size_t)new_capacity * sizeof(int32_t));
+        int32_t* new_starts = (int32_t*)span_grow(out, out->starts, new_capacity);
+        if (!new_starts) return false;
+        out->starts = new_starts;
+        int32_t* new_ends = (int32_t*)span_grow(out, out->ends, new_capacity);
+        if (!new_ends) return false;
+        out->ends = new_ends;
+        if (out->ids) {
+            uint32_t* new_ids = (uint32_t*)span_grow(out, out->ids, new_capacity);
+            if (!new_ids) return false;
+            out->ids = new_ids;
+        }
+        out->capacity = new_capacity;
+    }
+    
+    out->starts[out->count] = start;
+    out->ends[out->count] = end;
+    if (out->ids) out->ids[out->count] = id;
+    out->count++;
+    return true;
+}
+
+/**
+ * @brief Segment text_len bytes of text, appending spans to out
+ *
+ * Offsets are relative to text. Scratch memory comes from scratch when it
+ * is not NULL, and from the heap otherwise. The total span count of out
+ * is returned, or -1 on allocation failure.
+ */
+int segment_text(const char* text, int text_len, const DATrie* trie, Arena* scratch,
+                 SpanBuffer* out);
+
+/**
+ * @brief Same as segment_text(), using the word graph engine
+ */
+int segment_text_graph(const char* text, int text_len, const DATrie* trie, Arena* scratch,
+                       SpanBuffer* out);
+
+/**
+ * @brief Same as segment_text(), using the frequency-weighted engine
+ */
+int segment_text_weighted(const char* text, int text_len, const DATrie* trie, Arena* scratch,
+                          SpanBuffer* out);
+
+#endif /* SEGMENT_H */
@@ -0,0 +1,93 @@
+/**
+ * @file stats.c
+ * @brief Per-thread segmentation statistics
+ *
+ * Counters live in thread-local storage, so counting needs no atomics and
+ * threads never contend. Multi-threaded calls merge their workers'
+ * counters into the calling thread when the workers finish.
+ */
+
+#include "../include/newmm.h"
+#include "stats.h"
+#include "thread.h"
+#include <string.h>
+
+#ifndef NEWMM_NO_STATS
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+static thread_counter_t stats_on = 0;
+static THREAD_LOCAL newmm_stats_t stats_local;
+
+bool stats_enabled(void) {
+    return thread_load_relaxed(&stats_on) != 0;
+}
+
+uint64_t stats_now_ns(void) {
+#ifdef _WIN32
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)(count.QuadPart / frequency.QuadPart * 1000000000 +
+                      count.QuadPart % frequency.QuadPart * 1000000000 / frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void stats_add(const newmm_stats_t* counts) {
+    if (!stats_enabled()) return;
+    
+    newmm_stats_t* s = &stats_local;
+    s->calls += counts->calls;
+    s->bytes += counts->bytes;
+    s->tcc_clusters += counts->tcc_clusters;
+    s->prefix_queries += counts->prefix_queries;
+    s->lookahead_queries += counts->lookahead_queries;
+    s->memo_hits += counts->memo_hits;
+    s->unknown_words += counts->unknown_words;
+    s->tokens += counts->tokens;
+    s->bytes_allocated += counts->bytes_allocated;
+    s->tcc_ns += counts->tcc_ns;
+    s->match_ns += counts->match_ns;
+    s->output_ns += counts->output_ns;
+}
+
+void stats_add_allocated(size_t bytes) {
+    if (stats_enabled()) stats_local.bytes_allocated += bytes;
+}
+
+int newmm_stats_enable(int enabled) {
+    thread_store_relaxed(&stats_on, enabled ? 1 : 0);
+    return 0;
+}
+
+void newmm_stats_get(newmm_stats_t* stats) {
+    if (stats) *stats = stats_local;
+}
+
+void newmm_stats_reset(void) {
+    memset(&stats_local, 0, sizeof(stats_local));
+}
+
+#else
+
+int newmm_stats_enable(int enabled) {
+    (void)enabled;
+    return -1;
+}
+
+void newmm_stats_get(newmm_stats_t* stats) {
+    if (stats) memset(stats, 0, sizeof(*stats));
+}
+
+void newmm_stats_reset(void) {
+}
+
+#endif /* NEWMM_NO_STATS */
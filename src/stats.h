@@ -0,0 +1,53 @@
+/**
+ * @file stats.h
+ * @brief Per-thread segmentation statistics
+ *
+ * Internal header. Hot loops count into a local newmm_stats_t and hand
+ * it to stats_add() once per call, which only touches the thread's
+ * counters while statistics are enabled. Building with NEWMM_NO_STATS
+ * turns every hook into a no-op the compiler removes.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../include/newmm.h"
+
+#ifndef NEWMM_NO_STATS
+
+/* Check whether newmm_stats_enable() turned counting on */
+bool stats_enabled(void);
+
+/* Monotonic clock in nanoseconds, for phase timings */
+uint64_t stats_now_ns(void);
+
+/* Add counts to the calling thread's statistics, if enabled */
+void stats_add(const newmm_stats_t* counts);
+
+/* Record bytes requested for scratch or output memory, if enabled */
+void stats_add_allocated(size_t bytes);
+
+#else
+
+static inline bool stats_enabled(void) {
+    return false;
+}
+
+static inline uint64_t stats_now_ns(void) {
+    return 0;
+}
+
+static inline void stats_add(const newmm_stats_t* counts) {
+    (void)counts;
+}
+
+static inline void stats_add_allocated(size_t bytes) {
+    (void)bytes;
+}
+
+#endif /* NEWMM_NO_STATS */
+
+#endif /* STATS_H */
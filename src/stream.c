@@ -0,0 +1,153 @@
+/**
+ * @file stream.c
+ * @brief Incremental segmentation of unbounded input
+ *
+ * Input is buffered and re-segmented as it grows. A token decision at
+ * position s reads at most two dictionary words ahead (the longest match
+ * and the lookahead after it), plus one character, so a token ending at
+ * least window bytes before the end of the buffer can no longer change
+ * and is emitted. Every token boundary is a TCC boundary, so trimming
+ * the emitted bytes keeps the TCC scan of the rest anchored exactly as in
+ * a one-shot segmentation.
+ */
+
+#include "../include/newmm.h"
+#include "arena.h"
+#include "datrie.h"
+#include "segment.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Input is consumed in slices of at most this many bytes per pass */
+#define STREAM_SLICE (64 * 1024)
+
+struct newmm_stream {
+    const DATrie* trie;
+    newmm_token_fn on_token;
+    void* user_data;
+    
+    char* buf;
+    size_t len;
+    size_t capacity;
+    size_t base;        /* Stream offset of buf[0] */
+    size_t pending;     /* Bytes of new input to wait for before the next pass */
+    size_t window;      /* Bytes at the end of buf whose tokens may still change */
+    
+    SpanBuffer spans;
+    Arena scratch;      /* TCC bitmap of the current pass */
+    bool failed;
+};
+
+newmm_stream_t* newmm_stream_create(newmm_dict_t dict, newmm_token_fn on_token, void* user_data) {
+    if (!dict || !on_token) return NULL;
+    
+    newmm_stream_t* stream = (newmm_stream_t*)calloc(1, sizeof(newmm_stream_t));
+    if (!stream) return NULL;
+    
+    stream->trie = (const DATrie*)dict;
+    stream->on_token = on_token;
+    stream->user_data = user_data;
+    stream->window = 2 * (size_t)stream->trie->max_word_bytes + 16;
+    stream->pending = stream->window;
+    stream->spans.growable = true;
+    arena_init(&stream->scratch);
+    return stream;
+}
+
+/* Segment the buffer and emit every token that is final. With final set,
+ * all remaining tokens are emitted and the buffer is emptied. */
+static int stream_process(newmm_stream_t* stream, bool final) {
+    if (stream->len > INT32_MAX) {
+        stream->failed = true;
+        return -1;
+    }
+    
+    stream->spans.count = 0;
+    int status = segment_text(stream->buf, (int)stream->len, stream->trie, &stream->scratch,
+                              &stream->spans);
+    arena_reset(&stream->scratch);
+    if (status < 0) {
+        stream->failed = true;
+        return -1;
+    }
+    
+    size_t limit = final ? stream->len :
+                   stream->len > stream->window ? stream->len - stream->window : 0;
+    size_t emitted = 0;
+    for (int i = 0; i < stream->spans.count && (size_t)stream->spans.ends[i] <= limit; i++) {
+        size_t s = (size_t)stream->spans.starts[i];
+        size_t e = (size_t)stream->spans.ends[i];
+        stream->on_token(stream->buf + s, e - s, stream->base + s, stream->user_data);
+        emitted = e;
+    }
+    
+    if (final) {
+        stream->base += stream->len;
+        stream->len = 0;
+        stream->pending = stream->window;
+        return 0;
+    }
+    
+    /* Drop the emitted bytes */
+    if (emitted > 0) {
+        memmove(stream->buf, stream->buf + emitted, stream->len - emitted);
+        stream->len -= emitted;
+        stream->base += emitted;
+    }
+    
+    /* Wait for the buffer to at least double so that a long pending token
+     * (such as a run of spaces) is not re-segmented once per window */
+    stream->pending = stream->len > stream->window ? stream->len : stream->window;
+    return 0;
+}
+
+int newmm_stream_feed(newmm_stream_t* stream, const char* data, size_t len) {
+    if (!stream || (len > 0 && !data) || stream->failed) return -1;
+    
+    while (len > 0) {
+        size_t slice = len < STREAM_SLICE ? len : STREAM_SLICE;
+        
+        if (stream->len + slice > stream->capacity) {
+            size_t new_capacity = stream->capacity ? stream->capacity : 1024;
+            while (new_capacity < stream->len + slice) new_capacity *= 2;
+            char* new_buf = (char*)realloc(stream->buf, new_capacity);
+            if (!new_buf) {
+                stream->failed = true;
+                return -1;
+            }
+            stream->buf = new_buf;
+            stream->capacity = new_capacity;
+        }
+        
+        memcpy(stream->buf + stream->len, data, slice);
+        stream->len += slice;
+        data += slice;
+        len -= slice;
+        
+        if (slice >= stream->pending) {
+            if (stream_process(stream, false) < 0) return -1;
+        } else {
+            stream->pending -= slice;
+        }
+    }
+    
+    return 0;
+}
+
+int newmm_stream_finish(newmm_stream_t* stream) {
+    if (!stream || stream->failed) return -1;
+    
+    return stream_process(stream, true);
+}
+
+void newmm_stream_free(newmm_stream_t* stream) {
+    if (!stream) return;
+    
+    free(stream->buf);
+    free(stream->spans.starts);
+    free(stream->spans.ends);
+    arena_destroy(&stream->scratch);
+    free(stream);
+}
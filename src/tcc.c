@@ -4,160 +4,294 @@
  * 
  * Based on rules proposed by Theeramunkong et al. 2000
  * and improved rules used in PyThaiNLP's newmm
+ * 
+ * Thai characters are classified through a 128-entry table for the Thai
+ * block, read straight from the 3-byte UTF-8 form without decoding. Every
+ * ASCII byte is a cluster of its own, so ASCII runs are skipped in bulk
+ * with SIMD where available (SSE2, AVX2 chosen at runtime, or NEON).
  */
 
 #include "tcc.h"
+#include "utf8.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 
-/* Thai Unicode ranges */
-#define THAI_START 0x0E00
-#define THAI_END   0x0E7F
-
-/* Thai character classes */
-#define is_thai_consonant(c) ((c) >= 0x0E01 && (c) <= 0x0E2E)
-#define is_thai_vowel_above(c) ((c) >= 0x0E34 && (c) <= 0x0E37)
-#define is_thai_vowel_below(c) ((c) == 0x0E38 || (c) == 0x0E39)
-#define is_thai_tone(c) ((c) >= 0x0E48 && (c) <= 0x0E4B)
-#define is_thai_sign(c) ((c) == 0x0E4C || (c) == 0x0E4D || (c) == 0x0E4E)
-#define is_thai_vowel_follow(c) ((c) >= 0x0E30 && (c) <= 0x0E33)
-#define is_thai_vowel_lead(c) ((c) >= 0x0E40 && (c) <= 0x0E44)
-
-/* UTF-8 helper functions */
-static int utf8_char_len(unsigned char c) {
-    if ((c & 0x80) == 0) return 1;
-    if ((c & 0xE0) == 0xC0) return 2;
-    if ((c & 0xF0) == 0xE0) return 3;
-    if ((c & 0xF8) == 0xF0) return 4;
-    return 1;
-}
-
-static int get_utf8_codepoint(const char* str, int* byte_len) {
-    unsigned char c = (unsigned char)str[0];
-    int len = utf8_char_len(c);
-    int codepoint = 0;
-    
-    if (len == 1) {
-        codepoint = c;
-    } else if (len == 2) {
-        codepoint = ((c & 0x1F) << 6) | (str[1] & 0x3F);
-    } else if (len == 3) {
-        codepoint = ((c & 0x0F) << 12) | ((str[1] & 0x3F) << 6) | (str[2] & 0x3F);
-    } else if (len == 4) {
-        codepoint = ((c & 0x07) << 18) | ((str[1] & 0x3F) << 12) | 
-                    ((str[2] & 0x3F) << 6) | (str[3] & 0x3F);
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TCC_HAVE_SSE2 1
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define TCC_HAVE_AVX2 1
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define TCC_HAVE_NEON 1
+#endif
+
+/* Character classes, one bit each */
+#define TCC_CONS    0x01  /* Consonant ก-ฮ */
+#define TCC_LEAD    0x02  /* Leading vowel เ แ โ ใ ไ */
+#define TCC_FOLLOW  0x04  /* Following vowel ะ ั า ำ (U+0E30-0E33) */
+#define TCC_MARK    0x08  /* Vowel above/below, tone mark or sign */
+#define TCC_PRE_KARAN 0x10  /* ุ or ิ, may precede a karan */
+#define TCC_KARAN   0x20  /* Thanthakhat ์ */
+
+/* Classes of U+0E00-U+0E7F */
+static const unsigned char thai_class[128] = {
+    /* 0E00-0E0F: consonants from ก */
+    0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    /* 0E10-0E1F */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    /* 0E20-0E2F: consonants to ฮ (0E2E) */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0,
+    /* 0E30-0E3F: follow vowels 0E30-0E33, above 0E34-0E37, below 0E38-0E39 */
+    4, 4, 4, 4, 8 | 16, 8, 8, 8, 8 | 16, 8, 0, 0, 0, 0, 0, 0,
+    /* 0E40-0E4F: leading vowels 0E40-0E44, tones 0E48-0E4B, signs 0E4C-0E4E */
+    2, 2, 2, 2, 2, 0, 0, 0, 8, 8, 8, 8, 8 | 32, 8, 8, 0,
+    /* 0E50-0E7F */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+/* Class of the Thai character at s (3 bytes), or 0 for anything else */
+static inline unsigned char class_at(const unsigned char* s, const unsigned char* end) {
+    if (end - s < 3 || s[0] != 0xE0 || (s[1] & 0xFE) != 0xB8 || !utf8_is_cont(s[2])) return 0;
+    return thai_class[((s[1] & 0x01) << 6) | (s[2] & 0x3F)];
+}
+
+/* Check whether s starts a consonant silenced by a karan (e.g. the ร์ of
+ * จันทร์), optionally with ุ or ิ in between. Only such a consonant joins
+ * the cluster before it. */
+static inline bool is_karan_consonant(const unsigned char* s, const unsigned char* end) {
+    if (!(class_at(s, end) & TCC_CONS)) return false;
+    s += 3;
+    
+    unsigned char cls = class_at(s, end);
+    if (cls & TCC_PRE_KARAN) {
+        s += 3;
+        cls = class_at(s, end);
     }
+    return (cls & TCC_KARAN) != 0;
+}
+
+/* Byte length of the cluster starting at text */
+static int get_tcc_length(const unsigned char* s, const unsigned char* end) {
+    unsigned char cls = class_at(s, end);
     
-    *byte_len = len;
-    return codepoint;
-}
-
-/* Simplified TCC detection - matches basic Thai character clusters */
-static int get_tcc_length(const char* text) {
-    int byte_len;
-    int cp = get_utf8_codepoint(text, &byte_len);
-    int total_len = byte_len;
-    const char* ptr = text + byte_len;
-    
-    /* Leading vowel (เ, แ, โ, ใ, ไ) */
-    if (is_thai_vowel_lead(cp)) {
-        /* Must be followed by consonant */
-        if (*ptr) {
-            cp = get_utf8_codepoint(ptr, &byte_len);
-            if (is_thai_consonant(cp)) {
-                total_len += byte_len;
-                ptr += byte_len;
-                
-                /* Optional: consonant */
-                if (*ptr) {
-                    int next_cp = get_utf8_codepoint(ptr, &byte_len);
-                    if (is_thai_consonant(next_cp)) {
-                        total_len += byte_len;
-                        ptr += byte_len;
-                    }
-                }
-                
-                /* Optional: tone mark or other diacritics */
-                while (*ptr) {
-                    int next_cp = get_utf8_codepoint(ptr, &byte_len);
-                    if (is_thai_tone(next_cp) || is_thai_sign(next_cp) || 
-                        is_thai_vowel_above(next_cp) || is_thai_vowel_below(next_cp)) {
-                        total_len += byte_len;
-                        ptr += byte_len;
-                    } else {
-                        break;
-                    }
-                }
-            }
-        }
-        return total_len;
+    /* Single character (non-Thai or standalone) */
+    if (!(cls & (TCC_LEAD | TCC_CONS))) {
+        int byte_len;
+        utf8_decode_n((const char*)s, end - s, &byte_len);
+        return byte_len;
     }
     
-    /* Consonant-based cluster */
-    if (is_thai_consonant(cp)) {
-        /* Optional: additional consonant */
-        if (*ptr) {
-            int next_cp = get_utf8_codepoint(ptr, &byte_len);
-            if (is_thai_consonant(next_cp)) {
-                total_len += byte_len;
-                ptr += byte_len;
-            }
-        }
-        
-        /* Optional: tone marks, vowels, signs */
-        while (*ptr) {
-            int next_cp = get_utf8_codepoint(ptr, &byte_len);
-            if (is_thai_tone(next_cp) || is_thai_sign(next_cp) || 
-                is_thai_vowel_above(next_cp) || is_thai_vowel_below(next_cp) ||
-                is_thai_vowel_follow(next_cp)) {
-                total_len += byte_len;
-                ptr += byte_len;
-            } else {
-                break;
-            }
-        }
-        
-        return total_len;
+    const unsigned char* ptr = s + 3;
+    unsigned char absorb = TCC_MARK | TCC_FOLLOW;
+    
+    /* Leading vowel (เ, แ, โ, ใ, ไ) must be followed by a consonant */
+    if (cls & TCC_LEAD) {
+        if (!(class_at(ptr, end) & TCC_CONS)) return 3;
+        ptr += 3;
+        absorb = TCC_MARK;
     }
     
-    /* Single character (non-Thai or standalone) */
-    return byte_len;
+    /* Optional: additional consonant with karan */
+    if (is_karan_consonant(ptr, end)) ptr += 3;
+    
+    /* Optional: tone marks, vowels, signs */
+    while (class_at(ptr, end) & absorb) ptr += 3;
+    
+    return (int)(ptr - s);
+}
+
+/* ASCII run length: number of leading bytes of s below 0x80 */
+static size_t ascii_run_scalar(const unsigned char* s, size_t n) {
+    size_t i = 0;
+    while (i < n && s[i] < 0x80) i++;
+    return i;
+}
+
+static inline int ctz32(unsigned int x) {
+#ifdef _MSC_VER
+    unsigned long bit;
+    _BitScanForward(&bit, x);
+    return (int)bit;
+#else
+    return __builtin_ctz(x);
+#endif
+}
+
+#ifdef TCC_HAVE_SSE2
+static size_t ascii_run_sse2(const unsigned char* s, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(s + i)));
+        if (mask) return i + ctz32((unsigned int)mask);
+    }
+    return i + ascii_run_scalar(s + i, n - i);
 }
+#endif
 
-int tcc_pos(const char* text, int** positions) {
-    if (!text || !positions) return 0;
+#ifdef TCC_HAVE_AVX2
+__attribute__((target("avx2")))
+static size_t ascii_run_avx2(const unsigned char* s, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        int mask = _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)(s + i)));
+        if (mask) return i + ctz32((unsigned int)mask);
+    }
+    return i + ascii_run_scalar(s + i, n - i);
+}
+#endif
+
+#ifdef TCC_HAVE_NEON
+static size_t ascii_run_neon(const unsigned char* s, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        if (vmaxvq_u8(vld1q_u8(s + i)) >= 0x80) break;
+    }
+    return i + ascii_run_scalar(s + i, n - i);
+}
+#endif
+
+/* Implementation forced by tcc_set_impl(), TCC_IMPL_AUTO to detect */
+static TccImpl forced_impl = TCC_IMPL_AUTO;
+
+static bool impl_available(TccImpl impl) {
+    switch (impl) {
+    case TCC_IMPL_SCALAR:
+        return true;
+#ifdef TCC_HAVE_SSE2
+    case TCC_IMPL_SSE2:
+        return true;
+#endif
+#ifdef TCC_HAVE_AVX2
+    case TCC_IMPL_AVX2:
+        return __builtin_cpu_supports("avx2") != 0;
+#endif
+#ifdef TCC_HAVE_NEON
+    case TCC_IMPL_NEON:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+TccImpl tcc_get_impl(void) {
+    if (forced_impl != TCC_IMPL_AUTO) return forced_impl;
     
-    int len = strlen(text);
-    if (len == 0) return 0;
+    if (impl_available(TCC_IMPL_AVX2)) return TCC_IMPL_AVX2;
+    if (impl_available(TCC_IMPL_SSE2)) return TCC_IMPL_SSE2;
+    if (impl_available(TCC_IMPL_NEON)) return TCC_IMPL_NEON;
+    return TCC_IMPL_SCALAR;
+}
+
+bool tcc_set_impl(TccImpl impl) {
+    if (impl != TCC_IMPL_AUTO && !impl_available(impl)) return false;
     
-    /* Allocate initial array */
-    int capacity = 100;
-    *positions = (int*)malloc(capacity * sizeof(int));
-    if (!*positions) return 0;
+    forced_impl = impl;
+    return true;
+}
+
+typedef size_t (*ascii_run_fn)(const unsigned char* s, size_t n);
+
+static ascii_run_fn select_ascii_run(void) {
+    switch (tcc_get_impl()) {
+#ifdef TCC_HAVE_SSE2
+    case TCC_IMPL_SSE2:
+        return ascii_run_sse2;
+#endif
+#ifdef TCC_HAVE_AVX2
+    case TCC_IMPL_AVX2:
+        return ascii_run_avx2;
+#endif
+#ifdef TCC_HAVE_NEON
+    case TCC_IMPL_NEON:
+        return ascii_run_neon;
+#endif
+    default:
+        return ascii_run_scalar;
+    }
+}
+
+/* Set bits from..to (inclusive) of bitmap */
+static void set_bit_range(uint64_t* bitmap, size_t from, size_t to) {
+    size_t first = from >> 6, last = to >> 6;
+    uint64_t head = ~(uint64_t)0 << (from & 63);
+    uint64_t tail = ~(uint64_t)0 >> (63 - (to & 63));
     
+    if (first == last) {
+        bitmap[first] |= head & tail;
+        return;
+    }
+    bitmap[first] |= head;
+    for (size_t w = first + 1; w < last; w++) bitmap[w] = ~(uint64_t)0;
+    bitmap[last] |= tail;
+}
+
+int tcc_boundaries(const char* text, int len, uint64_t** bitmap) {
+    if (!text || !bitmap || len <= 0) return 0;
+    
+    *bitmap = (uint64_t*)malloc(TCC_BITMAP_WORDS(len) * sizeof(uint64_t));
+    if (!*bitmap) return 0;
+    
+    return tcc_boundaries_into(text, len, *bitmap);
+}
+
+int tcc_boundaries_into(const char* text, int len, uint64_t* bitmap) {
+    if (!text || !bitmap || len <= 0) return 0;
+    
+    memset(bitmap, 0, TCC_BITMAP_WORDS(len) * sizeof(uint64_t));
+    ascii_run_fn ascii_run = select_ascii_run();
+    const unsigned char* s = (const unsigned char*)text;
+    const unsigned char* end = s + len;
     int count = 0;
-    const char* ptr = text;
     int byte_pos = 0;
+    bitmap[0] = 1;
     
-    while (*ptr) {
-        int cluster_len = get_tcc_length(ptr);
-        byte_pos += cluster_len;
-        
-        /* Add position */
-        if (count >= capacity) {
-            capacity *= 2;
-            int* new_positions = (int*)realloc(*positions, capacity * sizeof(int));
-            if (!new_positions) {
-                free(*positions);
-                return 0;
-            }
-            *positions = new_positions;
+    while (byte_pos < len) {
+        if (s[byte_pos] < 0x80) {
+            /* Each ASCII byte is its own cluster */
+            size_t run = ascii_run(s + byte_pos, (size_t)(len - byte_pos));
+            set_bit_range(bitmap, (size_t)byte_pos + 1, (size_t)byte_pos + run);
+            byte_pos += (int)run;
+            count += (int)run;
+            continue;
         }
         
-        (*positions)[count++] = byte_pos;
-        ptr += cluster_len;
+        byte_pos += get_tcc_length(s + byte_pos, end);
+        bitmap[byte_pos >> 6] |= (uint64_t)1 << (byte_pos & 63);
+        count++;
     }
     
     return count;
 }
+
+int tcc_pos(const char* text, int len, int** positions) {
+    if (!text || !positions || len <= 0) return 0;
+    
+    uint64_t* bitmap;
+    int count = tcc_boundaries(text, len, &bitmap);
+    if (count == 0) return 0;
+    
+    *positions = (int*)malloc(count * sizeof(int));
+    if (!*positions) {
+        free(bitmap);
+        return 0;
+    }
+    
+    int n = 0;
+    for (int pos = 0; pos < len; ) {
+        pos = tcc_next_boundary(bitmap, len, pos);
+        (*positions)[n++] = pos;
+    }
+    
+    free(bitmap);
+    return n;
+}
@@ -10,14 +10,96 @@
 #define TCC_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/* Scanner implementations; all produce identical boundaries */
+typedef enum {
+    TCC_IMPL_AUTO = 0,   /* Best one supported by the CPU */
+    TCC_IMPL_SCALAR,
+    TCC_IMPL_SSE2,
+    TCC_IMPL_AVX2,
+    TCC_IMPL_NEON
+} TccImpl;
+
+/* Words of a boundary bitmap covering offsets 0..len */
+#define TCC_BITMAP_WORDS(len) ((size_t)(len) / 64 + 1)
 
 /**
  * @brief Get valid Thai Character Cluster breaking positions
  * 
- * @param text Input Thai text (UTF-8)
+ * @param text Input Thai text (UTF-8), need not be NUL-terminated
+ * @param len Length of text in bytes
  * @param positions Output array of byte positions (caller must free)
  * @return Number of positions found
  */
-int tcc_pos(const char* text, int** positions);
+int tcc_pos(const char* text, int len, int** positions);
+
+/**
+ * @brief Mark Thai Character Cluster boundaries in a bitmap
+ * 
+ * Bit b of the bitmap is set when byte offset b is a cluster boundary.
+ * Offsets 0 and len are always boundaries.
+ * 
+ * @param text Input Thai text (UTF-8), need not be NUL-terminated
+ * @param len Length of text in bytes
+ * @param bitmap Output of TCC_BITMAP_WORDS(len) words (caller must free)
+ * @return Number of clusters found, 0 on error or empty text
+ */
+int tcc_boundaries(const char* text, int len, uint64_t** bitmap);
+
+/**
+ * @brief Same as tcc_boundaries(), filling a caller-provided bitmap
+ * 
+ * @param bitmap Array of at least TCC_BITMAP_WORDS(len) words
+ */
+int tcc_boundaries_into(const char* text, int len, uint64_t* bitmap);
+
+/**
+ * @brief Get the scanner implementation currently in use
+ */
+TccImpl tcc_get_impl(void);
+
+/**
+ * @brief Force a scanner implementation, or TCC_IMPL_AUTO to detect
+ * 
+ * Meant for tests and benchmarks; not safe to call while other threads
+ * are segmenting.
+ * 
+ * @return false if impl is not available in this build or on this CPU
+ */
+bool tcc_set_impl(TccImpl impl);
+
+/* Check whether byte offset pos (0..len) is a cluster boundary */
+static inline bool tcc_is_boundary(const uint64_t* bitmap, int pos) {
+    return (bitmap[pos >> 6] >> (pos & 63)) & 1;
+}
+
+/* First cluster boundary after byte offset pos, or len if there is none */
+static inline int tcc_next_boundary(const uint64_t* bitmap, int len, int pos) {
+    int p = pos + 1;
+    if (p >= len) return len;
+    
+    size_t w = (size_t)p >> 6;
+    size_t last = (size_t)len >> 6;
+    uint64_t word = bitmap[w] & (~(uint64_t)0 << (p & 63));
+    while (!word) {
+        if (++w > last) return len;
+        word = bitmap[w];
+    }
+    
+#ifdef _MSC_VER
+    unsigned long bit;
+    _BitScanForward64(&bit, word);
+#else
+    int bit = __builtin_ctzll(word);
+#endif
+    int next = (int)(w * 64) + (int)bit;
+    return next < len ? next : len;
+}
 
 #endif /* TCC_H */
@@ -0,0 +1,162 @@
+/**
+ * @file thread.h
+ * @brief Minimal portable threads and atomics
+ *
+ * Internal header. Wraps pthreads on POSIX systems and the Win32 API on
+ * Windows, covering just what the batch segmenter, shared dictionary
+ * handles and per-thread statistics need.
+ */
+
+#ifndef THREAD_H
+#define THREAD_H
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+
+typedef HANDLE thread_t;
+typedef volatile LONG thread_counter_t;
+
+#define THREAD_LOCAL __declspec(thread)
+
+typedef struct {
+    void* (*fn)(void*);
+    void* arg;
+} ThreadStart;
+
+static inline DWORD WINAPI thread_trampoline(LPVOID param) {
+    ThreadStart start = *(ThreadStart*)param;
+    free(param);
+    start.fn(start.arg);
+    return 0;
+}
+
+/* Start fn(arg) on a new thread. Returns 0 on success, -1 on error. */
+static inline int thread_start(thread_t* thread, void* (*fn)(void*), void* arg) {
+    ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+    if (!start) return -1;
+    start->fn = fn;
+    start->arg = arg;
+    
+    *thread = CreateThread(NULL, 0, thread_trampoline, start, 0, NULL);
+    if (!*thread) {
+        free(start);
+        return -1;
+    }
+    return 0;
+}
+
+static inline void thread_join(thread_t thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+/* Add delta to *counter and return the previous value */
+static inline long thread_fetch_add(thread_counter_t* counter, long delta) {
+    return InterlockedExchangeAdd(counter, delta);
+}
+
+/* Same, ordered against surrounding memory accesses (for refcounts) */
+static inline long thread_fetch_add_acq_rel(thread_counter_t* counter, long delta) {
+    return InterlockedExchangeAdd(counter, delta);
+}
+
+/* Plain atomic read and write, for flags */
+static inline long thread_load_relaxed(const thread_counter_t* counter) {
+    return *counter;
+}
+
+static inline void thread_store_relaxed(thread_counter_t* counter, long value) {
+    InterlockedExchange(counter, value);
+}
+
+typedef SRWLOCK thread_mutex_t;
+#define THREAD_MUTEX_INITIALIZER SRWLOCK_INIT  /* For static mutexes */
+
+static inline void thread_mutex_init(thread_mutex_t* mutex) {
+    InitializeSRWLock(mutex);
+}
+
+static inline void thread_mutex_lock(thread_mutex_t* mutex) {
+    AcquireSRWLockExclusive(mutex);
+}
+
+static inline void thread_mutex_unlock(thread_mutex_t* mutex) {
+    ReleaseSRWLockExclusive(mutex);
+}
+
+static inline void thread_mutex_destroy(thread_mutex_t* mutex) {
+    (void)mutex;
+}
+
+static inline int thread_cpu_count(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+}
+
+#else
+#include <pthread.h>
+#include <unistd.h>
+
+typedef pthread_t thread_t;
+typedef long thread_counter_t;
+
+#define THREAD_LOCAL __thread
+
+/* Start fn(arg) on a new thread. Returns 0 on success, -1 on error. */
+static inline int thread_start(thread_t* thread, void* (*fn)(void*), void* arg) {
+    return pthread_create(thread, NULL, fn, arg) == 0 ? 0 : -1;
+}
+
+static inline void thread_join(thread_t thread) {
+    pthread_join(thread, NULL);
+}
+
+/* Add delta to *counter and return the previous value */
+static inline long thread_fetch_add(thread_counter_t* counter, long delta) {
+    return __atomic_fetch_add(counter, delta, __ATOMIC_RELAXED);
+}
+
+/* Same, ordered against surrounding memory accesses (for refcounts) */
+static inline long thread_fetch_add_acq_rel(thread_counter_t* counter, long delta) {
+    return __atomic_fetch_add(counter, delta, __ATOMIC_ACQ_REL);
+}
+
+/* Plain atomic read and write, for flags */
+static inline long thread_load_relaxed(const thread_counter_t* counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+static inline void thread_store_relaxed(thread_counter_t* counter, long value) {
+    __atomic_store_n(counter, value, __ATOMIC_RELAXED);
+}
+
+typedef pthread_mutex_t thread_mutex_t;
+#define THREAD_MUTEX_INITIALIZER PTHREAD_MUTEX_INITIALIZER  /* For static mutexes */
+
+static inline void thread_mutex_init(thread_mutex_t* mutex) {
+    pthread_mutex_init(mutex, NULL);
+}
+
+static inline void thread_mutex_lock(thread_mutex_t* mutex) {
+    pthread_mutex_lock(mutex);
+}
+
+static inline void thread_mutex_unlock(thread_mutex_t* mutex) {
+    pthread_mutex_unlock(mutex);
+}
+
+static inline void thread_mutex_destroy(thread_mutex_t* mutex) {
+    pthread_mutex_destroy(mutex);
+}
+
+static inline int thread_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+#endif
+
+#endif /* THREAD_H */
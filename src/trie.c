@@ -4,201 +4,555 @@
  */
 
 #include "trie.h"
+#include "utf8.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
-#define INITIAL_CAPACITY 8
-
-/* Helper function to decode UTF-8 character */
-static int utf8_char_len(unsigned char c) {
-    if ((c & 0x80) == 0) return 1;
-    if ((c & 0xE0) == 0xC0) return 2;
-    if ((c & 0xF0) == 0xE0) return 3;
-    if ((c & 0xF8) == 0xF0) return 4;
-    return 1; /* Invalid UTF-8 */
-}
-
-/* Get UTF-8 codepoint from string */
-static int get_utf8_codepoint(const char* str, int* byte_len) {
-    unsigned char c = (unsigned char)str[0];
-    int len = utf8_char_len(c);
-    int codepoint = 0;
-    
-    if (len == 1) {
-        codepoint = c;
-    } else if (len == 2) {
-        codepoint = ((c & 0x1F) << 6) | (str[1] & 0x3F);
-    } else if (len == 3) {
-        codepoint = ((c & 0x0F) << 12) | ((str[1] & 0x3F) << 6) | (str[2] & 0x3F);
-    } else if (len == 4) {
-        codepoint = ((c & 0x07) << 18) | ((str[1] & 0x3F) << 12) | 
-                    ((str[2] & 0x3F) << 6) | (str[3] & 0x3F);
+/* Read the next edge key from the avail bytes at ptr */
+static inline int trie_next_key(const Trie* trie, const char* ptr, size_t avail, int* byte_len) {
+    if (trie->key_mode == TRIE_KEY_BYTE) {
+        *byte_len = 1;
+        return (unsigned char)*ptr;
     }
-    
-    *byte_len = len;
-    return codepoint;
+    return utf8_decode_n(ptr, avail, byte_len);
 }
 
-/* Create a new trie node */
-static TrieNode* trie_node_create(void) {
-    TrieNode* node = (TrieNode*)calloc(1, sizeof(TrieNode));
+/* Create a new trie node in the trie's pool */
+static TrieNode* trie_node_create(Trie* trie) {
+    TrieNode* node = (TrieNode*)arena_alloc(&trie->pool, sizeof(TrieNode));
     if (!node) return NULL;
     
     node->is_end = false;
+    node->value = 0;
     node->children = NULL;
-    node->child_chars = NULL;
     node->num_children = 0;
     node->capacity = 0;
     
     return node;
 }
 
-/* Free a trie node and all its children */
-static void trie_node_free(TrieNode* node) {
-    if (!node) return;
+/* Children with more keys than this are binary searched */
+#define TRIE_LINEAR_CHILDREN 8
+
+/* Index of the first child whose key is not less than codepoint;
+ * children are kept sorted by key */
+static int trie_node_lower_bound(const TrieNode* node, int codepoint) {
+    if (node->num_children == 0) return 0;
     
-    for (int i = 0; i < node->num_children; i++) {
-        trie_node_free(node->children[i]);
+    const int* keys = trie_node_keys(node);
+    int lo = 0, hi = node->num_children;
+    while (hi - lo > TRIE_LINEAR_CHILDREN) {
+        int mid = lo + (hi - lo) / 2;
+        if (keys[mid] < codepoint) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
-    
-    free(node->children);
-    free(node->child_chars);
-    free(node);
+    while (lo < hi && keys[lo] < codepoint) lo++;
+    return lo;
 }
 
 /* Find child node by codepoint */
-static TrieNode* trie_node_get_child(TrieNode* node, int codepoint) {
-    for (int i = 0; i < node->num_children; i++) {
-        if (node->child_chars[i] == codepoint) {
-            return node->children[i];
-        }
+static TrieNode* trie_node_get_child(const TrieNode* node, int codepoint) {
+    int i = trie_node_lower_bound(node, codepoint);
+    if (i < node->num_children && trie_node_keys(node)[i] == codepoint) {
+        return node->children[i];
     }
     return NULL;
 }
 
+/* Get a block for a child array of 1 << size_class entries: the child
+ * pointers followed by their keys. A block of any size can be recycled
+ * as the largest class that fits in it. */
+static void* trie_block_alloc(Trie* trie, int size_class) {
+    void* block = trie->free_blocks[size_class];
+    if (block) {
+        trie->free_blocks[size_class] = *(void**)block;
+        return block;
+    }
+    
+    size_t entries = (size_t)1 << size_class;
+    return arena_alloc(&trie->pool, entries * (sizeof(TrieNode*) + sizeof(int)));
+}
+
+/* Return a child array block for reuse by another node */
+static void trie_block_release(Trie* trie, void* block, int size_class) {
+    *(void**)block = trie->free_blocks[size_class];
+    trie->free_blocks[size_class] = block;
+}
+
 /* Add child node */
-static TrieNode* trie_node_add_child(TrieNode* node, int codepoint) {
-    /* Check if need to expand capacity */
+static TrieNode* trie_node_add_child(Trie* trie, TrieNode* node, int codepoint) {
+    /* Move to the next size class when full */
     if (node->num_children >= node->capacity) {
-        int new_capacity = node->capacity == 0 ? INITIAL_CAPACITY : node->capacity * 2;
+        int size_class = 0;
+        while ((1 << size_class) <= node->capacity) size_class++;
+        if (size_class >= TRIE_SIZE_CLASSES) return NULL;
         
-        /* Allocate both arrays before updating pointers */
-        TrieNode** new_children = (TrieNode**)realloc(node->children, 
-                                                       new_capacity * sizeof(TrieNode*));
-        if (!new_children) return NULL;
+        void* block = trie_block_alloc(trie, size_class);
+        if (!block) return NULL;
         
-        int* new_chars = (int*)realloc(node->child_chars, new_capacity * sizeof(int));
-        if (!new_chars) {
-            /* new_children was allocated but new_chars failed */
-            /* Since realloc succeeded for new_children, the old pointer is invalid */
-            /* We must use the new_children pointer, even though we can't proceed */
-            node->children = new_children;
-            /* Alternatively, we could try to restore by reallocating to old size */
-            /* But that could also fail, so we just update and return NULL */
-            return NULL;
+        int new_capacity = 1 << size_class;
+        TrieNode** new_children = (TrieNode**)block;
+        int* new_chars = (int*)(new_children + new_capacity);
+        if (node->num_children > 0) {
+            memcpy(new_children, node->children, node->num_children * sizeof(TrieNode*));
+            memcpy(new_chars, trie_node_keys(node), node->num_children * sizeof(int));
+            trie_block_release(trie, node->children, size_class - 1);
         }
         
-        /* Both allocations succeeded, update pointers */
         node->children = new_children;
-        node->child_chars = new_chars;
         node->capacity = new_capacity;
     }
     
-    /* Create new child */
-    TrieNode* child = trie_node_create();
+    /* Create new child, keeping keys sorted */
+    TrieNode* child = trie_node_create(trie);
     if (!child) return NULL;
     
-    node->children[node->num_children] = child;
-    node->child_chars[node->num_children] = codepoint;
+    int i = trie_node_lower_bound(node, codepoint);
+    int after = node->num_children - i;
+    memmove(node->children + i + 1, node->children + i, after * sizeof(TrieNode*));
+    int* keys = trie_node_keys(node);
+    memmove(keys + i + 1, keys + i, after * sizeof(int));
+    node->children[i] = child;
+    keys[i] = codepoint;
     node->num_children++;
     
     return child;
 }
 
 Trie* trie_create(void) {
+    return trie_create_keyed(TRIE_KEY_CODEPOINT);
+}
+
+Trie* trie_create_keyed(TrieKeyMode key_mode) {
     Trie* trie = (Trie*)malloc(sizeof(Trie));
     if (!trie) return NULL;
     
-    trie->root = trie_node_create();
+    arena_init(&trie->pool);
+    memset(trie->free_blocks, 0, sizeof(trie->free_blocks));
+    trie->root = trie_node_create(trie);
     if (!trie->root) {
+        arena_destroy(&trie->pool);
         free(trie);
         return NULL;
     }
     
     trie->num_words = 0;
+    trie->key_mode = key_mode;
+    trie->next_value = 0;
+    trie->has_values = false;
     return trie;
 }
 
 void trie_add(Trie* trie, const char* word) {
-    if (!trie || !word || !word[0]) return;
+    if (!word) return;
+    
+    trie_add_n(trie, word, strlen(word));
+}
+
+/* Trim surrounding whitespace from a word; false if nothing is left or
+ * it is not valid UTF-8 */
+static bool trie_clean_word(const char** word, size_t* len) {
+    const char* w = *word;
+    size_t n = *len;
     
     /* Trim leading/trailing whitespace */
-    while (*word == ' ' || *word == '\t' || *word == '\r' || *word == '\n') {
-        word++;
+    while (n > 0 && (*w == ' ' || *w == '\t' || *w == '\r' || *w == '\n')) {
+        w++;
+        n--;
+    }
+    
+    while (n > 0 && (w[n-1] == ' ' || w[n-1] == '\t' || 
+                     w[n-1] == '\r' || w[n-1] == '\n')) {
+        n--;
     }
-    if (!*word) return;
+    if (n == 0) return false;
+    
+    const char* ptr = w;
+    const char* end = w + n;
     
-    int len = strlen(word);
-    while (len > 0 && (word[len-1] == ' ' || word[len-1] == '\t' || 
-                       word[len-1] == '\r' || word[len-1] == '\n')) {
-        len--;
+    /* Reject invalid UTF-8 so both keying modes see the same words */
+    while (ptr < end) {
+        int byte_len;
+        if (utf8_is_invalid(utf8_decode_n(ptr, end - ptr, &byte_len))) return false;
+        ptr += byte_len;
     }
-    if (len == 0) return;
     
+    *word = w;
+    *len = n;
+    return true;
+}
+
+/* Find or create the node a cleaned word ends at, or NULL if out of
+ * memory */
+static TrieNode* trie_insert(Trie* trie, const char* word, size_t len) {
     TrieNode* current = trie->root;
     const char* ptr = word;
     const char* end = word + len;
     
     while (ptr < end) {
         int byte_len;
-        int codepoint = get_utf8_codepoint(ptr, &byte_len);
+        int codepoint = trie_next_key(trie, ptr, end - ptr, &byte_len);
         
         TrieNode* child = trie_node_get_child(current, codepoint);
         if (!child) {
-            child = trie_node_add_child(current, codepoint);
-            if (!child) return; /* Out of memory */
+            child = trie_node_add_child(trie, current, codepoint);
+            if (!child) return NULL; /* Out of memory */
         }
         
         current = child;
         ptr += byte_len;
     }
     
-    if (!current->is_end) {
-        current->is_end = true;
+    return current;
+}
+
+bool trie_add_n(Trie* trie, const char* word, size_t len) {
+    if (!trie || !word || len == 0) return false;
+    if (!trie_clean_word(&word, &len)) return false;
+    
+    TrieNode* node = trie_insert(trie, word, len);
+    if (!node) return false;
+    
+    if (!node->is_end) {
+        node->is_end = true;
+        node->value = trie->next_value++;
+        trie->num_words++;
+    }
+    return true;
+}
+
+bool trie_add_value_n(Trie* trie, const char* word, size_t len, uint32_t value) {
+    if (!trie || !word || len == 0) return false;
+    if (!trie_clean_word(&word, &len)) return false;
+    
+    TrieNode* node = trie_insert(trie, word, len);
+    if (!node) return false;
+    
+    if (!node->is_end) {
+        node->is_end = true;
+        trie->num_words++;
+    }
+    node->value = value;
+    trie->has_values = true;
+    return true;
+}
+
+bool trie_remove_n(Trie* trie, const char* word, size_t len) {
+    if (!trie || !word || len == 0) return false;
+    if (!trie_clean_word(&word, &len)) return false;
+    
+    TrieNode* current = trie->root;
+    const char* ptr = word;
+    const char* end = word + len;
+    
+    while (ptr < end) {
+        int byte_len;
+        int codepoint = trie_next_key(trie, ptr, end - ptr, &byte_len);
+        
+        current = trie_node_get_child(current, codepoint);
+        if (!current) return false;
+        
+        ptr += byte_len;
+    }
+    
+    if (!current->is_end) return false;
+    current->is_end = false;
+    trie->num_words--;
+    return true;
+}
+
+typedef struct {
+    const char* word;
+    size_t len;
+    uint32_t value;
+    uint32_t order;   /* Position in the input, to keep the first repeat */
+    bool has_value;   /* Payload given in the input, not numbered */
+} TrieWord;
+
+/* Byte at depth plus one, or 0 past the end, so shorter words sort first */
+static inline int word_byte(const TrieWord* w, size_t depth) {
+    return depth < w->len ? (unsigned char)w->word[depth] + 1 : 0;
+}
+
+/* Byte order, which for UTF-8 is also codepoint order */
+static int compare_word_from(const TrieWord* x, const TrieWord* y, size_t depth) {
+    size_t n = x->len < y->len ? x->len : y->len;
+    int cmp = n > depth ? memcmp(x->word + depth, y->word + depth, n - depth) : 0;
+    if (cmp != 0) return cmp;
+    return (x->len > y->len) - (x->len < y->len);
+}
+
+static inline void swap_words(TrieWord* a, size_t i, size_t j) {
+    TrieWord t = a[i];
+    a[i] = a[j];
+    a[j] = t;
+}
+
+/* Multikey quicksort of words sharing their first depth bytes */
+static void sort_words(TrieWord* a, size_t n, size_t depth) {
+    while (n > 16) {
+        /* Median of three bytes as the pivot */
+        int x = word_byte(&a[0], depth), y = word_byte(&a[n / 2], depth);
+        int z = word_byte(&a[n - 1], depth);
+        int pivot = x < y ? (y < z ? y : (x < z ? z : x)) : (x < z ? x : (y < z ? z : y));
+        
+        /* Partition into < pivot, == pivot, > pivot */
+        size_t lt = 0, i = 0, gt = n;
+        while (i < gt) {
+            int c = word_byte(&a[i], depth);
+            if (c < pivot) {
+                swap_words(a, lt++, i++);
+            } else if (c > pivot) {
+                swap_words(a, i, --gt);
+            } else {
+                i++;
+            }
+        }
+        
+        sort_words(a, lt, depth);
+        sort_words(a + gt, n - gt, depth);
+        
+        /* Equal words need no further sorting */
+        if (pivot == 0) return;
+        a += lt;
+        n = gt - lt;
+        depth++;
+    }
+    
+    for (size_t i = 1; i < n; i++) {
+        TrieWord w = a[i];
+        size_t j = i;
+        while (j > 0 && compare_word_from(&a[j - 1], &w, depth) > 0) {
+            a[j] = a[j - 1];
+            j--;
+        }
+        a[j] = w;
+    }
+}
+
+/* Check whether word continues with the byte_len bytes of key after depth */
+static inline bool same_key(const TrieWord* word, size_t depth, const char* key, int byte_len) {
+    return word->len - depth >= (size_t)byte_len &&
+           memcmp(word->word + depth, key, byte_len) == 0;
+}
+
+/* Build the subtree of node from sorted, distinct words[lo, hi), which
+ * all start with the depth bytes node spells */
+static bool trie_build_range(Trie* trie, TrieNode* node, const TrieWord* words,
+                             size_t lo, size_t hi, size_t depth) {
+    /* The word equal to the prefix, if any, sorts first */
+    if (words[lo].len == depth) {
+        node->is_end = true;
+        node->value = words[lo].value;
         trie->num_words++;
+        if (++lo == hi) return true;
+    }
+    
+    /* Words with the same next key are adjacent; count the groups so the
+     * child array is allocated at its exact size */
+    int k = 0;
+    for (size_t i = lo; i < hi; ) {
+        int byte_len;
+        trie_next_key(trie, words[i].word + depth, words[i].len - depth, &byte_len);
+        const char* key = words[i].word + depth;
+        do {
+            i++;
+        } while (i < hi && same_key(&words[i], depth, key, byte_len));
+        k++;
     }
+    
+    node->children = (TrieNode**)arena_alloc(&trie->pool, k * (sizeof(TrieNode*) + sizeof(int)));
+    if (!node->children) return false;
+    node->capacity = k;
+    
+    for (size_t i = lo; i < hi; ) {
+        int byte_len;
+        int codepoint = trie_next_key(trie, words[i].word + depth, words[i].len - depth, &byte_len);
+        const char* key = words[i].word + depth;
+        size_t group = i;
+        do {
+            i++;
+        } while (i < hi && same_key(&words[i], depth, key, byte_len));
+        
+        TrieNode* child = trie_node_create(trie);
+        if (!child) return false;
+        node->children[node->num_children] = child;
+        trie_node_keys(node)[node->num_children] = codepoint;
+        node->num_children++;
+        
+        if (!trie_build_range(trie, child, words, group, i, depth + (size_t)byte_len)) {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+/* Sort, deduplicate and add n cleaned words, reordering words */
+static int trie_add_cleaned(Trie* trie, TrieWord* words, size_t n) {
+    /* Word lists are often sorted already */
+    size_t i = 1;
+    while (i < n && compare_word_from(&words[i - 1], &words[i], 0) <= 0) i++;
+    if (i < n) sort_words(words, n, 0);
+    
+    /* Drop duplicates, which the sort leaves in any order */
+    size_t distinct = 0;
+    for (i = 0; i < n; i++) {
+        if (distinct == 0 || compare_word_from(&words[distinct - 1], &words[i], 0) != 0) {
+            words[distinct++] = words[i];
+        } else if (words[i].order < words[distinct - 1].order) {
+            words[distinct - 1] = words[i];
+        }
+    }
+    
+    if (distinct > 0 && trie->root->num_children == 0 && !trie->root->is_end) {
+        return trie_build_range(trie, trie->root, words, 0, distinct, 0) ? 0 : -1;
+    }
+    
+    /* Not empty: insert one by one, in order for locality */
+    for (i = 0; i < distinct; i++) {
+        TrieNode* node = trie_insert(trie, words[i].word, words[i].len);
+        if (node && !node->is_end) {
+            node->is_end = true;
+            node->value = words[i].value;
+            trie->num_words++;
+        }
+    }
+    return 0;
+}
+
+int trie_add_words(Trie* trie, const char* const* words, const size_t* lens, size_t count) {
+    if (!trie || (count > 0 && (!words || !lens))) return -1;
+    
+    TrieWord* cleaned = (TrieWord*)malloc((count > 0 ? count : 1) * sizeof(TrieWord));
+    if (!cleaned) return -1;
+    
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        const char* word = words[i];
+        size_t len = lens[i];
+        if (word && len > 0 && trie_clean_word(&word, &len)) {
+            cleaned[n].word = word;
+            cleaned[n].len = len;
+            cleaned[n].value = trie->next_value + (uint32_t)i;
+            cleaned[n].order = (uint32_t)i;
+            cleaned[n].has_value = false;
+            n++;
+        }
+    }
+    
+    int status = trie_add_cleaned(trie, cleaned, n);
+    trie->next_value += (uint32_t)count;
+    free(cleaned);
+    return status;
+}
+
+/* Split a "word<TAB>payload" line; false if it has no valid payload.
+ * UINT32_MAX is reserved as NEWMM_UNKNOWN_ID, so it is not valid. */
+static bool trie_split_value(const char* line, size_t* len, uint32_t* value) {
+    size_t tab = *len;
+    while (tab > 0 && line[tab - 1] != '\t') tab--;
+    if (tab == 0) return false;
+    
+    const char* digit = line + tab;
+    const char* end = line + *len;
+    while (end > digit && end[-1] == ' ') end--;
+    if (digit == end) return false;
+    
+    uint64_t parsed = 0;
+    for (; digit < end; digit++) {
+        if (*digit < '0' || *digit > '9') return false;
+        parsed = parsed * 10 + (uint64_t)(*digit - '0');
+        if (parsed >= UINT32_MAX) return false;
+    }
+    
+    *len = tab - 1;
+    *value = (uint32_t)parsed;
+    return true;
 }
 
 int trie_load_dict(Trie* trie, const char* dict_path) {
     if (!trie || !dict_path) return -1;
     
-    FILE* fp = fopen(dict_path, "r");
+    FILE* fp = fopen(dict_path, "rb");
     if (!fp) return -1;
     
-    char buffer[1024];
-    int count = 0;
-    
-    while (fgets(buffer, sizeof(buffer), fp)) {
-        /* Remove newline */
-        int len = strlen(buffer);
-        if (len > 0 && buffer[len-1] == '\n') {
-            buffer[len-1] = '\0';
-            len--;
-        }
-        if (len > 0 && buffer[len-1] == '\r') {
-            buffer[len-1] = '\0';
-            len--;
+    /* Read the whole file; words are built from slices of it */
+    char* data = NULL;
+    size_t size = 0, capacity = 0;
+    for (;;) {
+        if (size == capacity) {
+            capacity = capacity ? capacity * 2 : 64 * 1024;
+            char* grown = (char*)realloc(data, capacity);
+            if (!grown) {
+                free(data);
+                fclose(fp);
+                return -1;
+            }
+            data = grown;
         }
+        size_t n = fread(data + size, 1, capacity - size, fp);
+        if (n == 0) break;
+        size += n;
+    }
+    fclose(fp);
+    
+    size_t num_lines = 1;
+    for (const char* p = data; (p = (const char*)memchr(p, '\n', size - (p - data))); p++) {
+        num_lines++;
+    }
+    
+    TrieWord* words = (TrieWord*)malloc(num_lines * sizeof(TrieWord));
+    if (!words) {
+        free(data);
+        return -1;
+    }
+    
+    int count = 0;
+    size_t n = 0;
+    bool file_has_values = false;
+    for (size_t start = 0; start < size; ) {
+        const char* line = data + start;
+        const char* newline = (const char*)memchr(line, '\n', size - start);
+        size_t len = newline ? (size_t)(newline - line) : size - start;
+        start += len + 1;
         
+        /* Remove newline */
+        if (len > 0 && line[len-1] == '\r') len--;
         if (len > 0) {
-            trie_add(trie, buffer);
+            uint32_t value = trie->next_value + (uint32_t)count;
+            bool has_value = trie_split_value(line, &len, &value);
+            if (has_value) file_has_values = true;
+            if (trie_clean_word(&line, &len)) {
+                words[n].word = line;
+                words[n].len = len;
+                words[n].value = value;
+                words[n].order = (uint32_t)count;
+                words[n].has_value = has_value;
+                n++;
+            }
             count++;
         }
     }
     
-    fclose(fp);
-    return count;
+    /* Payloads are frequencies or IDs, which line numbers are not: once a
+     * file gives some, the words without one get the neutral payload 0 */
+    if (file_has_values) {
+        trie->has_values = true;
+        for (size_t i = 0; i < n; i++) {
+            if (!words[i].has_value) words[i].value = 0;
+        }
+    }
+    
+    int status = trie_add_cleaned(trie, words, n);
+    trie->next_value += (uint32_t)count;
+    free(words);
+    free(data);
+    return status < 0 ? -1 : count;
 }
 
 int trie_prefixes(Trie* trie, const char* text, char*** prefixes, int** lengths) {
@@ -219,11 +573,12 @@ int trie_prefixes(Trie* trie, const char* text, char*** prefixes, int** lengths)
     int count = 0;
     TrieNode* current = trie->root;
     const char* ptr = text;
+    const char* end = text + strlen(text);
     int byte_pos = 0;
     
-    while (*ptr) {
+    while (ptr < end) {
         int byte_len;
-        int codepoint = get_utf8_codepoint(ptr, &byte_len);
+        int codepoint = trie_next_key(trie, ptr, end - ptr, &byte_len);
         
         TrieNode* child = trie_node_get_child(current, codepoint);
         if (!child) break;
@@ -258,9 +613,114 @@ int trie_prefixes(Trie* trie, const char* text, char*** prefixes, int** lengths)
     return count;
 }
 
+int trie_prefix_ends(const Trie* trie, const char* text, size_t len, int* ends, int max_ends) {
+    if (!trie || !text || !ends || max_ends <= 0) return 0;
+    
+    int count = 0;
+    const TrieNode* current = trie->root;
+    const char* ptr = text;
+    const char* end = text + len;
+    int byte_pos = 0;
+    
+    while (ptr < end) {
+        int byte_len;
+        int codepoint = trie_next_key(trie, ptr, end - ptr, &byte_len);
+        
+        const TrieNode* child = trie_node_get_child(current, codepoint);
+        if (!child) break;
+        
+        byte_pos += byte_len;
+        
+        if (child->is_end) {
+            /* Keep overwriting the last slot once full: longest wins */
+            if (count < max_ends) {
+                ends[count++] = byte_pos;
+            } else {
+                ends[max_ends - 1] = byte_pos;
+            }
+        }
+        
+        current = child;
+        ptr += byte_len;
+    }
+    
+    return count;
+}
+
+bool trie_has_prefix(const Trie* trie, const char* text, size_t len) {
+    if (!trie || !text) return false;
+    
+    const TrieNode* current = trie->root;
+    const char* ptr = text;
+    const char* end = text + len;
+    
+    while (ptr < end) {
+        int byte_len;
+        int codepoint = trie_next_key(trie, ptr, end - ptr, &byte_len);
+        
+        current = trie_node_get_child(current, codepoint);
+        if (!current) return false;
+        if (current->is_end) return true;
+        
+        ptr += byte_len;
+    }
+    
+    return false;
+}
+
+/* Word bytes of the path walked so far */
+typedef struct {
+    char* word;
+    size_t len;
+    size_t capacity;
+} TrieWalk;
+
+static bool trie_walk(const Trie* trie, const TrieNode* node, TrieWalk* walk,
+                      TrieWordFn fn, void* user_data) {
+    if (node->is_end) fn(walk->word, walk->len, node->value, user_data);
+    
+    for (int i = 0; i < node->num_children; i++) {
+        if (walk->capacity - walk->len < 4) {
+            size_t capacity = walk->capacity * 2;
+            char* word = (char*)realloc(walk->word, capacity);
+            if (!word) return false;
+            walk->word = word;
+            walk->capacity = capacity;
+        }
+        
+        int key = trie_node_keys(node)[i];
+        size_t len = walk->len;
+        if (trie->key_mode == TRIE_KEY_BYTE) {
+            walk->word[walk->len++] = (char)key;
+        } else {
+            walk->len += utf8_encode(key, walk->word + walk->len);
+        }
+        if (!trie_walk(trie, node->children[i], walk, fn, user_data)) return false;
+        walk->len = len;
+    }
+    return true;
+}
+
+int trie_for_each_word(const Trie* trie, TrieWordFn fn, void* user_data) {
+    if (!trie || !fn) return -1;
+    
+    TrieWalk walk = {(char*)malloc(64), 0, 64};
+    if (!walk.word) return -1;
+    bool ok = trie_walk(trie, trie->root, &walk, fn, user_data);
+    free(walk.word);
+    return ok ? 0 : -1;
+}
+
+size_t trie_memory_usage(const Trie* trie) {
+    if (!trie) return 0;
+    
+    return sizeof(Trie) + trie->pool.total;
+}
+
 void trie_free(Trie* trie) {
     if (!trie) return;
     
-    trie_node_free(trie->root);
+    /* Nodes and child arrays all live in the pool */
+    arena_destroy(&trie->pool);
     free(trie);
 }
@@ -9,32 +9,129 @@
 #define TRIE_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
 
+/* Upper bound on prefix ends reported per trie_prefix_ends() call; sized
+ * for callers that keep the ends buffer on the stack */
+#define TRIE_MAX_PREFIXES 64
+
+/* Child arrays hold 1, 2, 4, ... entries; a node's array is replaced by
+ * one twice as large when full, and the old one is recycled */
+#define TRIE_SIZE_CLASSES 32
+
+/* What a single trie edge consumes from the text */
+typedef enum {
+    TRIE_KEY_CODEPOINT = 0,  /* One decoded UTF-8 codepoint */
+    TRIE_KEY_BYTE = 1        /* One raw byte, no decoding */
+} TrieKeyMode;
+
+/* Children are sorted by key. The child pointers and then their keys
+ * share one block of capacity entries each. */
 typedef struct TrieNode {
-    bool is_end;
     struct TrieNode** children;
-    int* child_chars;  /* UTF-8 code points of children */
     int num_children;
     int capacity;
+    bool is_end;
+    uint32_t value;   /* Payload of the word ending here */
 } TrieNode;
 
+/* Code points (or bytes) of the children of node */
+static inline int* trie_node_keys(const TrieNode* node) {
+    return (int*)(node->children + node->capacity);
+}
+
+/* Nodes and child arrays are carved from one pool, so building does no
+ * per-node heap allocation and freeing releases a few large blocks */
 typedef struct Trie {
     TrieNode* root;
     int num_words;
+    TrieKeyMode key_mode;
+    uint32_t next_value;   /* Payload of the next word added without one */
+    bool has_values;       /* Some payload was given explicitly */
+    Arena pool;
+    void* free_blocks[TRIE_SIZE_CLASSES];  /* Outgrown child arrays, by size class */
 } Trie;
 
 /**
- * @brief Create a new empty trie
+ * @brief Create a new empty trie keyed on codepoints
  */
 Trie* trie_create(void);
 
+/**
+ * @brief Create a new empty trie with the given keying mode
+ * 
+ * Both modes give identical lookup results: words must be valid UTF-8,
+ * and valid UTF-8 is prefix-free, so a byte-level match always ends on a
+ * character boundary.
+ */
+Trie* trie_create_keyed(TrieKeyMode key_mode);
+
 /**
  * @brief Add a word to the trie
+ * 
+ * Leading/trailing whitespace is trimmed. Words that are not valid UTF-8
+ * are ignored.
  */
 void trie_add(Trie* trie, const char* word);
 
+/**
+ * @brief Add the len bytes at word to the trie
+ * 
+ * Same as trie_add(), but word need not be NUL-terminated. A new word gets
+ * next_value as its payload, so by default words are numbered in the
+ * order they are added; a word already present keeps its payload.
+ * 
+ * @return true if the word is in the trie afterwards
+ */
+bool trie_add_n(Trie* trie, const char* word, size_t len);
+
+/**
+ * @brief Add the len bytes at word to the trie with the given payload
+ * 
+ * Same as trie_add_n(), but the payload is set even if the word was
+ * already present.
+ * 
+ * @return true if the word is in the trie afterwards
+ */
+bool trie_add_value_n(Trie* trie, const char* word, size_t len, uint32_t value);
+
+/**
+ * @brief Remove the len bytes at word from the trie
+ * 
+ * The word is trimmed and validated as in trie_add_n(). Its nodes stay
+ * in the trie; only the word end is cleared.
+ * 
+ * @return true if the word was in the trie
+ */
+bool trie_remove_n(Trie* trie, const char* word, size_t len);
+
+/**
+ * @brief Add many words at once
+ * 
+ * Words are trimmed and validated as in trie_add_n(), sorted and
+ * deduplicated. An empty trie is then built in a single pass with child
+ * arrays of exact size; otherwise the words are inserted in sorted order.
+ * Each word's payload is next_value plus its index in words; a repeated
+ * word keeps that of its first occurrence.
+ * 
+ * @param words Word pointers, need not be NUL-terminated
+ * @param lens Byte length of each word
+ * @param count Number of words
+ * @return 0 on success, -1 on error
+ */
+int trie_add_words(Trie* trie, const char* const* words, const size_t* lens, size_t count);
+
 /**
  * @brief Load words from a dictionary file
+ * 
+ * Each line holds a word, optionally followed by a tab and a decimal
+ * 32-bit payload below UINT32_MAX. In a file without payloads, words get
+ * the index of their line among the non-empty lines, as added by
+ * trie_add_words(); once any line has one, words without one get 0.
+ * 
+ * @return Number of non-empty lines read, or -1 on error
  */
 int trie_load_dict(Trie* trie, const char* dict_path);
 
@@ -49,6 +146,50 @@ int trie_load_dict(Trie* trie, const char* dict_path);
  */
 int trie_prefixes(Trie* trie, const char* text, char*** prefixes, int** lengths);
 
+/**
+ * @brief Get the end offsets of all word prefixes of text without allocating
+ * 
+ * Byte lengths of the matching prefixes are written to ends in increasing
+ * order. If more than max_ends prefixes match, the last slot is overwritten
+ * so the longest match is always reported.
+ * 
+ * @param trie The trie structure
+ * @param text Input text (UTF-8), need not be NUL-terminated
+ * @param len Length of text in bytes
+ * @param ends Caller-provided output array of prefix byte lengths
+ * @param max_ends Capacity of ends (at least 1)
+ * @return Number of prefix lengths written to ends
+ */
+int trie_prefix_ends(const Trie* trie, const char* text, size_t len, int* ends, int max_ends);
+
+/**
+ * @brief Check whether any word in the trie is a prefix of the len bytes at text
+ * 
+ * Stops at the first match, so it is cheaper than trie_prefix_ends()
+ * when only existence matters.
+ */
+bool trie_has_prefix(const Trie* trie, const char* text, size_t len);
+
+/* Called with each word of a trie, which is not NUL-terminated */
+typedef void (*TrieWordFn)(const char* word, size_t len, uint32_t value, void* user_data);
+
+/**
+ * @brief Call fn with every word in the trie and its payload
+ * 
+ * Words come in key order. The word bytes are only valid during the call.
+ * 
+ * @return 0 on success, -1 if out of memory
+ */
+int trie_for_each_word(const Trie* trie, TrieWordFn fn, void* user_data);
+
+/**
+ * @brief Heap bytes requested for the trie nodes and child arrays
+ * 
+ * This is the size of the node pool, including recycled and unused
+ * space in it. Allocator per-chunk overhead is not included.
+ */
+size_t trie_memory_usage(const Trie* trie);
+
 /**
  * @brief Free trie memory
  */
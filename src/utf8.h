@@ -0,0 +1,118 @@
+/**
+ * @file utf8.h
+ * @brief Shared UTF-8 decoding helpers
+ *
+ * Internal header. Decoding is strict: overlong forms, surrogates and
+ * truncated sequences are rejected, and each offending byte decodes on its
+ * own to UTF8_INVALID_BASE + byte. Decoding therefore never reads past a
+ * NUL terminator, and two byte strings decode to the same codepoints only
+ * if they are identical.
+ */
+
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Invalid bytes 0x80-0xFF decode to U+DC80-U+DCFF, which valid UTF-8
+ * can never produce */
+#define UTF8_INVALID_BASE 0xDC00
+
+static inline bool utf8_is_cont(unsigned char c) {
+    return (c & 0xC0) == 0x80;
+}
+
+static inline bool utf8_is_invalid(int codepoint) {
+    return codepoint >= UTF8_INVALID_BASE + 0x80 && codepoint <= UTF8_INVALID_BASE + 0xFF;
+}
+
+/* Decode one codepoint from str, storing its byte length in byte_len */
+static inline int utf8_decode(const char* str, int* byte_len) {
+    const unsigned char* s = (const unsigned char*)str;
+    unsigned char c = s[0];
+
+    if (c < 0x80) {
+        *byte_len = 1;
+        return c;
+    }
+
+    /* Thai block fast path: E0 B8 xx / E0 B9 xx */
+    if (c == 0xE0 && (s[1] & 0xFE) == 0xB8 && utf8_is_cont(s[2])) {
+        *byte_len = 3;
+        return 0x0E00 | ((s[1] & 0x01) << 6) | (s[2] & 0x3F);
+    }
+
+    if (c >= 0xC2 && c <= 0xDF) {
+        if (utf8_is_cont(s[1])) {
+            *byte_len = 2;
+            return ((c & 0x1F) << 6) | (s[1] & 0x3F);
+        }
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        unsigned char lo = (c == 0xE0) ? 0xA0 : 0x80;
+        unsigned char hi = (c == 0xED) ? 0x9F : 0xBF;
+        if (s[1] >= lo && s[1] <= hi && utf8_is_cont(s[2])) {
+            *byte_len = 3;
+            return ((c & 0x0F) << 12) | ((s[1] & 0x3F) << 6) | (s[2] & 0x3F);
+        }
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        unsigned char lo = (c == 0xF0) ? 0x90 : 0x80;
+        unsigned char hi = (c == 0xF4) ? 0x8F : 0xBF;
+        if (s[1] >= lo && s[1] <= hi && utf8_is_cont(s[2]) && utf8_is_cont(s[3])) {
+            *byte_len = 4;
+            return ((c & 0x07) << 18) | ((s[1] & 0x3F) << 12) |
+                   ((s[2] & 0x3F) << 6) | (s[3] & 0x3F);
+        }
+    }
+
+    /* Invalid or truncated sequence: consume a single byte */
+    *byte_len = 1;
+    return UTF8_INVALID_BASE + c;
+}
+
+/* Number of bytes in the UTF-8 encoding of a valid codepoint */
+static inline int utf8_encoded_len(int codepoint) {
+    if (codepoint < 0x80) return 1;
+    if (codepoint < 0x800) return 2;
+    if (codepoint < 0x10000) return 3;
+    return 4;
+}
+
+/* Write the UTF-8 encoding of a valid codepoint to out; returns its
+ * byte length */
+static inline int utf8_encode(int codepoint, char* out) {
+    unsigned char* s = (unsigned char*)out;
+    if (codepoint < 0x80) {
+        s[0] = (unsigned char)codepoint;
+        return 1;
+    }
+    if (codepoint < 0x800) {
+        s[0] = (unsigned char)(0xC0 | (codepoint >> 6));
+        s[1] = (unsigned char)(0x80 | (codepoint & 0x3F));
+        return 2;
+    }
+    if (codepoint < 0x10000) {
+        s[0] = (unsigned char)(0xE0 | (codepoint >> 12));
+        s[1] = (unsigned char)(0x80 | ((codepoint >> 6) & 0x3F));
+        s[2] = (unsigned char)(0x80 | (codepoint & 0x3F));
+        return 3;
+    }
+    s[0] = (unsigned char)(0xF0 | (codepoint >> 18));
+    s[1] = (unsigned char)(0x80 | ((codepoint >> 12) & 0x3F));
+    s[2] = (unsigned char)(0x80 | ((codepoint >> 6) & 0x3F));
+    s[3] = (unsigned char)(0x80 | (codepoint & 0x3F));
+    return 4;
+}
+
+/* Decode one codepoint from a buffer that may end before the sequence
+ * does; a sequence cut off at the end decodes as invalid bytes */
+static inline int utf8_decode_n(const char* str, size_t avail, int* byte_len) {
+    if (avail >= 4) return utf8_decode(str, byte_len);
+
+    char buf[4] = {0, 0, 0, 0};
+    memcpy(buf, str, avail);
+    return utf8_decode(buf, byte_len);
+}
+
+#endif /* UTF8_H */
@@ -0,0 +1,1089 @@
+/**
+ * @file fuzz_newmm.c
+ * @brief Differential fuzzing of every segmentation path against the reference
+ *
+ * The greedy reference is a naive newmm written out here: at every
+ * position a fresh trie_prefix_ends() on the mutable trie, kept where it
+ * ends on a scalar TCC boundary, and runs of non-Thai characters grouped
+ * by codepoint, with no prefix memo and no ASCII fast path. segment_text()
+ * must match it. For the graph and weighted engines, which have no naive
+ * counterpart, the reference is their output on a codepoint-keyed compact
+ * trie with the scalar TCC scanner. Lookups are checked against
+ * trie_prefixes() / trie_prefix_ends() on the mutable trie. Each input is
+ * also run through every other layout and entry point, which must give
+ * identical results:
+ *
+ *   greedy   - segment_text() against the naive reference
+ *   tcc      - every TCC scanner the CPU supports
+ *   prefixes - byte-keyed, binary (mapped), compiled-image and overlay tries
+ *   engines  - greedy, graph and weighted on each of those tries, and
+ *              the greedy word IDs of the words the naive reference matched
+ *   api      - newmm_segment_spans() with full and short capacity, parallel,
+ *              context, batch, span cache, word IDs, token strings and
+ *              streams fed in random pieces
+ *
+ * The dictionary gets a few words starting with ASCII characters on top of
+ * the word list, so ASCII runs meet dictionary matches; a fixed corpus of
+ * such runs mixed with words is checked before the generated inputs. The
+ * overlay trie is built from a base missing some words and holding some
+ * extra ones, which the overlay adds and removes again.
+ *
+ * By default a fixed-seed regression run over generated inputs: sentences
+ * of dictionary words, ASCII runs abutting ASCII-initial words, random
+ * codepoints, invalid UTF-8, slices of the corpus files given and
+ * mutations of all of these:
+ *
+ *   fuzz_newmm [--seed N] [--iterations N] [--input FILE] dict_path [corpus...]
+ *
+ * --input checks only the bytes of FILE, for replaying a failure or
+ * running under AFL (`afl-fuzz -i in -o out -- ./fuzz_newmm --input @@ dict`).
+ * Built with -DNEWMM_LIBFUZZER it is a libFuzzer target instead, reading
+ * its dictionary from $NEWMM_FUZZ_DICT (data/thai_words.txt by default);
+ * see the fuzz target of the Makefile.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/newmm.h"
+#include "../src/datrie.h"
+#include "../src/segment.h"
+#include "../src/tcc.h"
+#include "../src/trie.h"
+#include "../src/utf8.h"
+
+#define FUZZ_BINARY_PATH "build/fuzz_newmm.dict"
+#define FUZZ_MAX_INPUT (64 * 1024)
+#define FUZZ_LONG_INPUT (40 * 1024)   /* Above the parallel split threshold */
+#define FUZZ_PREFIX_BYTES 4096        /* Offsets checked by lookups per input */
+#define FUZZ_SHORT_CAPACITY 7
+#define FUZZ_REPORT_BYTES 256
+
+/* Words starting with ASCII characters, which the word list lacks, so
+ * ASCII runs meet dictionary matches */
+static const char* const extra_words[] = {
+    "hello", "abc", "a1", "ok", "ไปok", "x", "eสปอร์ต", "3มิติ", "1.5", "..", "A4", "-ไป"
+};
+#define NUM_EXTRA_WORDS (sizeof(extra_words) / sizeof(extra_words[0]))
+
+typedef struct {
+    char* data;
+    size_t len;
+    size_t capacity;
+} Bytes;
+
+typedef struct {
+    const char* name;
+    newmm_dict_t dict;
+} Variant;
+
+typedef struct {
+    /* Word list, also the source of generated sentences */
+    char* word_data;
+    char** words;
+    size_t num_words;
+    
+    Trie* ref_trie;
+    Trie* byte_trie;
+    DATrie* ref;
+    DAImage image;
+    
+    newmm_dict_t bytes_dict;
+    newmm_dict_t binary_dict;
+    newmm_dict_t image_dict;
+    newmm_dict_t overlay_base;
+    newmm_overlay_t* overlay;
+    newmm_dict_t overlay_dict;
+    Variant variants[4];
+    int num_variants;
+    
+    newmm_ctx_t* ctx;
+    newmm_span_cache_t* cache;
+    
+    Bytes* corpus;
+    int num_corpus;
+} Fixture;
+
+static Fixture fx;
+static long checks = 0;
+static long failures = 0;
+
+/* xorshift64*, fixed so runs with the same seed see the same inputs */
+static uint64_t rng_next(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+static size_t rng_below(uint64_t* state, size_t n) {
+    return n > 0 ? (size_t)(rng_next(state) % n) : 0;
+}
+
+static bool bytes_reserve(Bytes* b, size_t extra) {
+    if (b->len + extra + 1 <= b->capacity) return true;
+    
+    size_t capacity = b->capacity < 256 ? 256 : b->capacity;
+    while (capacity < b->len + extra + 1) capacity *= 2;
+    char* data = (char*)realloc(b->data, capacity);
+    if (!data) return false;
+    b->data = data;
+    b->capacity = capacity;
+    return true;
+}
+
+static void bytes_append(Bytes* b, const void* data, size_t len) {
+    if (!bytes_reserve(b, len)) return;
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+    b->data[b->len] = '\0';
+}
+
+static void bytes_append_cp(Bytes* b, uint32_t cp) {
+    unsigned char out[4];
+    size_t n;
+    if (cp < 0x80) {
+        out[0] = (unsigned char)cp;
+        n = 1;
+    } else if (cp < 0x800) {
+        out[0] = (unsigned char)(0xC0 | (cp >> 6));
+        out[1] = (unsigned char)(0x80 | (cp & 0x3F));
+        n = 2;
+    } else if (cp < 0x10000) {
+        out[0] = (unsigned char)(0xE0 | (cp >> 12));
+        out[1] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (unsigned char)(0x80 | (cp & 0x3F));
+        n = 3;
+    } else {
+        out[0] = (unsigned char)(0xF0 | (cp >> 18));
+        out[1] = (unsigned char)(0x80 | ((cp >> 12) & 0x3F));
+        out[2] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+        out[3] = (unsigned char)(0x80 | (cp & 0x3F));
+        n = 4;
+    }
+    bytes_append(b, out, n);
+}
+
+static bool read_file(const char* path, Bytes* out) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return false;
+    
+    char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+        bytes_append(out, chunk, n);
+    }
+    fclose(fp);
+    return out->data != NULL;
+}
+
+/* ---- Reporting ---- */
+
+static void report(const char* what, const char* text, size_t len, const char* detail) {
+    failures++;
+    fprintf(stderr, "❌ MISMATCH in %s: %s\n", what, detail);
+    fprintf(stderr, "   input (%zu bytes): \"", len);
+    for (size_t i = 0; i < len && i < FUZZ_REPORT_BYTES; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c >= 0x20 && c < 0x7F && c != '"' && c != '\\') {
+            fputc(c, stderr);
+        } else {
+            fprintf(stderr, "\\x%02x", c);
+        }
+    }
+    fprintf(stderr, "%s\"\n", len > FUZZ_REPORT_BYTES ? "..." : "");
+#ifdef NEWMM_LIBFUZZER
+    abort();
+#endif
+}
+
+/* Compare count spans against the expected ones; count is what the call
+ * returned and only the first filled spans were written */
+static bool check_spans(const char* what, const char* text, size_t len, const SpanBuffer* expected,
+                        const int32_t* starts, const int32_t* ends, int count, int filled) {
+    checks++;
+    char detail[128];
+    if (count != expected->count) {
+        snprintf(detail, sizeof(detail), "%d tokens, expected %d", count, expected->count);
+        report(what, text, len, detail);
+        return false;
+    }
+    
+    for (int i = 0; i < filled && i < count; i++) {
+        if (starts[i] != expected->starts[i] || ends[i] != expected->ends[i]) {
+            snprintf(detail, sizeof(detail), "token %d is [%d, %d), expected [%d, %d)",
+                     i, starts[i], ends[i], expected->starts[i], expected->ends[i]);
+            report(what, text, len, detail);
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Spans must be non-empty and tile the whole text */
+static void check_cover(const char* what, const char* text, size_t len, const SpanBuffer* spans) {
+    checks++;
+    int32_t pos = 0;
+    for (int i = 0; i < spans->count; i++) {
+        if (spans->starts[i] != pos || spans->ends[i] <= pos) {
+            char detail[96];
+            snprintf(detail, sizeof(detail), "token %d is [%d, %d) after offset %d",
+                     i, spans->starts[i], spans->ends[i], pos);
+            report(what, text, len, detail);
+            return;
+        }
+        pos = spans->ends[i];
+    }
+    if ((size_t)pos != len) report(what, text, len, "tokens do not reach the end of the text");
+}
+
+/* ---- Setup ---- */
+
+static bool load_words(const char* path) {
+    Bytes file = {0};
+    if (!read_file(path, &file)) return false;
+    
+    size_t lines = 1;
+    for (size_t i = 0; i < file.len; i++) {
+        if (file.data[i] == '\n') lines++;
+    }
+    fx.words = (char**)malloc(lines * sizeof(char*));
+    if (!fx.words) {
+        free(file.data);
+        return false;
+    }
+    
+    /* Split in place, dropping payloads and carriage returns */
+    for (char* line = strtok(file.data, "\n"); line; line = strtok(NULL, "\n")) {
+        line[strcspn(line, "\t\r")] = '\0';
+        if (line[0] != '\0') fx.words[fx.num_words++] = line;
+    }
+    fx.word_data = file.data;
+    return fx.num_words > 0;
+}
+
+static Trie* build_trie(const char* path, TrieKeyMode key_mode) {
+    Trie* trie = trie_create_keyed(key_mode);
+    if (!trie) return NULL;
+    if (trie_load_dict(trie, path) < 0) {
+        trie_free(trie);
+        return NULL;
+    }
+    for (size_t i = 0; i < NUM_EXTRA_WORDS; i++) {
+        trie_add(trie, extra_words[i]);
+    }
+    return trie;
+}
+
+/* Same words as the reference: a base missing every 11th word and holding
+ * joined word pairs that are not words, with an overlay undoing both */
+static bool build_overlay(void) {
+    Trie* base = trie_create();
+    if (!base) return false;
+    for (size_t i = 0; i < fx.num_words; i++) {
+        if (i % 11 != 5) trie_add(base, fx.words[i]);
+    }
+    
+    char joined[512];
+    for (size_t i = 3; i + 1 < fx.num_words; i += 17) {
+        size_t a = strlen(fx.words[i]);
+        size_t b = strlen(fx.words[i + 1]);
+        if (a + b >= sizeof(joined)) continue;
+        memcpy(joined, fx.words[i], a);
+        memcpy(joined + a, fx.words[i + 1], b + 1);
+        if (!datrie_word_value(fx.ref, joined, a + b, NULL)) trie_add(base, joined);
+    }
+    fx.overlay_base = (newmm_dict_t)datrie_build(base);
+    if (!fx.overlay_base) {
+        trie_free(base);
+        return false;
+    }
+    
+    fx.overlay = newmm_overlay_create(fx.overlay_base);
+    if (!fx.overlay) {
+        trie_free(base);
+        return false;
+    }
+    for (size_t i = 5; i < fx.num_words; i += 11) {
+        newmm_overlay_add(fx.overlay, fx.words[i]);
+    }
+    for (size_t i = 0; i < NUM_EXTRA_WORDS; i++) {
+        newmm_overlay_add(fx.overlay, extra_words[i]);
+    }
+    for (size_t i = 3; i + 1 < fx.num_words; i += 17) {
+        size_t a = strlen(fx.words[i]);
+        size_t b = strlen(fx.words[i + 1]);
+        if (a + b >= sizeof(joined)) continue;
+        memcpy(joined, fx.words[i], a);
+        memcpy(joined + a, fx.words[i + 1], b + 1);
+        if (!datrie_word_value(fx.ref, joined, a + b, NULL)) newmm_overlay_remove(fx.overlay, joined);
+    }
+    trie_free(base);
+    fx.overlay_dict = newmm_overlay_build(fx.overlay);
+    return fx.overlay_dict != NULL;
+}
+
+static bool fixture_setup(const char* dict_path) {
+    if (!load_words(dict_path)) {
+        fprintf(stderr, "Cannot read word list %s\n", dict_path);
+        return false;
+    }
+    
+    fx.ref_trie = build_trie(dict_path, TRIE_KEY_CODEPOINT);
+    fx.byte_trie = build_trie(dict_path, TRIE_KEY_BYTE);
+    if (!fx.ref_trie || !fx.byte_trie) return false;
+    fx.ref = datrie_build(fx.ref_trie);
+    fx.bytes_dict = (newmm_dict_t)datrie_build(fx.byte_trie);
+    if (!fx.ref || !fx.bytes_dict) return false;
+    
+    if (newmm_save_dict_binary((newmm_dict_t)fx.ref, FUZZ_BINARY_PATH) != 0) {
+        fprintf(stderr, "Cannot write %s\n", FUZZ_BINARY_PATH);
+        return false;
+    }
+    fx.binary_dict = newmm_load_dict_mmap(FUZZ_BINARY_PATH);
+    remove(FUZZ_BINARY_PATH);
+    
+    /* What datrie_save_source() would compile in, over the same arrays */
+    DAImage* image = &fx.image;
+    image->units = fx.ref->units;
+    image->num_units = fx.ref->num_units;
+    image->num_words = fx.ref->num_words;
+    image->key_mode = fx.ref->key_mode;
+    memcpy(image->ascii_labels, fx.ref->ascii_labels, sizeof(image->ascii_labels));
+    memcpy(image->thai_labels, fx.ref->thai_labels, sizeof(image->thai_labels));
+    image->ext_cps = fx.ref->ext_cps;
+    image->ext_labels = fx.ref->ext_labels;
+    image->num_ext = fx.ref->num_ext;
+    image->num_labels = fx.ref->num_labels;
+    image->max_word_bytes = fx.ref->max_word_bytes;
+    image->values = fx.ref->values;
+    image->has_values = fx.ref->has_values;
+    image->value_total = fx.ref->value_total;
+    fx.image_dict = (newmm_dict_t)datrie_from_image(image);
+    
+    if (!fx.binary_dict || !fx.image_dict || !build_overlay()) return false;
+    
+    fx.variants[fx.num_variants++] = (Variant){"bytes", fx.bytes_dict};
+    fx.variants[fx.num_variants++] = (Variant){"binary", fx.binary_dict};
+    fx.variants[fx.num_variants++] = (Variant){"image", fx.image_dict};
+    fx.variants[fx.num_variants++] = (Variant){"overlay", fx.overlay_dict};
+    
+    fx.ctx = newmm_ctx_create();
+    fx.cache = newmm_span_cache_create(1024, 0);
+    return fx.ctx && fx.cache;
+}
+
+static void fixture_teardown(void) {
+    newmm_span_cache_free(fx.cache);
+    newmm_ctx_free(fx.ctx);
+    newmm_free_dict(fx.overlay_dict);
+    newmm_overlay_free(fx.overlay);
+    newmm_free_dict(fx.overlay_base);
+    newmm_free_dict(fx.image_dict);
+    newmm_free_dict(fx.binary_dict);
+    newmm_free_dict(fx.bytes_dict);
+    datrie_free(fx.ref);
+    trie_free(fx.byte_trie);
+    trie_free(fx.ref_trie);
+    for (int i = 0; i < fx.num_corpus; i++) {
+        free(fx.corpus[i].data);
+    }
+    free(fx.corpus);
+    free(fx.words);
+    free(fx.word_data);
+}
+
+/* ---- Checks ---- */
+
+/* Every scanner must mark the same cluster boundaries as the scalar one */
+static void check_tcc(const char* text, size_t len, const uint64_t* expected) {
+    static const TccImpl impls[] = {TCC_IMPL_SSE2, TCC_IMPL_AVX2, TCC_IMPL_NEON};
+    static const char* const names[] = {"tcc sse2", "tcc avx2", "tcc neon"};
+    uint64_t* bitmap = (uint64_t*)calloc(TCC_BITMAP_WORDS(len), sizeof(uint64_t));
+    if (!bitmap) return;
+    
+    for (size_t k = 0; k < sizeof(impls) / sizeof(impls[0]); k++) {
+        if (!tcc_set_impl(impls[k])) continue;
+        
+        checks++;
+        tcc_boundaries_into(text, (int)len, bitmap);
+        for (size_t pos = 0; pos <= len; pos++) {
+            if (tcc_is_boundary(bitmap, (int)pos) != tcc_is_boundary(expected, (int)pos)) {
+                char detail[64];
+                snprintf(detail, sizeof(detail), "boundary differs at byte %zu", pos);
+                report(names[k], text, len, detail);
+                break;
+            }
+        }
+    }
+    tcc_set_impl(TCC_IMPL_AUTO);
+    free(bitmap);
+}
+
+static void check_prefix_ends(const char* what, const char* text, size_t len, size_t pos,
+                              const int* expected, int expected_count, const int* ends, int count) {
+    checks++;
+    if (count == expected_count && memcmp(ends, expected, (size_t)count * sizeof(int)) == 0) return;
+    
+    char detail[96];
+    snprintf(detail, sizeof(detail), "%d prefixes at byte %zu, expected %d", count, pos,
+             expected_count);
+    report(what, text, len, detail);
+}
+
+/* Prefix lookups of every trie agree with the mutable reference trie */
+static void check_prefixes(const char* text, size_t len) {
+    size_t limit = len < FUZZ_PREFIX_BYTES ? len : FUZZ_PREFIX_BYTES;
+    char* copy = (char*)malloc(limit + 1);
+    if (!copy) return;
+    memcpy(copy, text, limit);
+    copy[limit] = '\0';
+    
+    int expected[TRIE_MAX_PREFIXES];
+    int ends[TRIE_MAX_PREFIXES];
+    for (size_t pos = 0; pos < limit; pos++) {
+        const char* at = text + pos;
+        size_t rest = len - pos;
+        int n = trie_prefix_ends(fx.ref_trie, at, rest, expected, TRIE_MAX_PREFIXES);
+        
+        int count = trie_prefix_ends(fx.byte_trie, at, rest, ends, TRIE_MAX_PREFIXES);
+        check_prefix_ends("trie bytes", text, len, pos, expected, n, ends, count);
+        count = datrie_prefix_ends(fx.ref, at, rest, ends, TRIE_MAX_PREFIXES);
+        check_prefix_ends("datrie", text, len, pos, expected, n, ends, count);
+        if (datrie_has_prefix(fx.ref, at, rest) != (n > 0)) {
+            report("datrie has_prefix", text, len, "disagrees with prefix ends");
+        }
+        for (int v = 0; v < fx.num_variants; v++) {
+            const DATrie* da = (const DATrie*)fx.variants[v].dict;
+            count = datrie_prefix_ends(da, at, rest, ends, TRIE_MAX_PREFIXES);
+            check_prefix_ends(fx.variants[v].name, text, len, pos, expected, n, ends, count);
+            if (datrie_has_prefix(da, at, rest) != (n > 0)) {
+                report(fx.variants[v].name, text, len, "has_prefix disagrees with prefix ends");
+            }
+        }
+        
+        /* The original string API stops at a NUL; compare up to it */
+        char** prefixes = NULL;
+        int* lengths = NULL;
+        int legacy = trie_prefixes(fx.ref_trie, copy + pos, &prefixes, &lengths);
+        size_t nul_len = strlen(copy + pos);
+        n = trie_prefix_ends(fx.ref_trie, copy + pos, nul_len, expected, TRIE_MAX_PREFIXES);
+        for (int i = 0; i < legacy; i++) {
+            if (i < TRIE_MAX_PREFIXES) ends[i] = lengths[i];
+            if (strlen(prefixes[i]) != (size_t)lengths[i] ||
+                memcmp(prefixes[i], copy + pos, (size_t)lengths[i]) != 0) {
+                report("trie_prefixes", text, len, "prefix string does not match its length");
+            }
+            free(prefixes[i]);
+        }
+        free(prefixes);
+        free(lengths);
+        if (legacy <= TRIE_MAX_PREFIXES) {
+            check_prefix_ends("trie_prefixes", text, len, pos, expected, n, ends, legacy);
+        }
+    }
+    free(copy);
+}
+
+typedef struct {
+    SpanBuffer spans;
+    const char* text;
+    size_t len;
+    bool ok;
+} StreamSink;
+
+static void on_stream_token(const char* token, size_t len, size_t offset, void* user_data) {
+    StreamSink* sink = (StreamSink*)user_data;
+    if (offset + len > sink->len || memcmp(token, sink->text + offset, len) != 0) sink->ok = false;
+    span_push(&sink->spans, (int)offset, (int)(offset + len), NEWMM_UNKNOWN_ID);
+}
+
+/* Feed the text in random pieces, or one byte at a time when max_piece is 1 */
+static void check_stream(const char* what, newmm_dict_t dict, const char* text, size_t len,
+                         const SpanBuffer* expected, uint64_t* rng, size_t max_piece) {
+    StreamSink sink = {{NULL, NULL, NULL, 0, 0, true, NULL}, text, len, true};
+    newmm_stream_t* stream = newmm_stream_create(dict, on_stream_token, &sink);
+    if (!stream) {
+        report(what, text, len, "stream could not be created");
+        return;
+    }
+    
+    int status = 0;
+    for (size_t pos = 0; pos < len && status == 0;) {
+        size_t piece = 1 + rng_below(rng, max_piece);
+        if (piece > len - pos) piece = len - pos;
+        status = newmm_stream_feed(stream, text + pos, piece);
+        pos += piece;
+    }
+    if (status == 0) status = newmm_stream_finish(stream);
+    newmm_stream_free(stream);
+    
+    if (status != 0 || !sink.ok) {
+        report(what, text, len, status != 0 ? "stream call failed" : "token bytes differ");
+    } else {
+        check_spans(what, text, len, expected, sink.spans.starts, sink.spans.ends,
+                    sink.spans.count, sink.spans.count);
+    }
+    free(sink.spans.starts);
+    free(sink.spans.ends);
+}
+
+/* Token strings must be the bytes of the spans */
+static void check_tokens(const char* what, const char* text, size_t len, const SpanBuffer* expected,
+                         char** tokens, int token_count) {
+    checks++;
+    if (token_count != expected->count) {
+        char detail[64];
+        snprintf(detail, sizeof(detail), "%d tokens, expected %d", token_count, expected->count);
+        report(what, text, len, detail);
+        return;
+    }
+    for (int i = 0; i < token_count; i++) {
+        size_t n = (size_t)(expected->ends[i] - expected->starts[i]);
+        if (!tokens || !tokens[i] || strlen(tokens[i]) != n ||
+            memcmp(tokens[i], text + expected->starts[i], n) != 0) {
+            char detail[64];
+            snprintf(detail, sizeof(detail), "token %d differs", i);
+            report(what, text, len, detail);
+            return;
+        }
+    }
+}
+
+/* Word IDs of the count spans of expected must be payloads in dict of
+ * words the engine matched. Where expected has IDs, they tell which spans
+ * those are; otherwise a span that is a word may carry its payload. */
+static void check_ids(const char* what, const char* text, size_t len, newmm_dict_t dict,
+                      const SpanBuffer* expected, const uint32_t* ids, int count) {
+    checks++;
+    for (int i = 0; i < count; i++) {
+        uint32_t value;
+        bool word = datrie_word_value((const DATrie*)dict, text + expected->starts[i],
+                                      (size_t)(expected->ends[i] - expected->starts[i]), &value);
+        bool matched = expected->ids ? expected->ids[i] != NEWMM_UNKNOWN_ID : ids[i] != NEWMM_UNKNOWN_ID;
+        if (matched && !word) {
+            report(what, text, len, "word ID given to a token that is not a word");
+            return;
+        }
+        if (ids[i] != (matched ? value : NEWMM_UNKNOWN_ID)) {
+            char detail[96];
+            snprintf(detail, sizeof(detail), "token %d has word ID %u, expected %u", i,
+                     (unsigned)ids[i], (unsigned)(matched ? value : NEWMM_UNKNOWN_ID));
+            report(what, text, len, detail);
+            return;
+        }
+    }
+}
+
+/* Every public entry point on the reference dictionary; greedy carries
+ * the word IDs of the naive reference */
+static void check_api(const char* text, size_t len, const SpanBuffer* greedy,
+                      const SpanBuffer* graph, const SpanBuffer* weighted, uint64_t* rng) {
+    size_t capacity = (size_t)greedy->count + 1;
+    int32_t* starts = (int32_t*)malloc(capacity * sizeof(int32_t));
+    int32_t* ends = (int32_t*)malloc(capacity * sizeof(int32_t));
+    uint32_t* ids = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    if (!starts || !ends || !ids) {
+        free(starts);
+        free(ends);
+        free(ids);
+        return;
+    }
+    newmm_dict_t dict = (newmm_dict_t)fx.ref;
+    int filled = (int)capacity;
+    
+    int count = newmm_segment_spans(text, len, dict, starts, ends, capacity);
+    check_spans("newmm_segment_spans", text, len, greedy, starts, ends, count, filled);
+    
+    count = newmm_segment_spans(text, len, dict, starts, ends, FUZZ_SHORT_CAPACITY);
+    check_spans("short capacity", text, len, greedy, starts, ends, count, FUZZ_SHORT_CAPACITY);
+    
+    count = newmm_segment_spans_parallel(text, len, dict, 3, starts, ends, capacity);
+    check_spans("parallel", text, len, greedy, starts, ends, count, filled);
+    
+    count = newmm_segment_ids(text, len, dict, NEWMM_ENGINE_GREEDY, starts, ends, ids, capacity);
+    if (check_spans("segment_ids", text, len, greedy, starts, ends, count, filled)) {
+        check_ids("segment_ids", text, len, dict, greedy, ids, count);
+    }
+    count = newmm_segment_ids(text, len, dict, NEWMM_ENGINE_GRAPH, starts, ends, ids, capacity);
+    if (check_spans("segment_ids graph", text, len, graph, starts, ends, count, filled)) {
+        check_ids("segment_ids graph", text, len, dict, graph, ids, count);
+    }
+    count = newmm_segment_ids(text, len, dict, NEWMM_ENGINE_WEIGHTED, starts, ends, ids, capacity);
+    if (check_spans("segment_ids weighted", text, len, weighted, starts, ends, count, filled)) {
+        check_ids("segment_ids weighted", text, len, dict, weighted, ids, count);
+    }
+    
+    /* A miss, then a hit that must return the same spans */
+    for (int pass = 0; pass < 2; pass++) {
+        count = newmm_span_cache_segment(fx.cache, text, len, dict, NEWMM_ENGINE_GREEDY,
+                                         starts, ends, capacity);
+        check_spans("span cache", text, len, greedy, starts, ends, count, filled);
+        count = newmm_span_cache_segment(fx.cache, text, len, dict, NEWMM_ENGINE_WEIGHTED,
+                                         starts, ends, capacity);
+        check_spans("span cache weighted", text, len, weighted, starts, ends, count, filled);
+    }
+    count = newmm_span_cache_segment(fx.cache, text, len, dict, NEWMM_ENGINE_GREEDY,
+                                     starts, ends, FUZZ_SHORT_CAPACITY);
+    check_spans("span cache short capacity", text, len, greedy, starts, ends, count,
+                FUZZ_SHORT_CAPACITY);
+    
+    const int32_t* ctx_starts;
+    const int32_t* ctx_ends;
+    count = newmm_ctx_segment_spans(fx.ctx, text, len, dict, &ctx_starts, &ctx_ends);
+    check_spans("ctx spans", text, len, greedy, ctx_starts, ctx_ends, count, count);
+    
+    /* Tokens are C strings, so a NUL inside the text cannot be compared */
+    if (!memchr(text, '\0', len)) {
+        int token_count = 0;
+        char** tokens = newmm_ctx_segment(fx.ctx, text, len, dict, &token_count);
+        check_tokens("ctx tokens", text, len, greedy, tokens, token_count);
+        
+        tokens = newmm_segment_with_dict_len(text, len, dict, &token_count);
+        check_tokens("newmm_segment_with_dict_len", text, len, greedy, tokens, token_count);
+        newmm_free_result(tokens, token_count);
+    }
+    newmm_ctx_reset(fx.ctx);
+    
+    /* The text, an empty one and the text again, as one batch */
+    const char* texts[3] = {text, "", text};
+    size_t lens[3] = {len, 0, len};
+    newmm_batch_result_t batch;
+    if (newmm_segment_batch(texts, lens, 3, dict, 2, &batch) != 0) {
+        report("batch", text, len, "batch call failed");
+    } else {
+        for (size_t t = 0; t < 3; t += 2) {
+            int first = (int)batch.offsets[t];
+            count = (int)(batch.offsets[t + 1] - batch.offsets[t]);
+            check_spans("batch", text, len, greedy, batch.starts + first, batch.ends + first,
+                        count, count);
+        }
+        if (batch.offsets[2] != batch.offsets[1]) report("batch", text, len, "empty text got tokens");
+        newmm_free_batch_result(&batch);
+    }
+    
+    check_stream("stream", dict, text, len, greedy, rng, 64);
+    if (len <= 512) check_stream("stream bytewise", dict, text, len, greedy, rng, 1);
+    
+    free(starts);
+    free(ends);
+    free(ids);
+}
+
+/* ---- Naive greedy reference ---- */
+
+/* Lengths of the words of the mutable trie starting at pos that end on
+ * a cluster boundary, looked up afresh on every call */
+static int naive_words_at(const char* text, int len, int pos, const uint64_t* boundaries,
+                          int* lengths) {
+    int n = trie_prefix_ends(fx.ref_trie, text + pos, (size_t)(len - pos), lengths,
+                             TRIE_MAX_PREFIXES);
+    int kept = 0;
+    for (int i = 0; i < n; i++) {
+        if (tcc_is_boundary(boundaries, pos + lengths[i])) lengths[kept++] = lengths[i];
+    }
+    return kept;
+}
+
+enum { NAIVE_OTHER, NAIVE_SPACE, NAIVE_ALPHA, NAIVE_DIGIT };
+
+static int naive_class(int cp) {
+    if ((cp >= 'a' && cp <= 'z') || (cp >= 'A' && cp <= 'Z')) return NAIVE_ALPHA;
+    if (cp >= '0' && cp <= '9') return NAIVE_DIGIT;
+    if (cp == ' ' || cp == '\t') return NAIVE_SPACE;
+    return NAIVE_OTHER;
+}
+
+/* End of the token of a non-Thai character no word starts with, decoded
+ * a codepoint at a time: a run of Latin letters, of spaces and tabs, of
+ * digits with a '.' or ',' between two of them, or of one other
+ * character repeated. -1 if a Thai character starts at pos. */
+static int naive_run_end(const char* text, int len, int pos) {
+    int byte_len;
+    int cp = utf8_decode_n(text + pos, (size_t)(len - pos), &byte_len);
+    if (cp >= 0x0E00 && cp <= 0x0E7F) return -1;
+    
+    int kind = naive_class(cp);
+    int end = pos + byte_len;
+    while (end < len) {
+        int next = utf8_decode_n(text + end, (size_t)(len - end), &byte_len);
+        if (kind == NAIVE_OTHER) {
+            if (next != cp) break;
+        } else if (kind == NAIVE_DIGIT && (next == '.' || next == ',')) {
+            int after_len;
+            if (end + 1 >= len ||
+                naive_class(utf8_decode_n(text + end + 1, (size_t)(len - end - 1),
+                                          &after_len)) != NAIVE_DIGIT) break;
+        } else if (naive_class(next) != kind) {
+            break;
+        }
+        end += byte_len;
+    }
+    return end;
+}
+
+/* Greedy newmm: the longest word, unless the text after it starts no word
+ * and is Thai while the text after a shorter one does start a word */
+static bool naive_segment(const char* text, int len, const uint64_t* boundaries, SpanBuffer* out) {
+    int lengths[TRIE_MAX_PREFIXES];
+    int next[TRIE_MAX_PREFIXES];
+    int pos = 0;
+    while (pos < len) {
+        int n = naive_words_at(text, len, pos, boundaries, lengths);
+        int best = 0;
+        for (int i = 0; i < n; i++) {
+            if (lengths[i] > best) best = lengths[i];
+        }
+        
+        if (best > 0 && pos + best < len && naive_words_at(text, len, pos + best, boundaries, next) == 0) {
+            int byte_len;
+            int cp = utf8_decode_n(text + pos + best, (size_t)(len - pos - best), &byte_len);
+            if (cp >= 0x0E00 && cp <= 0x0E7F) {
+                for (int i = 0; i < n; i++) {
+                    int end = pos + lengths[i];
+                    if (lengths[i] < best && end < len &&
+                        naive_words_at(text, len, end, boundaries, next) > 0) {
+                        best = lengths[i];
+                        break;
+                    }
+                }
+            }
+        }
+        
+        int end = pos + best;
+        uint32_t id = NEWMM_UNKNOWN_ID;
+        if (best > 0) {
+            datrie_word_value(fx.ref, text + pos, (size_t)best, &id);
+        } else {
+            end = naive_run_end(text, len, pos);
+        }
+        if (end < 0) {
+            /* An unknown Thai cluster */
+            end = pos + 1;
+            while (!tcc_is_boundary(boundaries, end)) end++;
+        }
+        if (!span_push(out, pos, end, id)) return false;
+        pos = end;
+    }
+    return true;
+}
+
+static void check_input(const char* text, size_t len, uint64_t* rng) {
+    SpanBuffer reference[3] = {
+        {NULL, NULL, NULL, 0, 0, true, NULL},
+        {NULL, NULL, NULL, 0, 0, true, NULL},
+        {NULL, NULL, NULL, 0, 0, true, NULL},
+    };
+    /* Allocated up front so the naive spans keep their word IDs */
+    SpanBuffer naive = {(int32_t*)malloc(16 * sizeof(int32_t)), (int32_t*)malloc(16 * sizeof(int32_t)),
+                        (uint32_t*)malloc(16 * sizeof(uint32_t)), 16, 0, true, NULL};
+    static const newmm_engine_t engines[3] = {
+        NEWMM_ENGINE_GREEDY, NEWMM_ENGINE_GRAPH, NEWMM_ENGINE_WEIGHTED
+    };
+    static const char* const engine_names[3] = {"greedy", "graph", "weighted"};
+    uint64_t* bitmap = (uint64_t*)calloc(TCC_BITMAP_WORDS(len), sizeof(uint64_t));
+    if (!bitmap || !naive.starts || !naive.ends || !naive.ids) {
+        free(naive.starts);
+        free(naive.ends);
+        free(naive.ids);
+        free(bitmap);
+        return;
+    }
+    
+    /* The references: scalar clusters, on the mutable trie for the naive
+     * greedy one and on the codepoint-keyed compact trie for the engines */
+    tcc_set_impl(TCC_IMPL_SCALAR);
+    tcc_boundaries_into(text, (int)len, bitmap);
+    int status = naive_segment(text, (int)len, bitmap, &naive) ? 0 : -1;
+    if (status >= 0) status = segment_text(text, (int)len, fx.ref, NULL, &reference[0]);
+    if (status >= 0) status = segment_text_graph(text, (int)len, fx.ref, NULL, &reference[1]);
+    if (status >= 0) status = segment_text_weighted(text, (int)len, fx.ref, NULL, &reference[2]);
+    tcc_set_impl(TCC_IMPL_AUTO);
+    
+    if (status < 0) {
+        report("reference", text, len, "segmentation failed");
+    } else {
+        check_spans("segment_text", text, len, &naive, reference[0].starts, reference[0].ends,
+                    reference[0].count, reference[0].count);
+        for (int e = 0; e < 3; e++) {
+            check_cover(engine_names[e], text, len, &reference[e]);
+        }
+        check_tcc(text, len, bitmap);
+        check_prefixes(text, len);
+        
+        size_t capacity = (size_t)reference[0].count;
+        for (int e = 1; e < 3; e++) {
+            if ((size_t)reference[e].count > capacity) capacity = (size_t)reference[e].count;
+        }
+        capacity++;
+        int32_t* starts = (int32_t*)malloc(capacity * sizeof(int32_t));
+        int32_t* ends = (int32_t*)malloc(capacity * sizeof(int32_t));
+        uint32_t* ids = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+        for (int v = 0; starts && ends && ids && v < fx.num_variants; v++) {
+            char what[64];
+            for (int e = 0; e < 3; e++) {
+                snprintf(what, sizeof(what), "%s %s", fx.variants[v].name, engine_names[e]);
+                int count = newmm_segment_spans_engine(text, len, fx.variants[v].dict, engines[e],
+                                                       starts, ends, capacity);
+                check_spans(what, text, len, &reference[e], starts, ends, count, (int)capacity);
+            }
+            snprintf(what, sizeof(what), "%s word IDs", fx.variants[v].name);
+            int count = newmm_segment_ids(text, len, fx.variants[v].dict, NEWMM_ENGINE_GREEDY,
+                                          starts, ends, ids, capacity);
+            if (check_spans(what, text, len, &naive, starts, ends, count, (int)capacity)) {
+                check_ids(what, text, len, fx.variants[v].dict, &naive, ids, count);
+            }
+            snprintf(what, sizeof(what), "%s stream", fx.variants[v].name);
+            check_stream(what, fx.variants[v].dict, text, len, &reference[0], rng, 256);
+        }
+        free(starts);
+        free(ends);
+        free(ids);
+        
+        check_api(text, len, &naive, &reference[1], &reference[2], rng);
+    }
+    
+    for (int e = 0; e < 3; e++) {
+        free(reference[e].starts);
+        free(reference[e].ends);
+    }
+    free(naive.starts);
+    free(naive.ends);
+    free(naive.ids);
+    free(bitmap);
+}
+
+/* ---- Inputs ---- */
+
+/* ASCII runs against words that start with ASCII characters: runs that
+ * end where a word starts, words inside runs, numbers around "1.5" and
+ * repeated punctuation around ".." */
+static const char* const ascii_corpus[] = {
+    "helloworld", "hellohello", "xhello", "abcabc", "abcd", "a1a1", "a12", "aa1",
+    "okok", "ok.ok", "ok ok  ok\t", "ไปokไป", "ไปokay", "ไปo", "x1.5x", "1.5.5", "11.5",
+    "1,5,", "1.5,5.1", "2.5", "...", "..a..", ".-.", "A4A4", "a4", "A40", "-ไป-", "--ไป",
+    "eสปอร์ตok", "eสปอร์", "3มิติhello", "33มิติ", "3.5มิติ", "hello ไปok 3มิติ1.5..",
+    "\xe0\xb8okx", "ok\x80ok", "1.\xff" "5",
+};
+#define NUM_ASCII_CORPUS (sizeof(ascii_corpus) / sizeof(ascii_corpus[0]))
+
+static void append_piece(Bytes* b, uint64_t* rng) {
+    static const char* const invalid[] = {
+        "\x80", "\xbf", "\xc0\x80", "\xe0\xb8", "\xe0\x80\x80", "\xed\xa0\x80",
+        "\xf4\x90\x80\x80", "\xf8\x88\x80\x80\x80", "\xfe", "\xff", "\xe0\xb8\xe0\xb8\x81"
+    };
+    static const char ascii[] = " abcxyzHELO0123456789.,-'\"\n\t";
+    static const uint32_t others[] = {0xE9, 0x3B1, 0x4E2D, 0x200B, 0xFEFF, 0x1F600, 0x0E5B};
+    
+    size_t kind = rng_below(rng, 100);
+    if (kind < 55) {
+        const char* word = fx.words[rng_below(rng, fx.num_words)];
+        bytes_append(b, word, strlen(word));
+    } else if (kind < 70) {
+        bytes_append_cp(b, 0x0E01 + (uint32_t)rng_below(rng, 0x0E5B - 0x0E01 + 1));
+    } else if (kind < 82) {
+        size_t n = 1 + rng_below(rng, 6);
+        for (size_t i = 0; i < n; i++) {
+            bytes_append(b, &ascii[rng_below(rng, sizeof(ascii) - 1)], 1);
+        }
+    } else if (kind < 87) {
+        const char* word = extra_words[rng_below(rng, NUM_EXTRA_WORDS)];
+        bytes_append(b, word, strlen(word));
+        /* Often straight into an ASCII run, so the run abuts the word */
+        if (rng_below(rng, 2) == 0) bytes_append(b, &ascii[rng_below(rng, sizeof(ascii) - 1)], 1);
+    } else if (kind < 93) {
+        bytes_append_cp(b, others[rng_below(rng, sizeof(others) / sizeof(others[0]))]);
+    } else if (kind < 99) {
+        const char* bad = invalid[rng_below(rng, sizeof(invalid) / sizeof(invalid[0]))];
+        bytes_append(b, bad, strlen(bad));
+    } else {
+        bytes_append(b, "", 1);
+    }
+}
+
+/* Flip, drop, insert or repeat a few bytes anywhere, splitting sequences */
+static void mutate(Bytes* b, uint64_t* rng) {
+    size_t n = 1 + rng_below(rng, 4);
+    for (size_t m = 0; m < n && b->len > 0; m++) {
+        size_t pos = rng_below(rng, b->len);
+        switch (rng_below(rng, 4)) {
+        case 0:
+            b->data[pos] ^= (char)(1u << rng_below(rng, 8));
+            break;
+        case 1:
+            memmove(b->data + pos, b->data + pos + 1, b->len - pos - 1);
+            b->len--;
+            break;
+        case 2:
+            if (bytes_reserve(b, 1)) {
+                memmove(b->data + pos + 1, b->data + pos, b->len - pos);
+                b->data[pos] = (char)rng_next(rng);
+                b->len++;
+            }
+            break;
+        default: {
+            size_t span = 1 + rng_below(rng, b->len - pos < 16 ? b->len - pos : 16);
+            if (bytes_reserve(b, span)) {
+                memmove(b->data + pos + span, b->data + pos, b->len - pos);
+                b->len += span;
+            }
+            break;
+        }
+        }
+    }
+}
+
+static void generate(Bytes* b, uint64_t* rng, long iteration) {
+    b->len = 0;
+    if (iteration % 97 == 96) {
+        /* Long enough to be split by the parallel segmenter */
+        while (b->len < FUZZ_LONG_INPUT) {
+            append_piece(b, rng);
+            if (rng_below(rng, 8) == 0) bytes_append(b, rng_below(rng, 4) ? " " : "\n", 1);
+        }
+        return;
+    }
+    
+    size_t kind = rng_below(rng, 10);
+    if (kind == 9) {
+        /* Pieces of the ASCII corpus run together */
+        size_t pieces = 1 + rng_below(rng, 8);
+        for (size_t i = 0; i < pieces; i++) {
+            const char* piece = ascii_corpus[rng_below(rng, NUM_ASCII_CORPUS)];
+            bytes_append(b, piece, strlen(piece));
+        }
+    } else if (kind < 2 && fx.num_corpus > 0) {
+        /* A slice of a corpus file, cut at arbitrary bytes */
+        const Bytes* file = &fx.corpus[rng_below(rng, (size_t)fx.num_corpus)];
+        size_t start = rng_below(rng, file->len);
+        size_t n = 1 + rng_below(rng, 2048);
+        if (n > file->len - start) n = file->len - start;
+        bytes_append(b, file->data + start, n);
+    } else {
+        size_t pieces = rng_below(rng, 48);
+        for (size_t i = 0; i < pieces; i++) {
+            append_piece(b, rng);
+        }
+    }
+    if (rng_below(rng, 4) == 0) mutate(b, rng);
+}
+
+#ifdef NEWMM_LIBFUZZER
+
+static uint64_t hash_bytes(const char* data, size_t len) {
+    uint64_t h = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (unsigned char)data[i]) * 0x100000001B3ull;
+    }
+    return h;
+}
+
+int LLVMFuzzerInitialize(int* argc, char*** argv) {
+    (void)argc;
+    (void)argv;
+    const char* dict_path = getenv("NEWMM_FUZZ_DICT");
+    if (!fixture_setup(dict_path ? dict_path : "data/thai_words.txt")) abort();
+    return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (size > FUZZ_MAX_INPUT) return 0;
+    
+    const char* text = (const char*)data;
+    uint64_t rng = hash_bytes(text, size) | 1;
+    check_input(text, size, &rng);
+    
+    /* Now and then, repeat the input into a text the parallel segmenter splits */
+    if (size > 0 && (rng & 7) == 0) {
+        Bytes tiled = {0};
+        while (tiled.len < FUZZ_LONG_INPUT) {
+            bytes_append(&tiled, text, size);
+            bytes_append(&tiled, "\n", 1);
+        }
+        check_input(tiled.data, tiled.len, &rng);
+        free(tiled.data);
+    }
+    return 0;
+}
+
+#else
+
+int main(int argc, char** argv) {
+    uint64_t seed = 1;
+    long iterations = 2000;
+    const char* input_path = NULL;
+    int arg = 1;
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg++) {
+        if (strcmp(argv[arg], "--seed") == 0 && arg + 1 < argc) {
+            seed = strtoull(argv[++arg], NULL, 10);
+        } else if (strcmp(argv[arg], "--iterations") == 0 && arg + 1 < argc) {
+            iterations = strtol(argv[++arg], NULL, 10);
+        } else if (strcmp(argv[arg], "--input") == 0 && arg + 1 < argc) {
+            input_path = argv[++arg];
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[arg]);
+            return 2;
+        }
+    }
+    if (arg >= argc) {
+        fprintf(stderr, "Usage: %s [--seed N] [--iterations N] [--input FILE] dict_path [corpus...]\n",
+                argv[0]);
+        return 2;
+    }
+    
+    printf("=== CThaiNLP differential fuzzing ===\n");
+    if (!fixture_setup(argv[arg++])) {
+        fixture_teardown();
+        return 1;
+    }
+    
+    uint64_t rng = seed * 0x9E3779B97F4A7C15ull + 1;
+    if (input_path) {
+        Bytes input = {0};
+        if (!read_file(input_path, &input)) {
+            fprintf(stderr, "Cannot read %s\n", input_path);
+            fixture_teardown();
+            return 1;
+        }
+        check_input(input.data, input.len, &rng);
+        free(input.data);
+    } else {
+        fx.corpus = (Bytes*)calloc((size_t)(argc - arg) + 1, sizeof(Bytes));
+        for (; fx.corpus && arg < argc; arg++) {
+            if (read_file(argv[arg], &fx.corpus[fx.num_corpus]) && fx.corpus[fx.num_corpus].len > 0) {
+                fx.num_corpus++;
+            }
+        }
+        
+        for (size_t i = 0; i < NUM_ASCII_CORPUS; i++) {
+            check_input(ascii_corpus[i], strlen(ascii_corpus[i]), &rng);
+        }
+        
+        Bytes input = {0};
+        for (long i = 0; i < iterations && failures < 10; i++) {
+            generate(&input, &rng, i);
+            if (failures == 0 && i % 500 == 0) printf("Iteration %ld...\n", i);
+            long before = failures;
+            check_input(input.data ? input.data : "", input.len, &rng);
+            if (failures > before) fprintf(stderr, "   (seed %llu, iteration %ld)\n",
+                                           (unsigned long long)seed, i);
+        }
+        free(input.data);
+    }
+    
+    printf("Checks: %ld\n", checks);
+    printf("Mismatches: %ld\n", failures);
+    fixture_teardown();
+    if (failures == 0) {
+        printf("\n✓ All variants match the reference!\n");
+        return 0;
+    }
+    printf("\n❌ Some variants differ from the reference\n");
+    return 1;
+}
+
+#endif /* NEWMM_LIBFUZZER */
@@ -10,7 +10,16 @@ import sys
 # Add parent directory to path to allow importing cthainlp
 sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), '../..')))
 
-from cthainlp import word_tokenize
+from cthainlp import (
+    word_tokenize,
+    word_tokenize_batch,
+    segment_offsets,
+    segment_offsets_batch,
+    segment_ids,
+    set_span_cache_size,
+    span_cache_info,
+    UNKNOWN_ID,
+)
 
 
 class TestWordTokenize(unittest.TestCase):
@@ -77,6 +86,14 @@ class TestWordTokenize(unittest.TestCase):
         self.assertIsInstance(tokens, list)
         self.assertEqual(tokens, ["ไป"])
     
+    def test_embedded_nul(self):
+        """Test text containing a NUL character is segmented in full"""
+        text = "ไป\x00มา"
+        tokens = word_tokenize(text)
+        
+        self.assertEqual(''.join(tokens), text)
+        self.assertIn("\x00", tokens)
+    
     def test_with_custom_dict(self):
         """Test with custom dictionary"""
         text = "ฉันไปโรงเรียน"
@@ -90,6 +107,28 @@ class TestWordTokenize(unittest.TestCase):
             self.assertIn("ไป", tokens)
             self.assertIn("โรงเรียน", tokens)
     
+    def test_alternating_custom_dicts(self):
+        """Test switching between dictionaries and reloading an edited one"""
+        import tempfile
+        text = "โรงเรียน"
+        
+        with tempfile.TemporaryDirectory() as tmp:
+            whole = os.path.join(tmp, "whole.txt")
+            parts = os.path.join(tmp, "parts.txt")
+            with open(whole, "w", encoding="utf-8") as f:
+                f.write("โรงเรียน\n")
+            with open(parts, "w", encoding="utf-8") as f:
+                f.write("โรง\nเรียน\n")
+            
+            for _ in range(2):
+                self.assertEqual(word_tokenize(text, custom_dict=whole), ["โรงเรียน"])
+                self.assertEqual(word_tokenize(text, custom_dict=parts), ["โรง", "เรียน"])
+            
+            # A changed file size invalidates the cached copy
+            with open(whole, "w", encoding="utf-8") as f:
+                f.write("โรง\nเรียน\nบ้าน\n")
+            self.assertEqual(word_tokenize(text, custom_dict=whole), ["โรง", "เรียน"])
+    
     def test_engine_parameter(self):
         """Test engine parameter"""
         text = "ฉันไปโรงเรียน"
@@ -118,13 +157,181 @@ class TestWordTokenize(unittest.TestCase):
             word_tokenize(text, custom_dict="/nonexistent/path/dict.txt")
 
 
+class TestWordTokenizeBatch(unittest.TestCase):
+    """Test cases for word_tokenize_batch function"""
+    
+    def test_matches_word_tokenize(self):
+        """Test batch results match tokenizing each text on its own"""
+        texts = ["ฉันไปโรงเรียน", "", "hello world", "ราคา 1,234.50 บาท"] * 50
+        results = word_tokenize_batch(texts, num_threads=4)
+        
+        self.assertEqual(len(results), len(texts))
+        for text, tokens in zip(texts, results):
+            self.assertEqual(tokens, word_tokenize(text))
+    
+    def test_keep_whitespace(self):
+        """Test whitespace tokens can be dropped"""
+        results = word_tokenize_batch(["ไป มา"], keep_whitespace=False)
+        
+        self.assertEqual(results, [["ไป", "มา"]])
+    
+    def test_invalid_items(self):
+        """Test non-string items raise TypeError"""
+        with self.assertRaises(TypeError):
+            word_tokenize_batch(["ไป", 123])
+        with self.assertRaises(TypeError):
+            word_tokenize_batch("ไปมา")
+    
+    def test_concurrent_threads(self):
+        """Test Python threads can segment with the shared dictionary"""
+        from concurrent.futures import ThreadPoolExecutor
+        
+        texts = ["ฉันไปโรงเรียน", "วันนี้อากาศดีมาก"] * 100
+        expected = [word_tokenize(text) for text in texts]
+        with ThreadPoolExecutor(max_workers=4) as pool:
+            results = list(pool.map(word_tokenize, texts))
+        
+        self.assertEqual(results, expected)
+
+
+class TestSegmentOffsets(unittest.TestCase):
+    """Test cases for segment_offsets and segment_offsets_batch"""
+    
+    TEXTS = ["ฉันไปโรงเรียน", "", "hello world", "ราคา 1,234.50 บาท 😀"]
+    
+    def test_codepoint_offsets(self):
+        """Test codepoint boundaries slice the str into word_tokenize tokens"""
+        for text in self.TEXTS:
+            offsets = segment_offsets(text)
+            self.assertEqual(offsets.typecode, "i")
+            self.assertEqual(offsets[0], 0)
+            tokens = [text[a:b] for a, b in zip(offsets, offsets[1:])]
+            self.assertEqual(tokens, word_tokenize(text))
+    
+    def test_byte_offsets(self):
+        """Test byte boundaries slice the UTF-8 encoding"""
+        for text in self.TEXTS:
+            data = text.encode("utf-8")
+            offsets = segment_offsets(text, unit="byte")
+            tokens = [data[a:b].decode("utf-8") for a, b in zip(offsets, offsets[1:])]
+            self.assertEqual(tokens, word_tokenize(text))
+    
+    def test_buffer_protocol(self):
+        """Test the result exposes its items without a copy"""
+        view = memoryview(segment_offsets("ฉันไปโรงเรียน"))
+        self.assertEqual(view.format, "i")
+        self.assertEqual(view.tolist(), [0, 3, 5, 13])
+    
+    def test_batch_matches_single(self):
+        """Test each batch row equals segment_offsets of its text"""
+        texts = self.TEXTS * 20
+        for unit in ("codepoint", "byte"):
+            offsets, indptr = segment_offsets_batch(texts, unit=unit, num_threads=3)
+            self.assertEqual(len(indptr), len(texts) + 1)
+            self.assertEqual(indptr[-1], len(offsets))
+            for i, text in enumerate(texts):
+                row = offsets[indptr[i]:indptr[i + 1]]
+                self.assertEqual(row, segment_offsets(text, unit=unit))
+    
+    def test_invalid_arguments(self):
+        """Test bad units and non-string items are rejected"""
+        with self.assertRaises(ValueError):
+            segment_offsets("ไป", unit="char")
+        with self.assertRaises(TypeError):
+            segment_offsets(123)
+        with self.assertRaises(TypeError):
+            segment_offsets_batch(["ไป", None])
+        with self.assertRaises(TypeError):
+            segment_offsets_batch("ไปมา")
+
+
+class TestSegmentIds(unittest.TestCase):
+    """Test cases for segment_ids"""
+    
+    def test_payload_ids(self):
+        """Test tokens carry the IDs given in the dictionary"""
+        import tempfile
+        
+        with tempfile.TemporaryDirectory() as tmp:
+            path = os.path.join(tmp, "ids.txt")
+            with open(path, "w", encoding="utf-8") as f:
+                f.write("ฉัน\t7\nไป\t3\nโรงเรียน\t100\n")
+            offsets, ids = segment_ids("ฉันไปโรงเรียน xyz", custom_dict=path)
+            self.assertEqual(ids.typecode, "I")
+            self.assertEqual(list(offsets), [0, 3, 5, 13, 14, 17])
+            self.assertEqual(list(ids), [7, 3, 100, UNKNOWN_ID, UNKNOWN_ID])
+    
+    def test_line_ids(self):
+        """Test words without payloads are numbered by line"""
+        import tempfile
+        
+        with tempfile.TemporaryDirectory() as tmp:
+            path = os.path.join(tmp, "lines.txt")
+            with open(path, "w", encoding="utf-8") as f:
+                f.write("ฉัน\nไป\nโรงเรียน\n")
+            offsets, ids = segment_ids("โรงเรียนฉัน", custom_dict=path, unit="byte")
+            self.assertEqual(list(offsets), [0, 24, 33])
+            self.assertEqual(list(ids), [2, 0])
+    
+    def test_offsets_match(self):
+        """Test the offsets equal those of segment_offsets"""
+        import _cthainlp
+        self.assertEqual(_cthainlp.UNKNOWN_ID, UNKNOWN_ID)
+        text = "ราคา 1,234.50 บาท"
+        offsets, ids = segment_ids(text)
+        self.assertEqual(offsets, segment_offsets(text))
+        self.assertEqual(len(ids), len(offsets) - 1)
+
+
+class TestSpanCache(unittest.TestCase):
+    """Test cases for the span cache"""
+    
+    def tearDown(self):
+        set_span_cache_size(0)
+    
+    def test_repeats_hit(self):
+        """Test repeated texts are served from the cache with the same tokens"""
+        set_span_cache_size(64)
+        text = "สวัสดีครับ"
+        before = span_cache_info()
+        first = word_tokenize(text)
+        second = word_tokenize(text)
+        after = span_cache_info()
+        self.assertEqual(first, second)
+        self.assertEqual(after["hits"] - before["hits"], 1)
+        self.assertEqual(after["misses"] - before["misses"], 1)
+        self.assertGreaterEqual(after["capacity"], 64)
+    
+    def test_edited_dictionary_misses(self):
+        """Test a reloaded dictionary is never answered from old results"""
+        import tempfile
+        set_span_cache_size(64)
+        
+        with tempfile.TemporaryDirectory() as tmp:
+            path = os.path.join(tmp, "words.txt")
+            with open(path, "w", encoding="utf-8") as f:
+                f.write("โรงเรียน\n")
+            self.assertEqual(word_tokenize("โรงเรียน", custom_dict=path), ["โรงเรียน"])
+            with open(path, "w", encoding="utf-8") as f:
+                f.write("โรง\nเรียน\nบ้าน\n")
+            self.assertEqual(word_tokenize("โรงเรียน", custom_dict=path), ["โรง", "เรียน"])
+    
+    def test_disabled(self):
+        """Test a zero size turns the cache off"""
+        set_span_cache_size(0)
+        word_tokenize("ฉันไปโรงเรียน")
+        self.assertEqual(span_cache_info()["capacity"], 0)
+        with self.assertRaises(ValueError):
+            set_span_cache_size(-1)
+
+
 class TestCompatibility(unittest.TestCase):
     """Test PyThaiNLP API compatibility"""
     
     def test_similar_to_pythainlp(self):
         """Test that API is similar to PyThaiNLP"""
         # This test verifies that the API matches PyThaiNLP's style
-        from cthainlp import word_tokenize
+        from cthainlp import word_tokenize, word_tokenize_batch
         
         text = "ฉันไปโรงเรียน"
         
@@ -137,7 +344,7 @@ class TestCompatibility(unittest.TestCase):
     def test_newmm(self):
         """Test newmm module compatibility with PyThaiNLP"""
         from cthainlp import newmm
-        from cthainlp import word_tokenize
+        from cthainlp import word_tokenize, word_tokenize_batch
         
         self.assertEqual(newmm.segment(None), [])
         self.assertEqual(newmm.segment(""), [])
@@ -6,7 +6,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include "../include/newmm.h"
+#include "../src/tcc.h"
 
 typedef struct {
     const char* text;
@@ -20,14 +23,8 @@ static int test_passed = 0;
 #define INITIAL_OUTPUT_SIZE 1024
 #define TOKEN_OVERHEAD 4  /* For "'', " around each token */
 
-void run_test(const char* text, const char* dict_path, const char* expected, const char* description) {
-    test_count++;
-    printf("\n[Test %d] %s\n", test_count, description);
-    printf("Input: %s\n", text);
-    
-    int token_count;
-    char** tokens = newmm_segment(text, dict_path, &token_count);
-    
+/* Compare tokens against the expected list representation and report */
+static void check_tokens(char** tokens, int token_count, const char* expected) {
     /* Empty string should return NULL and token_count = 0 */
     if (!tokens && token_count == 0) {
         printf("Output: []\n");
@@ -93,6 +90,598 @@ void run_test(const char* text, const char* dict_path, const char* expected, con
     newmm_free_result(tokens, token_count);
 }
 
+void run_test(const char* text, const char* dict_path, const char* expected, const char* description) {
+    test_count++;
+    printf("\n[Test %d] %s\n", test_count, description);
+    printf("Input: %s\n", text);
+    
+    int token_count;
+    char** tokens = newmm_segment(text, dict_path, &token_count);
+    check_tokens(tokens, token_count, expected);
+}
+
+void run_len_test(const char* text, size_t len, newmm_dict_t dict, const char* expected,
+                  const char* description) {
+    test_count++;
+    printf("\n[Test %d] %s\n", test_count, description);
+    printf("Input: %.*s\n", (int)len, text);
+    
+    int token_count;
+    char** tokens = newmm_segment_with_dict_len(text, len, dict, &token_count);
+    check_tokens(tokens, token_count, expected);
+}
+
+void run_dict_test(const char* text, newmm_dict_t dict, const char* expected, const char* description) {
+    test_count++;
+    printf("\n[Test %d] %s\n", test_count, description);
+    printf("Input: %s\n", text);
+    
+    if (!dict) {
+        printf("❌ FAIL: Dictionary failed to load\n");
+        return;
+    }
+    
+    int token_count;
+    char** tokens = newmm_segment_with_dict(text, dict, &token_count);
+    check_tokens(tokens, token_count, expected);
+}
+
+/* Convert spans into a token list that check_tokens() can compare and free */
+static char** spans_to_tokens(const char* text, const int32_t* starts, const int32_t* ends, int count) {
+    if (count <= 0) return NULL;
+    
+    char** tokens = (char**)malloc(count * sizeof(char*));
+    if (!tokens) return NULL;
+    
+    for (int i = 0; i < count; i++) {
+        int len = ends[i] - starts[i];
+        tokens[i] = (char*)malloc(len + 1);
+        if (tokens[i]) {
+            memcpy(tokens[i], text + starts[i], len);
+            tokens[i][len] = '\0';
+        }
+    }
+    return tokens;
+}
+
+void run_spans_test(const char* text, size_t len, newmm_dict_t dict, size_t capacity,
+                    const char* expected, const char* description) {
+    test_count++;
+    printf("\n[Test %d] %s\n", test_count, description);
+    printf("Input: %.*s\n", (int)len, text);
+    
+    int32_t starts[64];
+    int32_t ends[64];
+    if (!dict || capacity > 64) {
+        printf("❌ FAIL: Invalid test setup\n");
+        return;
+    }
+    
+    int count = newmm_segment_spans(text, len, dict, starts, ends, capacity);
+    if (count < 0) {
+        printf("❌ FAIL: Segmentation failed\n");
+        return;
+    }
+    
+    /* Only the first capacity spans are written when the text has more */
+    int written = count < (int)capacity ? count : (int)capacity;
+    printf("Required: %d\n", count);
+    check_tokens(spans_to_tokens(text, starts, ends, written), written, expected);
+}
+
+void run_engine_test(const char* text, newmm_dict_t dict, newmm_engine_t engine,
+                     const char* expected, const char* description) {
+    test_count++;
+    printf("\n[Test %d] %s\n", test_count, description);
+    printf("Input: %s\n", text);
+    
+    int32_t starts[64];
+    int32_t ends[64];
+    size_t len = strlen(text);
+    int count = dict ? newmm_segment_spans_engine(text, len, dict, engine, starts, ends, 64) : -1;
+    if (count < 0 || count > 64) {
+        printf("❌ FAIL: Segmentation failed\n");
+        return;
+    }
+    
+    check_tokens(spans_to_tokens(text, starts, ends, count), count, expected);
+}
+
+/* Segment a text of repeat copies of unit and check the token count */
+void run_repeat_test(const char* unit, int repeat, newmm_dict_t dict, int tokens_per_unit,
+                     const char* description) {
+    test_count++;
+    printf("\n[Test %d] %s\n", test_count, description);
+    printf("Input: %d x %s\n", repeat, unit);
+    
+    size_t unit_len = strlen(unit);
+    char* text = (char*)malloc(unit_len * repeat + 1);
+    if (!dict || !text) {
+        printf("❌ FAIL: Invalid test setup\n");
+        free(text);
+        return;
+    }
+    for (int i = 0; i < repeat; i++) {
+        memcpy(text + i * unit_len, unit, unit_len);
+    }
+    text[unit_len * repeat] = '\0';
+    
+    int expected = repeat * tokens_per_unit;
+    int token_count;
+    char** tokens = newmm_segment_with_dict(text, dict, &token_count);
+    int required = newmm_segment_spans(text, unit_len * repeat, dict, NULL, NULL, 0);
+    
+    printf("Output: %d tokens, %d required\n", token_count, required);
+    printf("Expected: %d tokens\n", expected);
+    if (tokens && token_count == expected && required == expected &&
+        strcmp(tokens[token_count - 1], unit + unit_len - strlen(tokens[token_count - 1])) == 0) {
+        printf("✓ PASS\n");
+        test_passed++;
+    } else {
+        printf("❌ FAIL\n");
+    }
+    
+    newmm_free_result(tokens, token_count);
+    free(text);
+}
+
+/* Segment a batch in parallel and compare every text with newmm_segment_spans() */
+void run_batch_test(const char** texts, size_t num_texts, newmm_dict_t dict, int num_threads,
+                    const char* description) {
+    test_count++;
+    printf("\n[Test %d] %s\n", test_count, description);
+    printf("Input: %zu texts, %d threads\n", num_texts, num_threads);
+    
+    newmm_batch_result_t result;
+    if (!dict || newmm_segment_batch(texts, NULL, num_texts, dict, num_threads, &result) != 0) {
+        printf("❌ FAIL: Batch segmentation failed\n");
+        return;
+    }
+    
+    size_t mismatches = 0;
+    for (size_t i = 0; i < num_texts; i++) {
+        const char* text = texts[i] ? texts[i] : "";
+        int32_t starts[64];
+        int32_t ends[64];
+        int count = newmm_segment_spans(text, strlen(text), dict, starts, ends, 64);
+        size_t first = result.offsets[i];
+        
+        if (count < 0 || count > 64 || (size_t)count != result.offsets[i + 1] - first ||
+            memcmp(starts, result.starts + first, count * sizeof(int32_t)) != 0 ||
+            memcmp(ends, result.ends + first, count * sizeof(int32_t)) != 0) {
+            mismatches++;
+        }
+    }
+    
+    printf("Output: %zu spans, %zu mismatches\n", result.offsets[num_texts], mismatches);
+    printf("Expected: 0 mismatches\n");
+    if (result.num_texts == num_texts && mismatches == 0) {
+        printf("✓ PASS\n");
+        test_passed++;
+    } else {
+        printf("❌ FAIL\n");
+    }
+    
+    newmm_free_batch_result(&result);
+}
+
+/* Segment one large text in parallel and compare with newmm_segment_spans() */
+void run_parallel_test(const char* text, size_t len, newmm_dict_t dict, int num_threads,
+                       const char* description) {
+    test_count++;
+    printf("\n[Test %d] %s\n", test_count, description);
+    printf("Input: %zu bytes, %d threads\n", len, num_threads);
+    
+    int32_t* buffers[4];
+    for (int i = 0; i < 4; i++) {
+        buffers[i] = (int32_t*)malloc((len + 1) * sizeof(int32_t));
+    }
+    
+    int sequential = -1, parallel = -1;
+    if (dict && buffers[0] && buffers[1] && buffers[2] && buffers[3]) {
+        sequential = newmm_segment_spans(text, len, dict, buffers[0], buffers[1], len);
+        parallel = newmm_segment_spans_parallel(text, len, dict, num_threads,
+                                                buffers[2], buffers[3], len);
+    }
+    
+    printf("Output: %d tokens\n", parallel);
+    printf("Expected: %d tokens\n", sequential);
+    if (sequential > 0 && parallel == sequential &&
+        memcmp(buffers[0], buffers[2], sequential * sizeof(int32_t)) == 0 &&
+        memcmp(buffers[1], buffers[3], sequential * sizeof(int32_t)) == 0) {
+        printf("✓ PASS\n");
+        test_passed++;
+    } else {
+        printf("❌ FAIL\n");
+    }
+    
+    for (int i = 0; i < 4; i++) {
+        free(buffers[i]);
+    }
+}
+
+/* Token callback checking stream output against precomputed spans */
+typedef struct {
+    const char* text;
+    const int32_t* starts;
+    const int32_t* ends;
+    int expected;
+    int received;
+    int mismatches;
+} StreamCheck;
+
+static void on_stream_token(const char* token, size_t len, size_t offset, void* user_data) {
+    StreamCheck* check = (StreamCheck*)user_data;
+    int i = check->received++;
+    if (i >= check->expected || (size_t)check->starts[i] != offset ||
+        (size_t)check->ends[i] != offset + len || memcmp(token, check->text + offset, len) != 0) {
+        check->mismatches++;
+    }
+}
+
+/* Feed text to a stream in pieces of 1..max_piece bytes and compare the
+ * tokens with newmm_segment_spans() */
+void run_stream_test(const char* text, newmm_dict_t dict, int max_piece, const char* description) {
+    test_count++;
+    printf("\n[Test %d] %s\n", test_count, description);
+    
+    size_t len = strlen(text);
+    printf("Input: %zu bytes in pieces of up to %d bytes\n", len, max_piece);
+    
+    int32_t* starts = (int32_t*)malloc((len + 1) * sizeof(int32_t));
+    int32_t* ends = (int32_t*)malloc((len + 1) * sizeof(int32_t));
+    StreamCheck check = {text, starts, ends, 0, 0, 0};
+    newmm_stream_t* stream = NULL;
+    if (dict && starts && ends) {
+        check.expected = newmm_segment_spans(text, len, dict, starts, ends, len);
+        stream = newmm_stream_create(dict, on_stream_token, &check);
+    }
+    if (!stream) {
+        printf("❌ FAIL: Invalid test setup\n");
+        free(starts);
+        free(ends);
+        return;
+    }
+    
+    int status = 0;
+    size_t pos = 0;
+    for (int piece = 1; status == 0 && pos < len; piece = piece % max_piece + 1) {
+        size_t n = len - pos < (size_t)piece ? len - pos : (size_t)piece;
+        status = newmm_stream_feed(stream, text + pos, n);
+        pos += n;
+    }
+    if (status == 0) status = newmm_stream_finish(stream);
+    newmm_stream_free(stream);
+    
+    printf("Output: %d tokens, %d mismatches\n", check.received, check.mismatches);
+    printf("Expected: %d tokens\n", check.expected);
+    if (status == 0 && check.received == check.expected && check.mismatches == 0) {
+        printf("✓ PASS\n");
+        test_passed++;
+    } else {
+        printf("❌ FAIL\n");
+    }
+    
+    free(starts);
+    free(ends);
+}
+
+/* Segment texts of growing size with one context, resetting between
+ * them, and compare with newmm_segment_spans() */
+void run_ctx_test(const char* text, newmm_dict_t dict, const char* description) {
+    test_count++;
+    printf("\n[Test %d] %s\n", test_count, description);
+    
+    size_t len = strlen(text);
+    int32_t* starts = (int32_t*)malloc((len + 1) * sizeof(int32_t));
+    int32_t* ends = (int32_t*)malloc((len + 1) * sizeof(int32_t));
+    newmm_ctx_t* ctx = newmm_ctx_create();
+    if (!dict || !starts || !ends || !ctx) {
+        printf("❌ FAIL: Invalid test setup\n");
+        free(starts);
+        free(ends);
+        newmm_ctx_free(ctx);
+        return;
+    }
+    
+    int rounds = 0, mismatches = 0;
+    for (size_t n = len / 64; n <= len; n += len / 8 + 1, rounds++) {
+        /* Cut on a character start */
+        while (n < len && ((unsigned char)text[n] & 0xC0) == 0x80) n++;
+        
+        int expected = newmm_segment_spans(text, n, dict, starts, ends, n);
+        const int32_t* ctx_starts;
+        const int32_t* ctx_ends;
+        int count = newmm_ctx_segment_spans(ctx, text, n, dict, &ctx_starts, &ctx_ends);
+        int token_count;
+        char** tokens = newmm_ctx_segment(ctx, text, n, dict, &token_count);
+        
+        bool same = count == expected && token_count == expected &&
+                    (expected == 0 || (tokens &&
+                     memcmp(ctx_starts, starts, expected * sizeof(int32_t)) == 0 &&
+                     memcmp(ctx_ends, ends, expected * sizeof(int32_t)) == 0));
+        for (int i = 0; same && i < token_count; i++) {
+            size_t token_len = (size_t)(ends[i] - starts[i]);
+            same = strlen(tokens[i]) == token_len &&
+                   memcmp(tokens[i], text + starts[i], token_len) == 0;
+        }
+        if (!same) mismatches++;
+        newmm_ctx_reset(ctx);
+    }
+    
+    printf("Output: %d rounds, %d mismatches\n", rounds, mismatches);
+    if (mismatches == 0) {
+        printf("✓ PASS\n");
+        test_passed++;
+    } else {
+        printf("❌ FAIL\n");
+    }
+    
+    newmm_ctx_free(ctx);
+    free(starts);
+    free(ends);
+}
+
+/* Check that repeated cache lookups of a path share one dictionary */
+void run_cache_test(const char* dict_path, const char* description) {
+    test_count++;
+    printf("\n[Test %d] %s\n", test_count, description);
+    
+    newmm_dict_t first = newmm_dict_cache_get(dict_path);
+    newmm_dict_t second = newmm_dict_cache_get(dict_path);
+    printf("Output: %s\n", first && first == second ? "same handle" : "different handles");
+    if (first && first == second) {
+        printf("✓ PASS\n");
+        test_passed++;
+    } else {
+        printf("❌ FAIL\n");
+    }
+    
+    newmm_dict_release(first);
+    newmm_dict_release(second);
+}
+
+/* Write words to path and stamp it with a fixed modification time that
+ * differs only in the nanoseconds, as two rewrites within one second do */
+static void write_words_at(const char* path, const char* words, long nsec) {
+    FILE* fp = fopen(path, "w");
+    if (!fp) return;
+    fputs(words, fp);
+    fclose(fp);
+    struct timespec times[2] = {{1700000000, nsec}, {1700000000, nsec}};
+    utimensat(AT_FDCWD, path, times, 0);
+}
+
+/* Check the statistics one call and one two-thread batch leave on the
+ * calling thread, and that nothing is counted while disabled */
+void run_stats_test(const char* text, newmm_dict_t dict, const char* description) {
+    test_count++;
+    printf("\n[Test %d] %s\n", test_count, description);
+    
+    if (newmm_stats_enable(1) != 0) {
+        printf("Output: statistics compiled out\n");
+        printf("✓ PASS\n");
+        test_passed++;
+        return;
+    }
+    newmm_stats_reset();
+    
+    int token_count = 0;
+    char** tokens = newmm_segment_with_dict(text, dict, &token_count);
+    newmm_free_result(tokens, token_count);
+    newmm_stats_t single;
+    newmm_stats_get(&single);
+    
+    const char* texts[4] = {text, text, text, text};
+    newmm_batch_result_t result;
+    newmm_stats_reset();
+    int status = newmm_segment_batch(texts, NULL, 4, dict, 2, &result);
+    newmm_free_batch_result(&result);
+    newmm_stats_t batch;
+    newmm_stats_get(&batch);
+    
+    newmm_stats_enable(0);
+    newmm_stats_reset();
+    tokens = newmm_segment_with_dict(text, dict, &token_count);
+    newmm_free_result(tokens, token_count);
+    newmm_stats_t disabled;
+    newmm_stats_get(&disabled);
+    
+    bool ok = status == 0 &&
+              single.calls == 1 && single.bytes == strlen(text) &&
+              single.tokens == (uint64_t)token_count &&
+              single.tcc_clusters > 0 && single.prefix_queries > 0 &&
+              single.memo_hits > 0 &&
+              single.memo_hits <= single.prefix_queries + single.lookahead_queries &&
+              single.bytes_allocated > 0 &&
+              batch.calls == 4 && batch.tokens == 4 * single.tokens &&
+              batch.prefix_queries == 4 * single.prefix_queries &&
+              disabled.calls == 0;
+    printf("Output: calls=%llu tokens=%llu prefix=%llu hits=%llu, batch calls=%llu tokens=%llu\n",
+           (unsigned long long)single.calls, (unsigned long long)single.tokens,
+           (unsigned long long)single.prefix_queries, (unsigned long long)single.memo_hits,
+           (unsigned long long)batch.calls, (unsigned long long)batch.tokens);
+    if (ok) {
+        printf("✓ PASS\n");
+        test_passed++;
+    } else {
+        printf("❌ FAIL\n");
+    }
+}
+
+/* Check the word IDs of each token, written as "[7, 3, ?]" with ? for
+ * NEWMM_UNKNOWN_ID */
+void run_ids_test(const char* text, newmm_dict_t dict, newmm_engine_t engine,
+                  const char* expected, const char* description) {
+    test_count++;
+    printf("\n[Test %d] %s\n", test_count, description);
+    
+    int32_t starts[64], ends[64];
+    uint32_t ids[64];
+    int count = newmm_segment_ids(text, strlen(text), dict, engine, starts, ends, ids, 64);
+    
+    char output[512] = "[";
+    for (int i = 0; i < count && i < 64; i++) {
+        char id[16];
+        if (ids[i] == NEWMM_UNKNOWN_ID) {
+            snprintf(id, sizeof(id), "?");
+        } else {
+            snprintf(id, sizeof(id), "%u", (unsigned)ids[i]);
+        }
+        if (i > 0) strcat(output, ", ");
+        strcat(output, id);
+    }
+    strcat(output, "]");
+    
+    printf("Output: %s\n", output);
+    printf("Expected: %s\n", expected);
+    if (strcmp(output, expected) == 0) {
+        printf("✓ PASS\n");
+        test_passed++;
+    } else {
+        printf("❌ FAIL\n");
+    }
+}
+
+/* Check that a span cache returns what segmentation does, counts its
+ * hits and misses, evicts when full, and never serves the results of a
+ * dictionary swapped out of a slot */
+void run_span_cache_test(const char* text, newmm_dict_t first, newmm_dict_t second,
+                         const char* description) {
+    test_count++;
+    printf("\n[Test %d] %s\n", test_count, description);
+    
+    newmm_span_cache_t* cache = newmm_span_cache_create(32, 0);
+    newmm_dict_slot_t* slot = newmm_dict_slot_create(first);
+    size_t len = strlen(text);
+    int32_t starts[64], ends[64], expected_starts[64], expected_ends[64];
+    bool same = cache && slot;
+    
+    for (int round = 0; same && round < 4; round++) {
+        if (round == 2) newmm_dict_slot_set(slot, second);
+        newmm_dict_t dict = newmm_dict_slot_get(slot);
+        int expected = newmm_segment_spans(text, len, dict, expected_starts, expected_ends, 64);
+        int count = newmm_span_cache_segment(cache, text, len, dict, NEWMM_ENGINE_GREEDY,
+                                             starts, ends, 64);
+        same = count == expected && count <= 64 &&
+               memcmp(starts, expected_starts, count * sizeof(int32_t)) == 0 &&
+               memcmp(ends, expected_ends, count * sizeof(int32_t)) == 0;
+        newmm_dict_release(dict);
+    }
+    newmm_span_cache_stats_t stats;
+    newmm_span_cache_get_stats(cache, &stats);
+    
+    /* Distinct texts beyond the capacity evict older ones */
+    char other[32];
+    for (int i = 0; same && i < 200; i++) {
+        snprintf(other, sizeof(other), "ไป %d", i);
+        same = newmm_span_cache_segment(cache, other, strlen(other), first,
+                                        NEWMM_ENGINE_GREEDY, starts, ends, 64) > 0;
+    }
+    newmm_span_cache_stats_t full;
+    newmm_span_cache_get_stats(cache, &full);
+    
+    bool ok = same && stats.hits == 2 && stats.misses == 2 && stats.entries == 2 &&
+              full.evictions > 0 && full.entries == full.capacity && full.capacity >= 32;
+    printf("Output: hits=%llu misses=%llu after swap; %zu of %zu entries, %llu evictions\n",
+           (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+           full.entries, full.capacity, (unsigned long long)full.evictions);
+    if (ok) {
+        printf("✓ PASS\n");
+        test_passed++;
+    } else {
+        printf("❌ FAIL\n");
+    }
+    
+    newmm_dict_slot_free(slot);
+    newmm_span_cache_free(cache);
+}
+
+/* Byte offset of units_offset in the binary dictionary header, see
+ * DAFileHeader in src/datrie.c */
+#define DICT_UNITS_OFFSET_AT 56
+
+/* Write a damaged copy of a binary dictionary, cut to keep bytes or with
+ * the 8 bytes at patch_at replaced, and expect mapping it to fail */
+void run_corrupt_dict_test(const char* source, const char* path, size_t keep, long patch_at,
+                           uint64_t patch, const char* description) {
+    test_count++;
+    printf("\n[Test %d] %s\n", test_count, description);
+    
+    char* data = NULL;
+    size_t size = 0;
+    FILE* fp = fopen(source, "rb");
+    if (fp) {
+        fseek(fp, 0, SEEK_END);
+        size = (size_t)ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        data = (char*)malloc(size);
+        if (data && fread(data, 1, size, fp) != size) size = 0;
+        fclose(fp);
+    }
+    bool written = false;
+    if (data && size > DICT_UNITS_OFFSET_AT + sizeof(uint64_t)) {
+        if (keep < size) size = keep;
+        if (patch_at >= 0) memcpy(data + patch_at, &patch, sizeof(patch));
+        fp = fopen(path, "wb");
+        if (fp) {
+            written = fwrite(data, 1, size, fp) == size;
+            fclose(fp);
+        }
+    }
+    free(data);
+    
+    newmm_dict_t dict = written ? newmm_load_dict_mmap(path) : NULL;
+    printf("Output: %s\n", !written ? "could not write file" : dict ? "loaded" : "rejected");
+    if (written && !dict) {
+        printf("✓ PASS\n");
+        test_passed++;
+    } else {
+        printf("❌ FAIL\n");
+    }
+    newmm_free_dict(dict);
+    remove(path);
+}
+
+/* Check that every TCC scanner available on this CPU marks the same
+ * boundaries as the scalar one */
+void run_tcc_impl_test(const char* text, const char* description) {
+    test_count++;
+    printf("\n[Test %d] %s\n", test_count, description);
+    
+    static const char* names[] = {"auto", "scalar", "sse2", "avx2", "neon"};
+    int len = (int)strlen(text);
+    uint64_t* expected = NULL;
+    tcc_set_impl(TCC_IMPL_SCALAR);
+    int expected_count = tcc_boundaries(text, len, &expected);
+    
+    int checked = 0, mismatches = 0;
+    for (int impl = TCC_IMPL_SSE2; impl <= TCC_IMPL_NEON; impl++) {
+        if (!tcc_set_impl((TccImpl)impl)) continue;
+        
+        uint64_t* bitmap = NULL;
+        int count = tcc_boundaries(text, len, &bitmap);
+        if (!bitmap || count != expected_count ||
+            memcmp(bitmap, expected, TCC_BITMAP_WORDS(len) * sizeof(uint64_t)) != 0) {
+            printf("Mismatch: %s\n", names[impl]);
+            mismatches++;
+        }
+        checked++;
+        free(bitmap);
+    }
+    tcc_set_impl(TCC_IMPL_AUTO);
+    
+    printf("Output: %d clusters, %d SIMD scanners checked\n", expected_count, checked);
+    if (expected && mismatches == 0) {
+        printf("✓ PASS\n");
+        test_passed++;
+    } else {
+        printf("❌ FAIL\n");
+    }
+    
+    free(expected);
+}
+
 int main() {
     printf("=== CThaiNLP newmm Tokenizer Test Suite ===\n");
     
@@ -133,10 +722,432 @@ int main() {
              "['ไป']",
              "Single Thai word");
     
-    /* Test 8: Using default dictionary */
+    /* Test 8: Using the default dictionary, compiled from the bundled
+     * word list when the library is built with make */
     run_test("ฉันไปโรงเรียน", NULL,
-             "['ฉั', 'น', 'ไป', 'โรง', 'เรี', 'ยน']",
-             "Default dictionary (limited words)");
+             "['ฉัน', 'ไป', 'โรงเรียน']",
+             "Default dictionary compiled into the library");
+    
+    /* Test 9-10: Byte-keyed dictionary gives the same segmentation */
+    newmm_dict_t byte_dict = newmm_load_dict_ex(dict, NEWMM_DICT_BYTE_KEYS);
+    run_dict_test("ฉันไปโรงเรียน", byte_dict,
+                  "['ฉัน', 'ไป', 'โรงเรียน']",
+                  "Byte-keyed dictionary");
+    run_dict_test("วันนี้อากาศดีมาก hello 123", byte_dict,
+                  "['วันนี้', 'อากาศ', 'ดีมาก', ' ', 'hello', ' ', '123']",
+                  "Byte-keyed dictionary with mixed content");
+    newmm_free_dict(byte_dict);
+    
+    /* Test 11-12: Binary dictionary round trip */
+    const char* binary_dict = "build/test_dict.bin";
+    newmm_dict_t text_dict = newmm_load_dict(dict);
+    if (!text_dict || newmm_save_dict_binary(text_dict, binary_dict) != 0) {
+        printf("\n❌ FAIL: Could not write %s\n", binary_dict);
+        test_count++;
+    } else {
+        newmm_dict_t mapped_dict = newmm_load_dict_mmap(binary_dict);
+        run_dict_test("ฉันไปโรงเรียน", mapped_dict,
+                      "['ฉัน', 'ไป', 'โรงเรียน']",
+                      "Memory-mapped binary dictionary");
+        newmm_free_dict(mapped_dict);
+        
+        run_test("วันนี้อากาศดีมาก", binary_dict,
+                 "['วันนี้', 'อากาศ', 'ดีมาก']",
+                 "Binary dictionary detected by path");
+        remove(binary_dict);
+    }
+    newmm_free_dict(text_dict);
+    
+    /* Test 13-14: Span output on a slice of a larger buffer */
+    newmm_dict_t span_dict = newmm_load_dict(dict);
+    const char* buffer = "xxฉันไปโรงเรียนyy";
+    run_spans_test(buffer + 2, strlen(buffer) - 4, span_dict, 64,
+                   "['ฉัน', 'ไป', 'โรงเรียน']",
+                   "Spans on a non-NUL-terminated slice");
+    run_spans_test("ฉันไปโรงเรียน", strlen("ฉันไปโรงเรียน"), span_dict, 2,
+                   "['ฉัน', 'ไป']",
+                   "Spans limited by capacity");
+    
+    /* Test 15: Output is not capped at a fixed token count */
+    run_repeat_test("ฉันไป ", 6000, span_dict, 3, "More than 10000 tokens");
+    
+    /* Test 16: Length-aware string API on a field of a larger buffer */
+    const char* record = "id=7|ฉันไปโรงเรียน|lang=th";
+    run_len_test(record + 5, strlen("ฉันไปโรงเรียน"), span_dict,
+                 "['ฉัน', 'ไป', 'โรงเรียน']",
+                 "Length-aware segmentation of a buffer field");
+    
+    /* Test 17: Batch segmentation matches one-at-a-time segmentation */
+    static const char* samples[] = {
+        "ฉันไปโรงเรียน", "วันนี้อากาศดีมาก", "", "Hello World 123",
+        "ภาษาไทยเป็นภาษาที่สวยงาม ราคา 1,234.50 บาท", NULL,
+    };
+    const char* batch[3000];
+    for (int i = 0; i < 3000; i++) {
+        batch[i] = samples[i % 6];
+    }
+    run_batch_test(batch, 3000, span_dict, 4, "Batch segmentation across threads");
+    
+    /* Test 18: Parallel segmentation of one document matches sequential */
+    static const char* lines[] = {
+        "ก ข ไม่กระดิกหู ราคา 1,234.50 บาท\n", "ก.พ. วันนี้อากาศดีมาก -- OK!!\n",
+        "ภาษาไทยเป็นภาษาที่สวยงาม", " Hello World 3.14 ",
+    };
+    size_t doc_len = 0;
+    char* doc = (char*)malloc(200 * 1024);
+    while (doc && doc_len < 190 * 1024) {
+        const char* line = lines[(doc_len / 7) % 4];
+        memcpy(doc + doc_len, line, strlen(line));
+        doc_len += strlen(line);
+    }
+    run_parallel_test(doc, doc_len, span_dict, 4, "Parallel segmentation of a large document");
+    
+    /* Test 19: Streaming input split inside UTF-8 sequences and clusters */
+    if (doc) doc[20 * 1024] = '\0';
+    run_stream_test(doc ? doc : "", span_dict, 13, "Streaming segmentation in small pieces");
+    
+    /* Test 20: SIMD TCC scanners agree with the scalar one */
+    run_tcc_impl_test(doc ? doc : "", "TCC scanners give identical boundaries");
+    
+    /* Test 21: Context memory reused across documents */
+    run_ctx_test(doc ? doc : "", span_dict, "Segmentation with a reusable context");
+    free(doc);
+    
+    /* Test 22: Dictionary words only match on TCC boundaries */
+    const char* tcc_words = "build/test_tcc_words.txt";
+    FILE* fp = fopen(tcc_words, "w");
+    if (fp) {
+        fputs("กร\nไป\n", fp);
+        fclose(fp);
+    }
+    run_test("ไปกร์ไป", tcc_words,
+             "['ไป', 'กร์', 'ไป']",
+             "Word ending inside a TCC is not matched");
+    remove(tcc_words);
+    
+    /* Test 23: Unsorted word list with duplicates, padding and CRLF */
+    const char* messy_words = "build/test_messy_words.txt";
+    fp = fopen(messy_words, "wb");
+    if (fp) {
+        fputs("เรียน\r\nไป\r\n  โรง\t\r\nไป\r\n\r\nโรงเรียน\r\nฉัน\r\nเรียน", fp);
+        fclose(fp);
+    }
+    run_test("ฉันไปโรงเรียน", messy_words,
+             "['ฉัน', 'ไป', 'โรงเรียน']",
+             "Dictionary file is cleaned, sorted and deduplicated");
+    remove(messy_words);
+    
+    /* Test 24-25: The graph engine picks the reading with fewest tokens */
+    run_engine_test("ขวากล้ามคน", span_dict, NEWMM_ENGINE_GREEDY,
+                    "['ขวาก', 'ล้า', 'ม', 'คน']",
+                    "Greedy engine commits to the longest first word");
+    run_engine_test("ขวากล้ามคน", span_dict, NEWMM_ENGINE_GRAPH,
+                    "['ขวา', 'กล้าม', 'คน']",
+                    "Graph engine resolves overlapping words");
+    newmm_free_dict(span_dict);
+    
+    /* Test 26-27: Swapping a slot's dictionary leaves readers' references valid */
+    const char* old_words = "build/test_old_words.txt";
+    const char* new_words = "build/test_new_words.txt";
+    fp = fopen(old_words, "w");
+    if (fp) {
+        fputs("ฉัน\nไป\nโรงเรียน\n", fp);
+        fclose(fp);
+    }
+    fp = fopen(new_words, "w");
+    if (fp) {
+        fputs("ฉัน\nไป\nโรง\nเรียน\n", fp);
+        fclose(fp);
+    }
+    newmm_dict_t initial = newmm_load_dict(old_words);
+    newmm_dict_slot_t* slot = newmm_dict_slot_create(initial);
+    newmm_free_dict(initial);
+    newmm_dict_t held = slot ? newmm_dict_slot_get(slot) : NULL;
+    newmm_dict_t replacement = newmm_load_dict(new_words);
+    if (slot && replacement) newmm_dict_slot_set(slot, replacement);
+    newmm_free_dict(replacement);
+    run_engine_test("ฉันไปโรงเรียน", held, NEWMM_ENGINE_GREEDY,
+                    "['ฉัน', 'ไป', 'โรงเรียน']",
+                    "Reference taken before a swap keeps the old dictionary");
+    newmm_dict_release(held);
+    newmm_dict_t current = slot ? newmm_dict_slot_get(slot) : NULL;
+    run_engine_test("ฉันไปโรงเรียน", current, NEWMM_ENGINE_GREEDY,
+                    "['ฉัน', 'ไป', 'โรง', 'เรียน']",
+                    "Slot hands out the swapped-in dictionary");
+    newmm_dict_release(current);
+    newmm_dict_slot_free(slot);
+    remove(old_words);
+    
+    /* Test 28-30: Overlays add and remove words without touching the base */
+    newmm_dict_t base = newmm_load_dict(new_words);
+    newmm_overlay_t* add_school = newmm_overlay_create(base);
+    newmm_free_dict(base);
+    newmm_overlay_add(add_school, "โรงเรียน");
+    newmm_dict_t tenant = newmm_overlay_build(add_school);
+    newmm_overlay_free(add_school);
+    newmm_overlay_t* drop_school = newmm_overlay_create(tenant);
+    newmm_overlay_remove(drop_school, "โรงเรียน");
+    newmm_dict_t nested = newmm_overlay_build(drop_school);
+    newmm_overlay_free(drop_school);
+    run_engine_test("ฉันไปโรงเรียน", tenant, NEWMM_ENGINE_GREEDY,
+                    "['ฉัน', 'ไป', 'โรงเรียน']",
+                    "Overlay word is found alongside the base words");
+    run_engine_test("ฉันไปโรงเรียน", tenant, NEWMM_ENGINE_GRAPH,
+                    "['ฉัน', 'ไป', 'โรงเรียน']",
+                    "Graph engine sees overlay words");
+    newmm_free_dict(tenant);
+    run_engine_test("ฉันไปโรงเรียน", nested, NEWMM_ENGINE_GREEDY,
+                    "['ฉัน', 'ไป', 'โรง', 'เรียน']",
+                    "Overlay on an overlay hides a word of its base");
+    newmm_free_dict(nested);
+    remove(new_words);
+    
+    /* Test 31-33: Overlays keep the payloads of a frequency dictionary */
+    const char* frequency_words = "build/test_frequency_words.txt";
+    fp = fopen(frequency_words, "w");
+    if (fp) {
+        fputs("ตา\t100\nกลม\t50\nลม\t60\n", fp);
+        for (int i = 0; i < 5000; i++) fprintf(fp, "x%d\t1\n", i);
+        fclose(fp);
+    }
+    base = newmm_load_dict(frequency_words);
+    newmm_overlay_t* add_sun = newmm_overlay_create(base);
+    newmm_free_dict(base);
+    newmm_overlay_add(add_sun, "ตาก");
+    newmm_dict_t sun_dict = newmm_overlay_build(add_sun);
+    newmm_overlay_free(add_sun);
+    run_engine_test("ฉันตากลม", sun_dict, NEWMM_ENGINE_WEIGHTED,
+                    "['ฉัน', 'ตา', 'กลม']",
+                    "Weighted engine gives an overlay word a neutral frequency");
+    newmm_free_dict(sun_dict);
+    remove(frequency_words);
+    fp = fopen(frequency_words, "w");
+    if (fp) {
+        fputs("ตา\t100\nกลม\t50\nตากลม\t10\nใหญ่\t1000000\n", fp);
+        fclose(fp);
+    }
+    base = newmm_load_dict(frequency_words);
+    newmm_overlay_t* drop_big = newmm_overlay_create(base);
+    newmm_overlay_remove(drop_big, "ใหญ่");
+    newmm_dict_t small_dict = newmm_overlay_build(drop_big);
+    newmm_overlay_free(drop_big);
+    run_engine_test("ตากลม", base, NEWMM_ENGINE_WEIGHTED, "['ตากลม']",
+                    "A rare word wins against the total of a large dictionary");
+    run_engine_test("ตากลม", small_dict, NEWMM_ENGINE_WEIGHTED, "['ตา', 'กลม']",
+                    "Removed words no longer count towards the total");
+    newmm_free_dict(base);
+    newmm_free_dict(small_dict);
+    remove(frequency_words);
+    
+    /* Test 34-36: newmm_segment() caches dictionaries and notices edits */
+    const char* cached_words = "build/test_cached_words.txt";
+    fp = fopen(cached_words, "w");
+    if (fp) {
+        fputs("ฉัน\nไป\nโรงเรียน\n", fp);
+        fclose(fp);
+    }
+    run_test("ฉันไปโรงเรียน", cached_words,
+             "['ฉัน', 'ไป', 'โรงเรียน']",
+             "Path-based segmentation loads the dictionary once");
+    run_cache_test(cached_words, "Later calls reuse the cached dictionary");
+    fp = fopen(cached_words, "w");
+    if (fp) {
+        fputs("ฉัน\nไป\nโรง\nเรียน\n", fp);
+        fclose(fp);
+    }
+    run_test("ฉันไปโรงเรียน", cached_words,
+             "['ฉัน', 'ไป', 'โรง', 'เรียน']",
+             "Edited dictionary file is loaded again");
+    remove(cached_words);
+    newmm_clear_dict_cache();
+    
+    /* Test 37: Statistics of single and batch calls */
+    newmm_dict_t stats_dict = newmm_load_dict(dict);
+    run_stats_test("ฉันไปโรงเรียน", stats_dict, "Statistics count single and batch calls");
+    newmm_free_dict(stats_dict);
+    
+    /* Test 38-40: Non-Thai runs, with and without dictionary words */
+    run_test("ราคา 1,000.50 บาท!!", dict,
+             "['ราคา', ' ', '1,000.50', ' ', 'บาท', '!!']",
+             "Numbers and punctuation runs");
+    const char* latin_words = "build/test_latin_words.txt";
+    fp = fopen(latin_words, "w");
+    if (fp) {
+        fputs("hello\nไป\n", fp);
+        fclose(fp);
+    }
+    newmm_dict_t latin_dict = newmm_load_dict(latin_words);
+    run_engine_test("helloworld ไป", latin_dict, NEWMM_ENGINE_GREEDY,
+                    "['hello', 'world', ' ', 'ไป']",
+                    "Latin dictionary words still match");
+    run_engine_test("helloworld ไป", latin_dict, NEWMM_ENGINE_GRAPH,
+                    "['hello', 'world', ' ', 'ไป']",
+                    "Graph engine matches Latin dictionary words");
+    newmm_free_dict(latin_dict);
+    remove(latin_words);
+    
+    /* Test 41-44: Word IDs from dictionary payloads */
+    const char* id_words = "build/test_id_words.txt";
+    fp = fopen(id_words, "w");
+    if (fp) {
+        fputs("ฉัน\t7\nไป\t3\nโรงเรียน\t100\n", fp);
+        fclose(fp);
+    }
+    newmm_dict_t id_dict = newmm_load_dict(id_words);
+    run_ids_test("ฉันไปโรงเรียนxyz", id_dict, NEWMM_ENGINE_GREEDY, "[7, 3, 100, ?]",
+                 "Tokens carry their dictionary payloads");
+    run_ids_test("ฉันไปโรงเรียนxyz", id_dict, NEWMM_ENGINE_GRAPH, "[7, 3, 100, ?]",
+                 "Graph engine tokens carry their dictionary payloads");
+    const char* id_binary = "build/test_id_words.bin";
+    newmm_save_dict_binary(id_dict, id_binary);
+    newmm_dict_t id_mapped = newmm_load_dict_mmap(id_binary);
+    run_ids_test("ไปโรงเรียน ฉัน", id_mapped, NEWMM_ENGINE_GREEDY, "[3, 100, ?, 7]",
+                 "Binary dictionaries keep payloads");
+    newmm_free_dict(id_mapped);
+    newmm_free_dict(id_dict);
+    remove(id_binary);
+    fp = fopen(id_words, "w");
+    if (fp) {
+        fputs("ฉัน\n\nไป\nโรง\nเรียน\nไป\n", fp);
+        fclose(fp);
+    }
+    id_dict = newmm_load_dict(id_words);
+    run_ids_test("ฉันไปโรงเรียน", id_dict, NEWMM_ENGINE_GREEDY, "[0, 1, 2, 3]",
+                 "Words without payloads are numbered by line");
+    newmm_free_dict(id_dict);
+    remove(id_words);
+    
+    /* Test 45-48: Frequency-weighted engine */
+    const char* freq_words = "build/test_freq_words.txt";
+    fp = fopen(freq_words, "w");
+    if (fp) {
+        fputs("ตา\t100\nกลม\t50\nตาก\t10\nลม\t60\n", fp);
+        fclose(fp);
+    }
+    newmm_dict_t freq_dict = newmm_load_dict(freq_words);
+    run_engine_test("ฉันตากลม", freq_dict, NEWMM_ENGINE_WEIGHTED,
+                    "['ฉัน', 'ตา', 'กลม']",
+                    "Weighted engine prefers frequent words");
+    newmm_free_dict(freq_dict);
+    fp = fopen(freq_words, "w");
+    if (fp) {
+        fputs("ตา\t5\nกลม\t2\nตาก\t80\nลม\t90\n", fp);
+        fclose(fp);
+    }
+    freq_dict = newmm_load_dict(freq_words);
+    const char* freq_binary = "build/test_freq_words.bin";
+    newmm_save_dict_binary(freq_dict, freq_binary);
+    newmm_dict_t freq_mapped = newmm_load_dict_mmap(freq_binary);
+    run_engine_test("ฉันตากลม", freq_mapped, NEWMM_ENGINE_WEIGHTED,
+                    "['ฉัน', 'ตาก', 'ลม']",
+                    "Weighted engine follows the frequencies of binary dictionaries");
+    newmm_free_dict(freq_mapped);
+    newmm_free_dict(freq_dict);
+    remove(freq_binary);
+    remove(freq_words);
+    newmm_dict_t plain_dict = newmm_load_dict(dict);
+    run_engine_test("ขวากล้ามคน", plain_dict, NEWMM_ENGINE_WEIGHTED,
+                    "['ขวา', 'กล้าม', 'คน']",
+                    "Weighted engine picks the fewest tokens without frequencies");
+    run_engine_test("hello ไปabc", plain_dict, NEWMM_ENGINE_WEIGHTED,
+                    "['hello', ' ', 'ไป', 'abc']",
+                    "Weighted engine keeps non-Thai runs whole");
+    newmm_free_dict(plain_dict);
+    
+    /* Test 49: Span cache reuse and invalidation on a dictionary swap */
+    const char* cache_words = "build/test_cache_words.txt";
+    fp = fopen(cache_words, "w");
+    if (fp) {
+        fputs("โรง\nเรียน\n", fp);
+        fclose(fp);
+    }
+    newmm_dict_t whole_dict = newmm_load_dict(dict);
+    newmm_dict_t parts_dict = newmm_load_dict(cache_words);
+    run_span_cache_test("ไปโรงเรียน", whole_dict, parts_dict,
+                        "Span cache hits repeats and misses after a dictionary swap");
+    newmm_free_dict(parts_dict);
+    newmm_free_dict(whole_dict);
+    remove(cache_words);
+    
+    /* Test 50-51: Damaged binary dictionaries are rejected, not mapped */
+    const char* good_binary = "build/test_good_dict.bin";
+    newmm_dict_t good_dict = newmm_load_dict(dict);
+    newmm_save_dict_binary(good_dict, good_binary);
+    newmm_free_dict(good_dict);
+    run_corrupt_dict_test(good_binary, "build/test_truncated_dict.bin", 4096, -1, 0,
+                          "Truncated binary dictionary is rejected");
+    run_corrupt_dict_test(good_binary, "build/test_wrapping_dict.bin", (size_t)-1,
+                          DICT_UNITS_OFFSET_AT, UINT64_MAX - 7,
+                          "Binary dictionary with a wrapping offset is rejected");
+    remove(good_binary);
+    
+    /* Test 52: NEWMM_UNKNOWN_ID is not a valid payload */
+    const char* reserved_words = "build/test_reserved_words.txt";
+    fp = fopen(reserved_words, "w");
+    if (fp) {
+        fputs("ฉัน\t4294967295\nไป\t3\nโรงเรียน\t4294967294\n", fp);
+        fclose(fp);
+    }
+    newmm_dict_t reserved_dict = newmm_load_dict(reserved_words);
+    run_ids_test("ไปโรงเรียนฉัน", reserved_dict, NEWMM_ENGINE_GREEDY, "[3, 4294967294, ?, ?]",
+                 "A word with the reserved payload is not read as a word");
+    newmm_free_dict(reserved_dict);
+    remove(reserved_words);
+    
+    /* Test 53-54: Words without payloads in a file with some are neutral */
+    const char* mixed_words = "build/test_mixed_words.txt";
+    fp = fopen(mixed_words, "w");
+    if (fp) {
+        fputs("ตา\t3\nกลม\t3\n", fp);
+        for (int i = 0; i < 200; i++) fprintf(fp, "x%d\n", i);
+        fputs("ตาก\nลม\n", fp);
+        fclose(fp);
+    }
+    newmm_dict_t mixed_dict = newmm_load_dict(mixed_words);
+    run_engine_test("ฉันตากลม", mixed_dict, NEWMM_ENGINE_WEIGHTED,
+                    "['ฉัน', 'ตา', 'กลม']",
+                    "Weighted engine does not read line numbers as frequencies");
+    run_ids_test("ตากลม ตา", mixed_dict, NEWMM_ENGINE_GREEDY, "[0, 0, ?, 3]",
+                 "Words without payloads in a file with some get payload 0");
+    newmm_free_dict(mixed_dict);
+    remove(mixed_words);
+    
+    /* Test 55-57: Same-size rewrites within one second are noticed too */
+    const char* same_size_words = "build/test_same_size_words.txt";
+    const char* replacing_words = "build/test_replacing_words.txt";
+    write_words_at(same_size_words, "ฉัน\nไป\nโรงเรียน\n", 1000);
+    run_test("ฉันไปโรงเรียน", same_size_words,
+             "['ฉัน', 'ไป', 'โรงเรียน']",
+             "Path-based segmentation loads the first version");
+    write_words_at(same_size_words, "ฉัน\nไป\nโรง\nเรียน", 2000);
+    run_test("ฉันไปโรงเรียน", same_size_words,
+             "['ฉัน', 'ไป', 'โรง', 'เรียน']",
+             "Same-size rewrite in the same second is loaded again");
+    write_words_at(replacing_words, "ฉัน\nไป\nโรงเรียน\n", 2000);
+    rename(replacing_words, same_size_words);
+    run_test("ฉันไปโรงเรียน", same_size_words,
+             "['ฉัน', 'ไป', 'โรงเรียน']",
+             "File renamed over it with the same size and time is loaded again");
+    remove(same_size_words);
+    newmm_clear_dict_cache();
+    
+    /* Test 58-59: Word IDs are given to matched words only */
+    const char* long_words = "build/test_long_words.txt";
+    char long_word[350 * 3 + 1];
+    for (int i = 0; i < 350; i++) memcpy(long_word + 3 * i, "ก", 3);
+    long_word[350 * 3] = '\0';
+    fp = fopen(long_words, "w");
+    if (fp) {
+        fprintf(fp, "ไป\n%s\n", long_word);
+        fclose(fp);
+    }
+    newmm_dict_t long_dict = newmm_load_dict(long_words);
+    run_ids_test(long_word, long_dict, NEWMM_ENGINE_GREEDY, "[1]",
+                 "Greedy engine matches a word longer than the weighted window");
+    run_ids_test(long_word, long_dict, NEWMM_ENGINE_WEIGHTED, "[?]",
+                 "Unknown word that spells a dictionary word gets no word ID");
+    newmm_free_dict(long_dict);
+    remove(long_words);
     
     /* Summary */
     printf("\n=== Test Summary ===\n");